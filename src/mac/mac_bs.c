@@ -17,6 +17,7 @@
  */
 
 #include "mac_bs.h"
+#include "mac_planner.h"
 #include "../util/log.h"
 #include <unistd.h>
 
@@ -28,14 +29,13 @@ user_s* ue_create(uint userid)
 {
 	// create user instance and association response
 	user_s* new_ue = calloc(sizeof(user_s),1);
-	new_ue->msg_control_queue = ringbuf_create(MAC_CTRL_MSG_BUF_SIZE);
+	new_ue->msg_control_queue = ringbuf_create(MAC_CTRL_MSG_BUF_SIZE, RINGBUF_MPSC);
 	new_ue->fragmenter = mac_frag_init();
 	new_ue->reassembler = mac_assmbl_init();
 	new_ue->userid = userid;
 	new_ue->ul_queue = 0;
 	new_ue->dl_mcs = 0;
 	new_ue->ul_mcs = 0;
-	new_ue->fs = NULL;
 
 	// init stats struct
     mac_stats_init(&new_ue->stats);
@@ -52,7 +52,6 @@ void ue_destroy(user_s* ue)
 	ringbuf_destroy(ue->msg_control_queue);
 	mac_frag_destroy(ue->fragmenter);
 	mac_assmbl_destroy(ue->reassembler);
-	ofdmframesync_destroy(ue->fs);
 	free(ue);
 }
 
@@ -63,18 +62,20 @@ MacBS mac_bs_init()
 	for (int i=0; i<MAX_USER; i++) {
 		macinst->UE[i] = NULL;
 	}
-	macinst->broadcast_ctrl_queue = ringbuf_create(MAC_CTRL_MSG_BUF_SIZE);
+	macinst->broadcast_ctrl_queue = ringbuf_create(MAC_CTRL_MSG_BUF_SIZE, RINGBUF_MPSC);
 	macinst->broadcast_data_fragmenter = mac_frag_init();
 
 #ifdef MAC_ENABLE_TAP_DEV
 	macinst->tapdevice = tap_init("tap0");
 #endif
 
-    SLIST_INIT(&macinst->etheraddr_map);
+	macinst->ethermap = mac_ethermap_create();
 
 	macinst->last_added_rachuserid=-1;
 	macinst->last_added_userid=-1;
 
+	macinst->scheduler = mac_sched_create(MAC_SCHED_DEFAULT);
+
 	return macinst;
 }
 
@@ -91,12 +92,11 @@ void mac_bs_destroy(MacBS mac)
 	}
 	ringbuf_destroy(mac->broadcast_ctrl_queue);
 	mac_frag_destroy(mac->broadcast_data_fragmenter);
-
-    while (!SLIST_EMPTY(&mac->etheraddr_map)) {
-        struct entry* n1 = SLIST_FIRST(&mac->etheraddr_map);
-        SLIST_REMOVE_HEAD(&mac->etheraddr_map, entries);
-        free(n1);
-    }
+	for (int sfn=0; sfn<FRAME_LEN; sfn++)
+		for (int i=0; i<MAC_DLDATA_SLOTS; i++)
+			mac_harq_tx_free(&mac->dl_harq[sfn][i]);
+	mac_sched_destroy(mac->scheduler);
+	mac_ethermap_destroy(mac->ethermap);
 	free(mac);
 }
 
@@ -105,10 +105,18 @@ void mac_bs_set_phy_interface(MacBS mac, struct PhyBS_s* phy)
 	mac->phy = phy;
 }
 
-void mac_bs_add_new_ue(MacBS mac, uint8_t rachuserid, uint8_t rach_try_cnt, ofdmframesync fs, int timing_diff)
+void mac_bs_set_scheduler(MacBS mac, mac_sched_type type)
+{
+	mac_sched_destroy(mac->scheduler);
+	mac->scheduler = mac_sched_create(type);
+	LOG(INFO,"[MAC BS] scheduler: %s\n",mac_sched_type_str(type));
+}
+
+int mac_bs_add_new_ue(MacBS mac, uint8_t rachuserid, uint8_t rach_try_cnt, int timing_diff)
 {
 	MacMessage response=NULL;
 	uint8_t userid = 0;
+	int new_userid = -1;
 
 	// if this isnt the first time an association is tried,
 	// check if this is the same user as the last one added
@@ -136,7 +144,6 @@ void mac_bs_add_new_ue(MacBS mac, uint8_t rachuserid, uint8_t rach_try_cnt, ofdm
 		} else {
 			// create new UE struct
 			mac->UE[userid] = ue_create(userid);
-			mac->UE[userid]->fs = fs;
 			mac->UE[userid]->last_seen = mac->subframe_cnt;
             mac->UE[userid]->timingadvance = timing_diff;
             response = mac_msg_create_associate_response(userid,rachuserid, assoc_resp_success, timing_diff);
@@ -146,8 +153,10 @@ void mac_bs_add_new_ue(MacBS mac, uint8_t rachuserid, uint8_t rach_try_cnt, ofdm
 			ringbuf_put(mac->broadcast_ctrl_queue, response);
 			mac->last_added_userid = userid;
 			mac->last_added_rachuserid = rachuserid;
+			new_userid = userid;
 		}
 	}
+	return new_userid;
 }
 
 // Change the DL/UL MCS scheme for a user
@@ -179,17 +188,6 @@ void mac_bs_set_mcs(MacBS mac, uint userid, uint mcs, uint dl_ul)
 	}
 }
 
-// Try to get the receiver object for the given userid
-// returns NULL if user does not exist
-ofdmframesync mac_bs_get_receiver(MacBS mac, uint userid)
-{
-	if (mac->UE[userid]!=NULL) {
-		return mac->UE[userid]->fs;
-	} else {
-		return NULL;
-	}
-}
-
 int mac_bs_add_txdata(MacBS mac, uint8_t destUserID, MacDataFrame frame)
 {
     MacFrag fragmenter = NULL;
@@ -244,6 +242,69 @@ void mac_bs_handle_control_ack(MacBS mac, MacMessage msg, user_s* ue)
 	}
 }
 
+// Request the retransmission of a DL data slot that the user could not decode.
+// The NACK is applied by the scheduler, which owns the copies of the DL data slots
+void mac_bs_handle_harq_nack(MacBS mac, MacMessage msg, user_s* ue)
+{
+	atomic_fetch_or(&ue->dl_harq_nacks,
+					1u << (msg->hdr.HARQNack.subframe*MAC_DLDATA_SLOTS + msg->hdr.HARQNack.slot));
+}
+
+// Mark the DL data slots NACKed by the user for retransmission
+static void mac_bs_apply_dl_harq_nacks(MacBS mac, user_s* ue)
+{
+	uint nacks = atomic_exchange(&ue->dl_harq_nacks, 0);
+	for (int sfn=0; nacks && sfn<FRAME_LEN; sfn++) {
+		for (int i=0; i<MAC_DLDATA_SLOTS; i++) {
+			if (!(nacks & (1u << (sfn*MAC_DLDATA_SLOTS+i))))
+				continue;
+			mac_harq_tx_s* tx = &mac->dl_harq[sfn][i];
+			// subframe and slot numbers are reused every frame, so only NACKs for the last frame are valid
+			if (tx->tx_cnt == 0 || tx->userid != ue->userid || mac->subframe_cnt - tx->time >= FRAME_LEN) {
+				LOG_SFN_MAC(DEBUG,"[MAC BS] ignore NACK of user %d for subframe %d slot %d\n",
+							ue->userid, sfn, i);
+				continue;
+			}
+			if (tx->tx_cnt < HARQ_MAX_TX)
+				tx->retx = 1;
+		}
+	}
+}
+
+// Queue the NACKs of the failed UL data slots of the user as control messages
+static void mac_bs_queue_ul_harq_nacks(MacBS mac, user_s* ue)
+{
+	uint subframe, slot_nr;
+	while (phy_bs_get_ul_harq_nack(mac->phy, ue->userid, &subframe, &slot_nr)) {
+		MacMessage msg = mac_msg_create_ul_harq_nack(subframe, slot_nr);
+		if (!ringbuf_put(ue->msg_control_queue, msg)) {
+			LOG_SFN_MAC(WARN,"[MAC BS] cannot queue UL NACK for user %d\n", ue->userid);
+			mac_msg_destroy(msg);
+		}
+	}
+}
+
+// Returns the oldest DL data slot of the user whose retransmission was requested. NULL if there is none
+mac_harq_tx_s* mac_bs_get_dl_retx(MacBS mac, user_s* ue)
+{
+	mac_harq_tx_s* retx = NULL;
+	for (int sfn=0; sfn<FRAME_LEN; sfn++) {
+		for (int i=0; i<MAC_DLDATA_SLOTS; i++) {
+			mac_harq_tx_s* tx = &mac->dl_harq[sfn][i];
+			if (!tx->retx || tx->tx_cnt == 0 || tx->userid != ue->userid)
+				continue;
+			if (tx->mcs != ue->dl_mcs) {
+				// the UE can only combine slots with the same mcs
+				tx->retx = 0;
+				continue;
+			}
+			if (retx == NULL || tx->time < retx->time)
+				retx = tx;
+		}
+	}
+	return retx;
+}
+
 // Handle incoming messages from PHY layer
 int mac_bs_handle_message(MacBS mac, MacMessage msg, uint8_t userID)
 {
@@ -270,6 +331,9 @@ int mac_bs_handle_message(MacBS mac, MacMessage msg, uint8_t userID)
 	case control_ack:
 		mac_bs_handle_control_ack(mac,msg,user);
 		break;
+	case harq_nack:
+		mac_bs_handle_harq_nack(mac,msg,user);
+		break;
     case mcs_chance_req:
         mac_bs_set_mcs(mac,userID,msg->hdr.MCSChangeReq.mcs,msg->hdr.MCSChangeReq.ul_flag);
         LOG_SFN_MAC(INFO,"[MAC BS] mcs_change_request from user %d mcs: %d is_ul %d\n",userID,
@@ -282,23 +346,15 @@ int mac_bs_handle_message(MacBS mac, MacMessage msg, uint8_t userID)
 			LOG_SFN_MAC(INFO,"[MAC BS] received frame with %d bytes!\n",frame->size);
 			//PRINT_BIN(INFO,frame->data,frame->size); LOG(INFO,"\n");
 #ifdef MAC_ENABLE_TAP_DEV
-            //check if source EtherAddr is already included in our address mapping
-            struct entry *np = NULL;
-            char* EtherSrcAddr = frame->data+6;
-            SLIST_FOREACH(np,&mac->etheraddr_map, entries) {
-                if (strncmp(np->EtherAddr,EtherSrcAddr,6)==0)
-                    break;
-            }
-            if (np==NULL) {
-                // EtherAddr not yet in list, add it
-                np = malloc(sizeof(struct entry));
-                strncpy(np->EtherAddr,EtherSrcAddr,6);
-                np->userid = userID;
-                SLIST_INSERT_HEAD(&mac->etheraddr_map,np,entries);
+            // learn the user behind which the source EtherAddr is located
+            uint8_t* EtherSrcAddr = (uint8_t*)frame->data+6;
+            int ret = mac_ethermap_learn(mac->ethermap, EtherSrcAddr, userID, mac_ethermap_now());
+            if (ret == 1)
                 LOG(INFO, "[MAC] Add EtherAddr: %02x:%02x:%02x:%02x:%02x:%02x -> userid %d\n",
                             EtherSrcAddr[0],EtherSrcAddr[1],EtherSrcAddr[2],EtherSrcAddr[3],
                             EtherSrcAddr[4],EtherSrcAddr[5], userID);
-            }
+            else if (ret < 0)
+                LOG(WARN, "[MAC] EtherAddr table is full, cannot add address of userid %d\n", userID);
             tap_send(mac->tapdevice,frame->data,frame->size);
 #endif
 
@@ -365,8 +421,23 @@ int ue_has_dldata(user_s* ue)
 			!ringbuf_isempty(ue->msg_control_queue));
 }
 
-void mac_bs_map_slot(MacBS mac, uint subframe, uint slot, user_s* ue)
+// Map the next DL data slot of the user. Returns 1 if the slot is a HARQ retransmission
+int mac_bs_map_slot(MacBS mac, uint subframe, uint slot, user_s* ue)
 {
+	mac_harq_tx_s* tx = &mac->dl_harq[subframe][slot];
+	// requested retransmissions are sent first, unchanged
+	mac_harq_tx_s* retx = mac_bs_get_dl_retx(mac, ue);
+	if (retx) {
+		LogicalChannel chan = mac_harq_tx_get_chan(retx);
+		uint tx_cnt = retx->tx_cnt+1;
+		retx->tx_cnt = 0;
+		phy_map_dlslot(mac->phy, chan, subframe%2, slot, ue->userid, ue->dl_mcs);
+		mac_harq_tx_store(tx, chan, ue->userid, ue->dl_mcs, tx_cnt, mac->subframe_cnt);
+		lchan_destroy(chan);
+		ue->stats.harq_retx++;
+		return 1;
+	}
+
 	// Generate logical channel
 	uint tbs = get_tbs_size(mac->phy->common, ue->dl_mcs);
 	LogicalChannel chan = lchan_create(tbs/8, CRC16);
@@ -380,7 +451,9 @@ void mac_bs_map_slot(MacBS mac, uint subframe, uint slot, user_s* ue)
 	}
 	lchan_calc_crc(chan);
     phy_map_dlslot(mac->phy, chan, subframe%2, slot, ue->userid, ue->dl_mcs);
+    mac_harq_tx_store(tx, chan, ue->userid, ue->dl_mcs, 1, mac->subframe_cnt);
     lchan_destroy(chan);
+    return 0;
 }
 
 // Find users which did not answer to any slot assignments
@@ -410,19 +483,12 @@ void mac_bs_remove_inactive_users(MacBS mac)
 			if (mac->UE[userid]->will_end && ringbuf_isempty(mac->UE[userid]->msg_control_queue)) {
 				user_s* ue = mac->UE[userid];
 				mac->UE[userid] = NULL;
+				if (mac->phy)
+					phy_bs_remove_user(mac->phy, userid);
 				ue_destroy(ue);
 
-                // remove entries from etheraddr_map belonging to userid
-                struct entry* np = SLIST_FIRST(&mac->etheraddr_map);
-                struct entry* np_next = NULL;
-                while (np !=NULL) {
-                    np_next = SLIST_NEXT(np,entries);
-                    if (np->userid == userid) {
-                        SLIST_REMOVE(&mac->etheraddr_map,np,entry,entries);
-                        free(np);
-                    }
-                    np = np_next;
-                }
+                // remove the EtherAddr entries belonging to userid
+                mac_ethermap_remove_user(mac->ethermap, userid);
 			}
 		}
 	}
@@ -468,43 +534,64 @@ void mac_bs_process_mcs_change(MacBS mac)
 	}
 }
 
-// Check whether the slot that is about to be assigned is colliding with
-// a slot in the other link direction. Need to perform this check since
-// clients are only half-duplex
-// NOTE: we assume that the scheduler first assignes DL slots in a subframe
-// Returns: 1 if there is a overlap, otherwise 0
-int dl_ul_overlap_check(MacBS mac, uint userid, int subframe, int slotnr, int is_dl)
+// UL ctrl slots: every active user gets an assignment every 8th subframe
+uint mac_bs_get_ulctrl_user(MacBS mac, uint subframe, uint slot)
 {
-    if (is_dl) {
-        // ensure that the user is not already mapped to a UL slot at the same time from previous scheduler iteration
-        if (slotnr<2 && userid == mac->ul_data_assignments[(uint)(subframe-1)%FRAME_LEN][slotnr+2]){
-            return 1; // there is an overlap
-        }
-    } else { // is uplink
-        // ensure that the user is not already mapped to a DL slot at the same time from current scheduler iteration
-        if (slotnr<2 && (userid == mac->dl_data_assignments[subframe][slotnr+2] ||
-                            USER_BROADCAST==mac->dl_data_assignments[subframe][slotnr+2])){
-            return 1; // there is an overlap
-        }
-        // ensure that UL slot does not overlap with Sync slot
-        if (subframe==0 && slotnr==1)
-            return 1;
-    }
-    // ensure that the user was not mapped to a ULCTRL slot in previous subframe
-    // user wont be able to decode DLCTRL slot in this case, to he cannot be assigned at all
-    if (userid == mac->ul_ctrl_assignments[(uint)(subframe-1)%FRAME_LEN][0] ||
-            userid == mac->ul_ctrl_assignments[(uint)(subframe-1)%FRAME_LEN][1]){
-        return 1; // there is an overlap
-    }
-    return 0; // no overlap
+	uint id = subframe*MAC_ULCTRL_SLOTS + slot;
+	return (id < MAX_USER && mac->UE[id] != NULL) ? id : USER_UNUSED;
+}
+
+uint mac_bs_get_slot_size(MacBS mac, user_s* ue, uint dir)
+{
+	uint mcs = (dir == DL) ? ue->dl_mcs : ue->ul_mcs;
+	return get_tbs_size(mac->phy->common, mcs)/8;
+}
+
+uint mac_bs_get_queue_size(MacBS mac, user_s* ue, uint dir)
+{
+	uint queue;
+	int full_slot;
+	if (dir == DL) {
+		queue = mac_frag_get_buffersize(ue->fragmenter);
+		full_slot = !ringbuf_isempty(ue->msg_control_queue) || mac_bs_get_dl_retx(mac,ue);
+	} else {
+		queue = ue->ul_queue > 0 ? ue->ul_queue : 0;
+		full_slot = phy_bs_ul_harq_pending(mac->phy,ue->userid);
+	}
+	uint slot_size = mac_bs_get_slot_size(mac, ue, dir);
+	if (full_slot && queue < slot_size)
+		queue = slot_size;
+	return queue;
+}
+
+// Count the used data slots of the subframe. Slots are counted as idle if they were left
+// unused although the users had more data queued than the assigned slots could carry
+static void mac_bs_count_slots(MacBS mac, const mac_sched_run_s* run, uint subframe)
+{
+	uint8_t* assignments[2] = {mac->dl_data_assignments[subframe], mac->ul_data_assignments[subframe]};
+	for (int dir=DL; dir<=UL; dir++) {
+		uint wanted = 0, used = 0, available = 0;
+		for (int userid=0; userid<MAX_USER; userid++)
+			if (run->queue[dir][userid] > 0)
+				wanted += (run->queue[dir][userid]-1) / run->slot_size[dir][userid] + 1;
+		for (int slot=0; slot<MAC_DLDATA_SLOTS; slot++) {
+			// sync and RA slots cannot be used
+			if (subframe==0 && (slot==MAC_DLDATA_SLOTS-1 || (dir==UL && slot==1)))
+				continue;
+			available++;
+			if (assignments[dir][slot] != USER_UNUSED)
+				used++;
+		}
+		mac->slot_stats.available[dir] += available;
+		mac->slot_stats.used[dir] += used;
+		if (wanted > used)
+			mac->slot_stats.idle[dir] += (wanted-used < available-used) ? wanted-used : available-used;
+	}
 }
 
 void mac_bs_run_scheduler(MacBS mac)
 {
-	uint slot_idx = 0;
-	uint user_id = 0;
 	uint next_sfn;
-	user_s* ue = NULL;
 
 	LOG(TRACE,"[MAC BS] run scheduler\n");
 
@@ -514,6 +601,13 @@ void mac_bs_run_scheduler(MacBS mac)
 	// Run unresponsive user detection
 	mac_bs_detect_inactive_users(mac);
 
+	// Remove EtherAddr entries that were not seen for a while. Checked once per second
+	time_t now = mac_ethermap_now();
+	if (now != mac->ethermap_age_time) {
+		mac_ethermap_age(mac->ethermap, now);
+		mac->ethermap_age_time = now;
+	}
+
 	if (mac->phy->common->tx_symbol==0) {
 		// subframe just started. schedule for this one.
 		// TODO set rules when the scheduler should run
@@ -525,14 +619,20 @@ void mac_bs_run_scheduler(MacBS mac)
     // assure that the sync slot is not assigned for user traffic
     uint available_slots = (next_sfn==0) ? (MAC_DLDATA_SLOTS-1):MAC_DLDATA_SLOTS;
 
+	// HARQ: apply the DL NACKs and send the NACKs of failed UL slots
+	for (int userid=0; userid<MAX_USER; userid++) {
+		if (mac->UE[userid] != NULL) {
+			mac_bs_apply_dl_harq_nacks(mac, mac->UE[userid]);
+			mac_bs_queue_ul_harq_nacks(mac, mac->UE[userid]);
+		}
+	}
+
 	// 1. Assign UL ctrl slots
-	// Every active user gets an assignment every 8th subframe
-	uint id = mac->phy->common->tx_subframe *2;
-	mac->ul_ctrl_assignments[next_sfn][0] = mac->UE[id] != NULL ? id : 0;
-	mac->ul_ctrl_assignments[next_sfn][1] = mac->UE[id+1] != NULL ? id+1 : 0;
+	for (int i=0; i<MAC_ULCTRL_SLOTS; i++)
+		mac->ul_ctrl_assignments[next_sfn][i] = mac_bs_get_ulctrl_user(mac, next_sfn, i);
 
     // 2. DL mapping: start by disabling all slots
-    for (int i=slot_idx; i<MAC_DLDATA_SLOTS; i++) {
+    for (int i=0; i<MAC_DLDATA_SLOTS; i++) {
         mac->dl_data_assignments[next_sfn][i] = USER_UNUSED;
     }
     // 2.1 check Broadcast queue
@@ -555,79 +655,50 @@ void mac_bs_run_scheduler(MacBS mac)
         lchan_calc_crc(chan);
         phy_map_dlslot(mac->phy, chan, next_sfn%2, available_slots-1, USER_BROADCAST, 0);
         lchan_destroy(chan);
+        // broadcast slots are not acknowledged
+        mac->dl_harq[next_sfn][available_slots-1].tx_cnt = 0;
         mac->dl_data_assignments[next_sfn][available_slots-1] = USER_BROADCAST;
-        available_slots--;
     }
 
-    // 2.2. iterate over all remaining DL slots and assign it to the users
-	// assign slots to active users
-	// get first active user
-	// TODO if there is much traffic, users with high userid do not get assignments. Better do round robin over multiple subframes
-	ue = get_next_user(mac,0);
-	if (ue!=NULL) {
-		user_id = ue->userid;
-	}
-
-	while (slot_idx < available_slots) {
-		if (ue==NULL) {
-			// no active user at all. stop
-			break;
-		}
-		// get next user. Round robin allocation
-		ue = get_next_user(mac,ue->userid);
-
-        // check whether the user has DL data or DL ctrl data and we can assign it
-        if (ue_has_dldata(ue) && !dl_ul_overlap_check(mac,ue->userid,next_sfn,slot_idx,1)) {
-			mac_bs_map_slot(mac,next_sfn,slot_idx,ue);
-			mac->dl_data_assignments[next_sfn][slot_idx++] = ue->userid;
-			user_id = ue->userid; // update last active user
-		} else if (ue->userid == user_id) {
-            // no active that can be mapped was found. try next slot
-            mac->dl_data_assignments[next_sfn][slot_idx++] = USER_UNUSED;
-		}
-	}
-
-    // 3. iterate over each UL slot and assign it
-	// start by disabling all slots
-	for (int i=0; i<MAC_ULDATA_SLOTS; i++) {
-		mac->ul_data_assignments[next_sfn][i] = USER_UNUSED;
-	}
-	slot_idx = 0;
-	// get first active user
-	ue = get_next_user(mac,0);
-	if (ue!=NULL) {
-		user_id = ue->userid;
-	}
-
-    // force RA slot to be not assigned. (Slot 3 in subframe 0)
-    available_slots = (next_sfn==0) ? (MAC_ULDATA_SLOTS-1):MAC_ULDATA_SLOTS;
-
-    while (slot_idx < available_slots) {
-		if (ue==NULL) {
-			// no active user at all. stop
-			break;
-		}
-		// get next user. Round robin allocation
-		ue = get_next_user(mac,ue->userid);
-
-        // check whether the user has pending ul data
-        if (ue->ul_queue > 0 && !dl_ul_overlap_check(mac,ue->userid,next_sfn,slot_idx,0)) {
-			mac->ul_data_assignments[next_sfn][slot_idx++] = ue->userid;
-			user_id = ue->userid; // update last active user
-			// update ul queue len:
-			ue->ul_queue -= get_tbs_size(mac->phy->common, ue->ul_mcs)/8-5;
-			if (ue->ul_queue<0)
-				ue->ul_queue = 0;
-		} else if (ue->userid == user_id) {
-            // no user has data / can be assigned to this slot. Try next
-            mac->ul_data_assignments[next_sfn][slot_idx++] = USER_UNUSED;
+    // 3. plan the remaining DL and the UL data slots. The scheduler policy selects the users,
+    // the planner packs the slots of the users over the next subframes (see mac_planner.h)
+    mac_sched_run_s run;
+    mac_sched_begin(mac->scheduler, mac, &run);
+    mac_plan_subframe(mac, mac->scheduler, &run, next_sfn, mac->dl_data_assignments[next_sfn],
+                      mac->ul_data_assignments[next_sfn], mac->ul_ctrl_assignments[next_sfn]);
+    mac_bs_count_slots(mac, &run, next_sfn);
+
+    // HARQ retransmissions are flagged in the DL ctrl slot, only flagged slots are combined
+    uint8_t dl_retx = 0, ul_retx = 0;
+    for (int slot=0; slot<MAC_DLDATA_SLOTS; slot++) {
+        uint userid = mac->dl_data_assignments[next_sfn][slot];
+        if (userid != USER_UNUSED && userid != USER_BROADCAST) {
+            mac_sched_assigned(mac->scheduler, mac, userid, DL);
+            if (mac_bs_map_slot(mac,next_sfn,slot,mac->UE[userid]))
+                dl_retx |= 1<<slot;
         }
-	}
+    }
+    for (int slot=0; slot<MAC_ULDATA_SLOTS; slot++) {
+        uint userid = mac->ul_data_assignments[next_sfn][slot];
+        if (userid != USER_UNUSED) {
+            mac_sched_assigned(mac->scheduler, mac, userid, UL);
+            // users with a NACKed UL slot retransmit it in their next UL data slot
+            if (phy_bs_request_ul_retx(mac->phy, userid))
+                ul_retx |= 1<<slot;
+            // update ul queue len:
+            user_s* ue = mac->UE[userid];
+            ue->ul_queue -= get_tbs_size(mac->phy->common, ue->ul_mcs)/8-5;
+            if (ue->ul_queue<0)
+                ue->ul_queue = 0;
+        }
+    }
+    mac_sched_end(mac->scheduler, mac);
 
     // 4. set slot assignments in PHY
 	phy_assign_dlctrl_dd(mac->phy, mac->dl_data_assignments[next_sfn]);
 	phy_assign_dlctrl_ud(mac->phy, next_sfn%2, mac->ul_data_assignments[next_sfn]);
 	phy_assign_dlctrl_uc(mac->phy, next_sfn%2, mac->ul_ctrl_assignments[next_sfn]);
+	phy_assign_dlctrl_harq(mac->phy, next_sfn%2, ul_retx, dl_retx);
 	// write the Downlink control channel to the subcarriers
 	phy_map_dlctrl(mac->phy, next_sfn%2);
 
@@ -663,18 +734,17 @@ void* mac_bs_tap_rx_th(void* arg)
 
 		if (mac->tapdevice->bytes_rec>0) {
 			MacDataFrame frame = dataframe_create(dev->bytes_rec);
+			if (frame == NULL) {
+				LOG(DEBUG,"[MAC BS] no free frame, dropping Ether frame\n");
+				continue;
+			}
 			memcpy(frame->data,dev->buffer,dev->bytes_rec);
 
             // find correct userid to forward EtherFrame to
             // if no entry is found, broadcast channel is used
-            struct entry * np = NULL;
-            uint userid = USER_BROADCAST;
-            SLIST_FOREACH(np, &mac->etheraddr_map, entries) {
-                if (strncmp(frame->data,np->EtherAddr, 6)==0) {
-                    userid = np->userid;
-                    break;
-                }
-            }
+            int userid = mac_ethermap_lookup(mac->ethermap, (uint8_t*)frame->data);
+            if (userid < 0)
+                userid = USER_BROADCAST;
             if (!mac_bs_add_txdata(mac, userid, frame)) {
                 dataframe_destroy(frame);
                 LOG(ERR, "[MAC BS] could not add Ether frame to MAC\n");
@@ -22,18 +22,19 @@
 #include "mac_config.h"
 #include "mac_fragmentation.h"
 #include "mac_common.h"
+#include "mac_scheduler.h"
+#include "mac_ethermap.h"
 #include "tap_dev.h"
 
 #include "../util/ringbuf.h"
 #include <liquid/liquid.h>
-#include <sys/queue.h>
+#include <stdatomic.h>
 #include "../phy/phy_bs.h"
 
 enum {DL=0, UL};
 
 // Struct represents an associated user
 typedef struct {
-	ofdmframesync fs;			// framesync object. Stores freq offset etc.
 	uint8_t userid;
 	int ul_queue;
 	ringbuf msg_control_queue;
@@ -50,22 +51,26 @@ typedef struct {
 	long int ul_mcs_pending_time;
 
     MACstat_s stats;            // struct to collect statistics per user
+    mac_sched_ue_s sched;       // scheduler state of the user
 
     long unsigned int last_seen; // subframe No in which user has sent sth the last time
 	uint8_t will_end;			 // flag is set to indicate that the connection will be ended
+
+	// DL NACKs received from the user. Bit subframe*MAC_DLDATA_SLOTS+slot is set by the thread that
+	// delivers the UL slots and applied to dl_harq by the scheduler
+	atomic_uint dl_harq_nacks;
 }user_s;
 
+// Data slot utilization of the BS scheduler. Index: DL/UL
+typedef struct {
+	uint available[2];	// data slots that can be assigned, without the sync and RA slots
+	uint used[2];		// assigned slots, including broadcast slots
+	uint idle[2];		// slots left unused although the users had more data queued
+} mac_slot_stats_s;
+
 //forward declaration of phy struct that is needed in mac struct
 struct PhyBS_s;
 
-// Struct for linked list that contains etheraddr to userid mapping
-SLIST_HEAD(slisthead, entry);
-struct entry {
-    char EtherAddr[6];
-    uint userid;
-    SLIST_ENTRY(entry) entries;
-};
-
 struct MacBS_s {
 	ringbuf broadcast_ctrl_queue;
 	MacFrag broadcast_data_fragmenter;
@@ -77,10 +82,17 @@ struct MacBS_s {
 	uint8_t ul_data_assignments[FRAME_LEN][MAC_DLDATA_SLOTS];
 	uint8_t dl_data_assignments[FRAME_LEN][MAC_ULDATA_SLOTS];
 
+	// copies of the transmitted DL data slots for HARQ retransmissions
+	// 1. Index: subframe, 2. Index: slot
+	mac_harq_tx_s dl_harq[FRAME_LEN][MAC_DLDATA_SLOTS];
+
 	struct PhyBS_s* phy;
 
-    // Store mapping of EtherAddr to userid
-    struct slisthead etheraddr_map;
+	mac_sched scheduler;		// policy that assigns the data slots
+	mac_slot_stats_s slot_stats;
+
+	mac_ethermap ethermap;		// maps the EtherAddr of the hosts behind the clients to the userid
+	time_t ethermap_age_time;	// time of the last aging run of ethermap
 
 	int last_added_rachuserid;
 	int last_added_userid;
@@ -96,10 +108,13 @@ typedef struct MacBS_s* MacBS;
 MacBS mac_bs_init();
 void mac_bs_destroy(MacBS mac);
 void mac_bs_set_phy_interface(MacBS mac, struct PhyBS_s* phy);
+// Select the scheduler policy. The default is MAC_SCHED_DEFAULT
+void mac_bs_set_scheduler(MacBS mac, mac_sched_type type);
 
 // --------------- Interface functions for PHY --------------- //
-ofdmframesync mac_bs_get_receiver(MacBS mac, uint userid);
-void mac_bs_add_new_ue(MacBS mac, uint8_t rachuserid, uint8_t rach_try_cnt, ofdmframesync fs, int timing_diff);
+// Add a user which sent an association request. Returns the userid if a new user was created,
+// -1 if the user already exists or no userid is free
+int mac_bs_add_new_ue(MacBS mac, uint8_t rachuserid, uint8_t rach_try_cnt, int timing_diff);
 void mac_bs_update_timingadvance(MacBS mac, uint userid, int timing_diff);
 int mac_bs_rx_channel(MacBS mac, LogicalChannel chan, uint userid);
 
@@ -110,4 +125,15 @@ void mac_bs_run_scheduler(MacBS mac);
 
 void* mac_bs_tap_rx_th(void* mac);
 
+// -------------- Interface functions for scheduler -------------- //
+// returns the next active user after curr_user. Returns curr_user if there is no other user
+user_s* get_next_user(MacBS mac, uint curr_user);
+// returns the user that gets the UL ctrl slot of the subframe or USER_UNUSED
+uint mac_bs_get_ulctrl_user(MacBS mac, uint subframe, uint slot);
+// returns the number of bytes the user has queued. Pending control messages
+// and HARQ retransmissions count as a full slot
+uint mac_bs_get_queue_size(MacBS mac, user_s* ue, uint dir);
+// returns the payload size of a data slot of the user in bytes
+uint mac_bs_get_slot_size(MacBS mac, user_s* ue, uint dir);
+
 #endif /* MAC_MAC_BS_H_ */
@@ -25,19 +25,16 @@
 #include "../util/ringbuf.h"
 #include "mac_channels.h"
 #include "mac_messages.h"
+#include "mac_frame_pool.h"
 
 MacDataFrame dataframe_create(uint size)
 {
-	MacDataFrame frame = malloc(sizeof(MacDataFrame_s));
-	frame->data = malloc(size);
-	frame->size = size;
-	return frame;
+	return mac_frame_pool_alloc(size);
 }
 
 void dataframe_destroy(MacDataFrame frame)
 {
-	free(frame->data);
-	free(frame);
+	mac_frame_pool_free(frame);
 }
 
 // Check how many slots are assigned to the given userid
@@ -64,6 +61,39 @@ void lchan_add_all_msgs(LogicalChannel lchan, ringbuf ctrl_msg_buf)
 	}
 }
 
+void mac_harq_tx_store(mac_harq_tx_s* tx, LogicalChannel chan, uint userid, uint mcs, uint tx_cnt,
+					   long unsigned int time)
+{
+	if (tx->size < chan->payload_len) {
+		free(tx->data);
+		tx->data = malloc(chan->payload_len);
+		tx->size = chan->payload_len;
+	}
+	memcpy(tx->data, chan->data, chan->payload_len);
+	tx->len = chan->payload_len;
+	tx->userid = userid;
+	tx->mcs = mcs;
+	tx->tx_cnt = tx_cnt;
+	tx->retx = 0;
+	tx->time = time;
+}
+
+LogicalChannel mac_harq_tx_get_chan(mac_harq_tx_s* tx)
+{
+	LogicalChannel chan = lchan_create(tx->len, CRC16);
+	memcpy(chan->data, tx->data, tx->len);
+	chan->writepos = tx->len;
+	return chan;
+}
+
+void mac_harq_tx_free(mac_harq_tx_s* tx)
+{
+	free(tx->data);
+	tx->data = NULL;
+	tx->size = 0;
+	tx->tx_cnt = 0;
+}
+
 // initialize the mac statistics struct
 void mac_stats_init(MACstat_s* stats)
 {
@@ -72,6 +102,7 @@ void mac_stats_init(MACstat_s* stats)
     stats->bytes_rx = 0;
     stats->chan_rx_fail = 0;
     stats->chan_rx_succ = 0;
+    stats->harq_retx = 0;
 }
 
 // Print current mac statistics to the given buffer
@@ -84,8 +115,9 @@ int mac_stats_print(char* buf, int buflen, MACstat_s* stats)
     uint up_secs = (uptime%60);
     return snprintf(buf,buflen,"Uptime: %3d days %02d:%02d:%02d hours\n"\
                                "RX frame succ/fail: %5d/%d\n"\
-                               "RX bytes: %6d   TX bytes: %6d\n",
+                               "RX bytes: %6d   TX bytes: %6d\n"\
+                               "HARQ retransmissions: %d\n",
                                up_days,up_hours,up_min,up_secs,stats->chan_rx_succ,stats->chan_rx_fail,
-                               stats->bytes_rx,stats->bytes_tx);
+                               stats->bytes_rx,stats->bytes_tx,stats->harq_retx);
 
 }
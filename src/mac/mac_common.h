@@ -45,12 +45,28 @@ typedef struct {
 	uint chan_rx_fail;
 	uint bytes_rx;
 	uint bytes_tx;
+	uint harq_retx;		// number of data slots that were retransmitted
 	time_t association_time;
 } MACstat_s;
 
+// Copy of a transmitted data slot, kept for a HARQ retransmission.
+// The slot is retransmitted unchanged, so the receiver gets the same coded block
+typedef struct {
+	uint8_t userid;
+	uint8_t mcs;
+	uint8_t tx_cnt;				// number of transmissions of the data. 0 if the entry is unused
+	uint8_t retx;				// set if the receiver requested a retransmission
+	long unsigned int time;		// subframe counter of the last transmission
+	uint len;					// size of the logical channel in bytes, including the CRC
+	uint size;					// allocated size of data
+	uint8_t* data;
+} mac_harq_tx_s;
+
 typedef MacDataFrame_s* MacDataFrame;
 
 /************ Methods for Mac Dataframe *****************/
+// Frames are taken from the frame pool (mac_frame_pool.h).
+// Returns NULL if size exceeds MAC_MTU or all frames are in use
 MacDataFrame dataframe_create(uint size);
 void dataframe_destroy(MacDataFrame frame);
 
@@ -58,6 +74,13 @@ void dataframe_destroy(MacDataFrame frame);
 int num_slot_assigned(uint8_t* assignments, uint num_slots, uint8_t userid);
 void lchan_add_all_msgs(LogicalChannel lchan, ringbuf ctrl_msg_buf);
 
+// Keep a copy of a transmitted logical channel. tx_cnt is the number of transmissions of the data
+void mac_harq_tx_store(mac_harq_tx_s* tx, LogicalChannel chan, uint userid, uint mcs, uint tx_cnt,
+					   long unsigned int time);
+// Create a logical channel with the stored data for a retransmission
+LogicalChannel mac_harq_tx_get_chan(mac_harq_tx_s* tx);
+void mac_harq_tx_free(mac_harq_tx_s* tx);
+
 void mac_stats_init(MACstat_s* stats);
 int mac_stats_print(char* buf, int buflen, MACstat_s* stats);
 
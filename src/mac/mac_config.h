@@ -50,6 +50,10 @@
 #define MAC_ULDATA_SLOTS 4
 #define MAC_ULCTRL_SLOTS 2
 
+// Number of subframes the BS scheduler plans ahead, including the subframe that is scheduled.
+// 1 plans only the scheduled subframe. Max: FRAME_LEN
+#define MAC_PLAN_WINDOW 4
+
 // set the userID which is reserved as a broadcast identifier
 #define USER_BROADCAST 1
 // userID that is used to indicate a disabled/unused slot
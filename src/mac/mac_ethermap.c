@@ -0,0 +1,257 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "mac_ethermap.h"
+#include "mac_config.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// Every entry is stored in one 64bit word, so that readers never see a partially written entry
+// bit 63: entry used, bits 48..55: userid, bits 0..47: address
+#define ENTRY_USED (1ULL<<63)
+#define ENTRY_USER_SHIFT 48
+#define ENTRY_ADDR_MASK ((1ULL<<48)-1)
+#define ENTRY_USER(e) ((uint)((e) >> ENTRY_USER_SHIFT) & 0xff)
+
+struct mac_ethermap_s {
+	_Atomic uint64_t entries[ETHERMAP_SIZE];
+	atomic_uint seq;					// odd while a writer modifies the table
+
+	// only accessed by writers
+	time_t last_seen[ETHERMAP_SIZE];	// time the address was seen last
+	uint count[MAX_USER];				// number of entries per user
+	uint fill;							// number of used entries
+	pthread_mutex_t mutex;
+};
+
+static uint64_t mac_ethermap_key(const uint8_t* addr)
+{
+	uint64_t key = 0;
+	for (int i=0; i<6; i++)
+		key = (key << 8) | addr[i];
+	return key;
+}
+
+static uint mac_ethermap_hash(uint64_t key)
+{
+	return (uint)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (ETHERMAP_SIZE-1);
+}
+
+static uint64_t mac_ethermap_get(mac_ethermap map, uint i)
+{
+	return atomic_load_explicit(&map->entries[i], memory_order_relaxed);
+}
+
+static void mac_ethermap_set(mac_ethermap map, uint i, uint64_t e)
+{
+	atomic_store_explicit(&map->entries[i], e, memory_order_relaxed);
+}
+
+// Writers have to hold the mutex and enclose modifications with write_begin()/write_end()
+static void mac_ethermap_write_begin(mac_ethermap map)
+{
+	uint seq = atomic_load_explicit(&map->seq, memory_order_relaxed);
+	atomic_store_explicit(&map->seq, seq+1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+static void mac_ethermap_write_end(mac_ethermap map)
+{
+	uint seq = atomic_load_explicit(&map->seq, memory_order_relaxed);
+	atomic_store_explicit(&map->seq, seq+1, memory_order_release);
+}
+
+// returns the index of the entry of key or -1
+static int mac_ethermap_find(mac_ethermap map, uint64_t key)
+{
+	uint i = mac_ethermap_hash(key);
+	for (int n=0; n<ETHERMAP_SIZE; n++) {
+		uint64_t e = mac_ethermap_get(map, i);
+		if (!(e & ENTRY_USED))
+			return -1;
+		if ((e & ENTRY_ADDR_MASK) == key)
+			return i;
+		i = (i+1) & (ETHERMAP_SIZE-1);
+	}
+	return -1;
+}
+
+// Remove entry i. The following entries of the probe sequence are shifted back,
+// so that no tombstones are required
+static void mac_ethermap_remove_at(mac_ethermap map, uint i)
+{
+	uint64_t e = mac_ethermap_get(map, i);
+	map->count[ENTRY_USER(e)]--;
+	map->fill--;
+
+	uint j = i;
+	while (1) {
+		j = (j+1) & (ETHERMAP_SIZE-1);
+		e = mac_ethermap_get(map, j);
+		if (!(e & ENTRY_USED))
+			break;
+		// entry j can be moved to i if its home position is not cyclically in (i,j]
+		uint h = mac_ethermap_hash(e & ENTRY_ADDR_MASK);
+		if ((i <= j) ? (h <= i || h > j) : (h <= i && h > j)) {
+			mac_ethermap_set(map, i, e);
+			map->last_seen[i] = map->last_seen[j];
+			i = j;
+		}
+	}
+	mac_ethermap_set(map, i, 0);
+}
+
+mac_ethermap mac_ethermap_create()
+{
+	mac_ethermap map = calloc(sizeof(struct mac_ethermap_s),1);
+	pthread_mutex_init(&map->mutex, NULL);
+	return map;
+}
+
+void mac_ethermap_destroy(mac_ethermap map)
+{
+	pthread_mutex_destroy(&map->mutex);
+	free(map);
+}
+
+int mac_ethermap_learn(mac_ethermap map, const uint8_t* addr, uint userid, time_t now)
+{
+	uint64_t key = mac_ethermap_key(addr);
+	int ret = 1;
+
+	pthread_mutex_lock(&map->mutex);
+	int idx = mac_ethermap_find(map, key);
+	if (idx >= 0 && ENTRY_USER(mac_ethermap_get(map, idx)) == userid) {
+		// known address. Only the timestamp is updated, so readers are not disturbed
+		map->last_seen[idx] = now;
+		pthread_mutex_unlock(&map->mutex);
+		return 0;
+	}
+
+	mac_ethermap_write_begin(map);
+	if (idx >= 0) {
+		// the host moved to another user
+		mac_ethermap_remove_at(map, idx);
+	}
+
+	if (map->count[userid] >= ETHERMAP_MAX_PER_USER) {
+		// replace the oldest entry of the user
+		int oldest = -1;
+		for (int i=0; i<ETHERMAP_SIZE; i++) {
+			uint64_t e = mac_ethermap_get(map, i);
+			if ((e & ENTRY_USED) && ENTRY_USER(e) == userid &&
+					(oldest < 0 || map->last_seen[i] < map->last_seen[oldest]))
+				oldest = i;
+		}
+		mac_ethermap_remove_at(map, oldest);
+	}
+	if (map->fill >= ETHERMAP_MAX_FILL) {
+		ret = -1;
+		goto out;
+	}
+
+	uint i = mac_ethermap_hash(key);
+	while (mac_ethermap_get(map, i) & ENTRY_USED)
+		i = (i+1) & (ETHERMAP_SIZE-1);
+	mac_ethermap_set(map, i, ENTRY_USED | ((uint64_t)userid << ENTRY_USER_SHIFT) | key);
+	map->last_seen[i] = now;
+	map->count[userid]++;
+	map->fill++;
+
+out:
+	mac_ethermap_write_end(map);
+	pthread_mutex_unlock(&map->mutex);
+	return ret;
+}
+
+int mac_ethermap_lookup(mac_ethermap map, const uint8_t* addr)
+{
+	uint64_t key = mac_ethermap_key(addr);
+	uint seq;
+	int userid;
+
+	// retry if a writer was active before or during the lookup
+	do {
+		seq = atomic_load_explicit(&map->seq, memory_order_acquire);
+		userid = -1;
+		uint i = mac_ethermap_hash(key);
+		for (int n=0; n<ETHERMAP_SIZE; n++) {
+			uint64_t e = mac_ethermap_get(map, i);
+			if (!(e & ENTRY_USED))
+				break;
+			if ((e & ENTRY_ADDR_MASK) == key) {
+				userid = ENTRY_USER(e);
+				break;
+			}
+			i = (i+1) & (ETHERMAP_SIZE-1);
+		}
+		atomic_thread_fence(memory_order_acquire);
+	} while ((seq & 1) || atomic_load_explicit(&map->seq, memory_order_relaxed) != seq);
+
+	return userid;
+}
+
+void mac_ethermap_remove_user(mac_ethermap map, uint userid)
+{
+	pthread_mutex_lock(&map->mutex);
+	mac_ethermap_write_begin(map);
+	for (uint i=0; i<ETHERMAP_SIZE && map->count[userid]>0; ) {
+		uint64_t e = mac_ethermap_get(map, i);
+		if ((e & ENTRY_USED) && ENTRY_USER(e) == userid)
+			mac_ethermap_remove_at(map, i);	// check i again, an entry may have been shifted into it
+		else
+			i++;
+	}
+	mac_ethermap_write_end(map);
+	pthread_mutex_unlock(&map->mutex);
+}
+
+uint mac_ethermap_age(mac_ethermap map, time_t now)
+{
+	uint removed = 0;
+	pthread_mutex_lock(&map->mutex);
+	mac_ethermap_write_begin(map);
+	for (uint i=0; i<ETHERMAP_SIZE; ) {
+		uint64_t e = mac_ethermap_get(map, i);
+		if ((e & ENTRY_USED) && now - map->last_seen[i] >= ETHERMAP_MAX_AGE) {
+			mac_ethermap_remove_at(map, i);
+			removed++;
+		} else {
+			i++;
+		}
+	}
+	mac_ethermap_write_end(map);
+	pthread_mutex_unlock(&map->mutex);
+	return removed;
+}
+
+uint mac_ethermap_count(mac_ethermap map, int userid)
+{
+	pthread_mutex_lock(&map->mutex);
+	uint count = userid < 0 ? map->fill : map->count[userid];
+	pthread_mutex_unlock(&map->mutex);
+	return count;
+}
+
+time_t mac_ethermap_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
@@ -0,0 +1,65 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef MAC_MAC_ETHERMAP_H_
+#define MAC_MAC_ETHERMAP_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Forwarding table of the BS: maps the Ethernet source addresses seen on the uplink to the userid
+// of the client behind which the host is located.
+// Fixed size open addressing hash table (linear probing, backward shift deletion) keyed by the 48bit
+// address. Entries age out ETHERMAP_MAX_AGE seconds after the address was seen last, and every user
+// can hold at most ETHERMAP_MAX_PER_USER entries. If a user exceeds the limit, its oldest entry is replaced.
+//
+// Lookups are lock-free (seqlock): a reader retries if a writer modified the table in the meantime.
+// Writers (learn, remove, aging) are serialized by a mutex and may run in different threads.
+
+#define ETHERMAP_SIZE 256			// number of entries, power of two
+#define ETHERMAP_MAX_FILL 192		// max number of used entries, keeps the probe sequences short
+#define ETHERMAP_MAX_PER_USER 64	// max number of addresses per user
+#define ETHERMAP_MAX_AGE 300		// aging time in seconds
+
+typedef struct mac_ethermap_s* mac_ethermap;
+
+mac_ethermap mac_ethermap_create();
+void mac_ethermap_destroy(mac_ethermap map);
+
+// Add or refresh the address addr (6 bytes) seen at time now (seconds, CLOCK_MONOTONIC).
+// Returns 1 if the address was added or moved to another user, 0 if it was refreshed, -1 if the table is full
+int mac_ethermap_learn(mac_ethermap map, const uint8_t* addr, uint userid, time_t now);
+
+// Returns the userid of the address or -1 if the address is unknown. Lock-free
+int mac_ethermap_lookup(mac_ethermap map, const uint8_t* addr);
+
+// Remove all addresses of a user
+void mac_ethermap_remove_user(mac_ethermap map, uint userid);
+
+// Remove all addresses that were not seen for ETHERMAP_MAX_AGE seconds.
+// Returns the number of removed entries
+uint mac_ethermap_age(mac_ethermap map, time_t now);
+
+// returns the number of addresses of a user, or of all users if userid is -1
+uint mac_ethermap_count(mac_ethermap map, int userid);
+
+// returns the current time in seconds, as used by the table
+time_t mac_ethermap_now();
+
+#endif /* MAC_MAC_ETHERMAP_H_ */
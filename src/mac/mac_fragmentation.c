@@ -19,6 +19,7 @@
 #include "mac_fragmentation.h"
 
 #include <ringbuf.h>
+#include <stdatomic.h>
 #include "mac_config.h"
 
 #define MAX_SEQNR 4 // 2 bits are allocated for seqNr in MacMessage
@@ -29,9 +30,9 @@ struct MacFragmenter_s {
 	uint seqNr;
 	uint fragNr;
 	MacDataFrame curr_frame;
-	ringbuf frame_queue;
+	ringbuf frame_queue;		// filled by the thread that adds frames, emptied by the MAC thread
 	uint bytes_sent;
-	uint bytes_buffered;
+	atomic_uint bytes_buffered;	// bytes of the frames in frame_queue, updated by both threads
 } ;
 
 struct MacReassembler_s {
@@ -47,7 +48,7 @@ struct MacReassembler_s {
 MacFrag mac_frag_init()
 {
 	MacFrag frag = calloc(1,sizeof(struct MacFragmenter_s));
-	frag->frame_queue = ringbuf_create(MAC_DATA_BUF_SIZE);
+	frag->frame_queue = ringbuf_create(MAC_DATA_BUF_SIZE, RINGBUF_SPSC);
 	frag->curr_frame = NULL;
 	return frag;
 }
@@ -59,7 +60,7 @@ void mac_frag_destroy(MacFrag frag)
 		dataframe_destroy(p);
 	}
 	ringbuf_destroy(frag->frame_queue);
-	free(frag->curr_frame);
+	dataframe_destroy(frag->curr_frame);
 	free(frag);
 }
 
@@ -69,14 +70,14 @@ int mac_frag_add_frame(MacFrag frag, MacDataFrame frame)
 		LOG(WARN,"[MAC FRAG] incoming frame size exceeds MTU! %d bytes\n",frame->size);
 		return 0;
 	}
-	if (ringbuf_isfull(frag->frame_queue)) {
+	// count the bytes before the frame becomes visible to the MAC thread
+	atomic_fetch_add(&frag->bytes_buffered, frame->size);
+	if (!ringbuf_put(frag->frame_queue,frame)) {
+		atomic_fetch_sub(&frag->bytes_buffered, frame->size);
 		LOG(WARN,"[MAC FRAG] cannot enqueue frame. queue full\n");
 		return 0;
-	} else {
-		ringbuf_put(frag->frame_queue,frame);
-		frag->bytes_buffered += frame->size;
-		return 1;
 	}
+	return 1;
 }
 
 int mac_frag_has_fragment(MacFrag frag)
@@ -96,9 +97,9 @@ int mac_frag_queue_full(MacFrag frag)
 int mac_frag_get_buffersize(MacFrag frag)
 {
 	if (frag->curr_frame) {
-		return (frag->curr_frame->size - frag->bytes_sent) + frag->bytes_buffered;
+		return (frag->curr_frame->size - frag->bytes_sent) + atomic_load(&frag->bytes_buffered);
 	} else {
-		return frag->bytes_buffered;
+		return atomic_load(&frag->bytes_buffered);
 	}
 }
 
@@ -117,7 +118,7 @@ MacMessage mac_frag_get_fragment(MacFrag frag, uint max_frag_size, uint is_uplin
 			LOG(ERR,"[MAC FRAG] cannot fetch any SDU from buf\n");
 			return NULL;
 		}
-		frag->bytes_buffered -= sdu->size;
+		atomic_fetch_sub(&frag->bytes_buffered, sdu->size);
 		frag->curr_frame = sdu;
 		frag->fragNr = 0;
 		frag->seqNr = (frag->seqNr + 1) % MAX_SEQNR;
@@ -220,12 +221,16 @@ MacDataFrame mac_assmbl_reassemble(MacAssmbl assmbl, MacMessage fragment)
 
 	if (data->final_flag) {
 		frame = dataframe_create(assmbl->frame_len);
-		uint8_t* p = frame->data;
+		uint8_t* p = frame ? frame->data : NULL;
 		for (int i=0; i<assmbl->fragNr; i++) {
-			memcpy(p, assmbl->fragments[i],assmbl->fragments_len[i]);
-			p+=assmbl->fragments_len[i];
+			if (p) {
+				memcpy(p, assmbl->fragments[i],assmbl->fragments_len[i]);
+				p+=assmbl->fragments_len[i];
+			}
 			free(assmbl->fragments[i]);
 		}
+		if (frame == NULL)
+			LOG(DEBUG,"[MAC ASSMBL] no free frame for %d bytes, dropping frame\n",assmbl->frame_len);
 		assmbl->fragNr = 0;
 		assmbl->frame_open = 0;
 		assmbl->frame_len = 0;
@@ -38,7 +38,8 @@ typedef struct MacReassembler_s* MacAssmbl;
 MacFrag mac_frag_init();
 void mac_frag_destroy(MacFrag frag);
 
-// Add a frame to the MAC queue
+// Add a frame to the MAC queue. The queue is a single producer ring,
+// so frames of one fragmenter have to be added by one thread only
 int mac_frag_add_frame(MacFrag frag, MacDataFrame frame);
 
 // Check whether the fragmenter has some data in the queue
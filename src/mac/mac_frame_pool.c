@@ -0,0 +1,237 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "mac_frame_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+typedef struct {
+	MacDataFrame_s frame;	// frame.data points to data
+	atomic_uint next;		// next entry in the shared free list, index+1. 0 ends the list
+	uint8_t data[MAC_MTU];
+} mac_frame_pool_entry_s;
+
+// free entries of one thread. Only the owner adds entries, but other threads can steal them
+// if the shared list is empty. Every slot is taken with an atomic exchange, so each entry is
+// taken exactly once. -1 marks an empty slot. Slots from count on are always empty,
+// slots below count may be empty if their entry was stolen
+typedef struct mac_frame_pool_cache_s {
+	uint count;
+	atomic_int idx[MAC_FRAME_POOL_CACHE];
+	struct mac_frame_pool_cache_s* next;	// list of all thread caches
+} mac_frame_pool_cache_s;
+
+static mac_frame_pool_entry_s pool[MAC_FRAME_POOL_SIZE];
+
+// shared free list: bits 0..31 hold the index+1 of the first entry, bits 32..63 a counter
+// that is increased on every change, so a CAS fails if the list was changed in between (ABA)
+static atomic_uint_least64_t pool_head;
+static atomic_int pool_shared_free;
+static atomic_uint pool_drops;
+static atomic_uint pool_oversize;
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pool_cache_key;
+
+// caches of all threads. The mutex is only taken when a thread starts or exits and when
+// frames are stolen, never on the fast path
+static mac_frame_pool_cache_s* pool_caches;
+static pthread_mutex_t pool_caches_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// push the chain first..last of n entries, which is already linked with next, to the shared list
+static void mac_frame_pool_push(uint first, uint last, uint n)
+{
+	uint64_t head = atomic_load_explicit(&pool_head, memory_order_relaxed);
+	uint64_t new_head;
+	do {
+		atomic_store_explicit(&pool[last].next, (uint32_t)head, memory_order_relaxed);
+		new_head = ((head >> 32) + 1) << 32 | (first+1);
+	} while (!atomic_compare_exchange_weak_explicit(&pool_head, &head, new_head,
+													memory_order_release, memory_order_relaxed));
+	atomic_fetch_add_explicit(&pool_shared_free, n, memory_order_relaxed);
+}
+
+// pop one entry from the shared list. Returns -1 if the list is empty
+static int mac_frame_pool_pop()
+{
+	uint64_t head = atomic_load_explicit(&pool_head, memory_order_acquire);
+	uint64_t new_head;
+	do {
+		uint first = (uint32_t)head;
+		if (first == 0)
+			return -1;
+		// next may be outdated if the entry was taken in the meantime. Then the CAS fails
+		uint next = atomic_load_explicit(&pool[first-1].next, memory_order_relaxed);
+		new_head = ((head >> 32) + 1) << 32 | next;
+	} while (!atomic_compare_exchange_weak_explicit(&pool_head, &head, new_head,
+													memory_order_acquire, memory_order_acquire));
+	atomic_fetch_sub_explicit(&pool_shared_free, 1, memory_order_relaxed);
+	return (uint32_t)head - 1;
+}
+
+// add an entry to the cache. Only called by the owner
+static void mac_frame_pool_cache_put(mac_frame_pool_cache_s* cache, int idx)
+{
+	atomic_store_explicit(&cache->idx[cache->count++], idx, memory_order_release);
+}
+
+// take the top entry of the cache. Returns -1 if all entries were used or stolen.
+// Only called by the owner
+static int mac_frame_pool_cache_get(mac_frame_pool_cache_s* cache)
+{
+	while (cache->count > 0) {
+		int idx = atomic_exchange_explicit(&cache->idx[--cache->count], -1, memory_order_acq_rel);
+		if (idx >= 0)
+			return idx;
+	}
+	return -1;
+}
+
+// return the top n slots of the cache to the shared list
+static void mac_frame_pool_flush(mac_frame_pool_cache_s* cache, uint n)
+{
+	int first = -1, last = -1;
+	uint num = 0;
+	for (uint i=0; i<n; i++) {
+		int idx = mac_frame_pool_cache_get(cache);
+		if (idx < 0)
+			break;
+		if (last >= 0)
+			atomic_store_explicit(&pool[last].next, idx+1, memory_order_relaxed);
+		else
+			first = idx;
+		last = idx;
+		num++;
+	}
+	if (num > 0)
+		mac_frame_pool_push(first, last, num);
+}
+
+// Move up to MAC_FRAME_POOL_CACHE/2 entries of the other thread caches to the cache of this thread.
+// Returns the number of stolen entries
+static uint mac_frame_pool_steal(mac_frame_pool_cache_s* cache)
+{
+	uint stolen = 0;
+	pthread_mutex_lock(&pool_caches_mutex);
+	for (mac_frame_pool_cache_s* c=pool_caches; c && stolen<MAC_FRAME_POOL_CACHE/2; c=c->next) {
+		if (c == cache)
+			continue;
+		for (int i=0; i<MAC_FRAME_POOL_CACHE && stolen<MAC_FRAME_POOL_CACHE/2; i++) {
+			int idx = atomic_exchange_explicit(&c->idx[i], -1, memory_order_acq_rel);
+			if (idx >= 0) {
+				mac_frame_pool_cache_put(cache, idx);
+				stolen++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&pool_caches_mutex);
+	return stolen;
+}
+
+static void mac_frame_pool_thread_exit(void* arg)
+{
+	mac_frame_pool_cache_s* cache = arg;
+	pthread_mutex_lock(&pool_caches_mutex);
+	mac_frame_pool_cache_s** c = &pool_caches;
+	while (*c != cache)
+		c = &(*c)->next;
+	*c = cache->next;
+	pthread_mutex_unlock(&pool_caches_mutex);
+
+	mac_frame_pool_flush(cache, cache->count);
+	free(cache);
+}
+
+static void mac_frame_pool_init()
+{
+	for (uint i=0; i<MAC_FRAME_POOL_SIZE; i++) {
+		pool[i].frame.data = pool[i].data;
+		atomic_init(&pool[i].next, (i+1 < MAC_FRAME_POOL_SIZE) ? i+2 : 0);
+	}
+	atomic_store(&pool_head, 1);
+	atomic_store(&pool_shared_free, MAC_FRAME_POOL_SIZE);
+	pthread_key_create(&pool_cache_key, mac_frame_pool_thread_exit);
+}
+
+static mac_frame_pool_cache_s* mac_frame_pool_get_cache()
+{
+	pthread_once(&pool_once, mac_frame_pool_init);
+	mac_frame_pool_cache_s* cache = pthread_getspecific(pool_cache_key);
+	if (cache == NULL) {
+		// once per thread
+		cache = calloc(sizeof(mac_frame_pool_cache_s),1);
+		for (int i=0; i<MAC_FRAME_POOL_CACHE; i++)
+			atomic_init(&cache->idx[i], -1);
+		pthread_setspecific(pool_cache_key, cache);
+		pthread_mutex_lock(&pool_caches_mutex);
+		cache->next = pool_caches;
+		pool_caches = cache;
+		pthread_mutex_unlock(&pool_caches_mutex);
+	}
+	return cache;
+}
+
+MacDataFrame mac_frame_pool_alloc(uint size)
+{
+	if (size > MAC_MTU) {
+		atomic_fetch_add_explicit(&pool_oversize, 1, memory_order_relaxed);
+		return NULL;
+	}
+	mac_frame_pool_cache_s* cache = mac_frame_pool_get_cache();
+	int idx = mac_frame_pool_cache_get(cache);
+	if (idx < 0) {
+		// refill half of the cache from the shared list. If it is empty, the free frames
+		// are in the caches of other threads
+		uint n = 0;
+		while (n < MAC_FRAME_POOL_CACHE/2 && (idx = mac_frame_pool_pop()) >= 0) {
+			mac_frame_pool_cache_put(cache, idx);
+			n++;
+		}
+		if (n == 0 && mac_frame_pool_steal(cache) == 0) {
+			atomic_fetch_add_explicit(&pool_drops, 1, memory_order_relaxed);
+			return NULL;
+		}
+		idx = mac_frame_pool_cache_get(cache);
+		if (idx < 0) {
+			// the refilled entries were stolen in the meantime
+			atomic_fetch_add_explicit(&pool_drops, 1, memory_order_relaxed);
+			return NULL;
+		}
+	}
+	MacDataFrame frame = &pool[idx].frame;
+	frame->size = size;
+	return frame;
+}
+
+void mac_frame_pool_free(MacDataFrame frame)
+{
+	if (frame == NULL)
+		return;
+	mac_frame_pool_cache_s* cache = mac_frame_pool_get_cache();
+	if (cache->count == MAC_FRAME_POOL_CACHE)
+		mac_frame_pool_flush(cache, MAC_FRAME_POOL_CACHE/2);
+	mac_frame_pool_cache_put(cache, (mac_frame_pool_entry_s*)frame - pool);
+}
+
+void mac_frame_pool_get_stats(mac_frame_pool_stats_s* stats)
+{
+	stats->drops = atomic_load(&pool_drops);
+	stats->oversize = atomic_load(&pool_oversize);
+	stats->shared_free = atomic_load(&pool_shared_free);
+}
@@ -0,0 +1,52 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef MAC_MAC_FRAME_POOL_H_
+#define MAC_MAC_FRAME_POOL_H_
+
+#include "mac_common.h"
+#include "mac_config.h"
+
+// Fixed capacity pool of MacDataFrames, used by dataframe_create()/dataframe_destroy().
+// Every pool entry holds the frame header and a MAC_MTU sized data buffer in one block, so a
+// frame is a single allocation from static memory and the frame memory of the process is bounded.
+// Frames can be freed by any thread. Every thread keeps a small cache of free entries and only
+// exchanges batches of MAC_FRAME_POOL_CACHE/2 entries with the shared free list (lock-free stack),
+// so frames that are freed by the MAC thread flow back to the thread that allocates them.
+// If the shared list is empty, a thread steals the free entries of the other thread caches before
+// an allocation fails, so the whole pool can be allocated. The cache of a thread is returned to the
+// shared list when the thread exits.
+
+#define MAC_FRAME_POOL_SIZE ((MAX_USER+2)*MAC_DATA_BUF_SIZE)	// number of frames
+#define MAC_FRAME_POOL_CACHE 16									// max free entries cached per thread
+
+typedef struct {
+	uint drops;			// allocations that failed because all frames were in use
+	uint oversize;		// allocations that failed because the frame was larger than MAC_MTU
+	int shared_free;	// entries in the shared free list, without the thread caches
+} mac_frame_pool_stats_s;
+
+// Get a frame with a buffer for size bytes.
+// Returns NULL if size exceeds MAC_MTU or the pool is exhausted
+MacDataFrame mac_frame_pool_alloc(uint size);
+// Return a frame to the pool. Can be called from any thread
+void mac_frame_pool_free(MacDataFrame frame);
+
+void mac_frame_pool_get_stats(mac_frame_pool_stats_s* stats);
+
+#endif /* MAC_MAC_FRAME_POOL_H_ */
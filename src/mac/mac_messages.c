@@ -37,6 +37,8 @@ int mac_msg_get_hdrlen(CtrlID_e type)
 		return 2;
 	case session_end:
 		return 1;
+	case ul_harq_nack:
+		return 1;
 	case dl_data:
 		return 3;
 	case ul_req:
@@ -49,6 +51,8 @@ int mac_msg_get_hdrlen(CtrlID_e type)
 		return 1;
     case mcs_chance_req:
         return 1;
+	case harq_nack:
+		return 1;
 	case ul_data:
 		return 3;
 	default:
@@ -238,6 +242,32 @@ MacMessage mac_msg_create_mcs_change_req(uint is_ul, uint mcs)
     return genericmsg;
 }
 
+// DL and UL NACKs share the header layout
+static MacMessage mac_msg_create_nack(CtrlID_e type, uint subframe, uint slot)
+{
+	MacMessage genericmsg = mac_msg_create_generic(type);
+	MacHARQNack* msg = &genericmsg->hdr.HARQNack;
+
+	genericmsg->hdr_bin[0] = (type & 0b111)<< 5;
+	genericmsg->hdr_bin[0] |= (subframe & 0b111) << 2;
+	genericmsg->hdr_bin[0] |= (slot & 0b11);
+
+	msg->ctrl_id = type & 0b111;
+	msg->subframe = subframe;
+	msg->slot = slot;
+	return genericmsg;
+}
+
+MacMessage mac_msg_create_harq_nack(uint subframe, uint slot)
+{
+	return mac_msg_create_nack(harq_nack, subframe, slot);
+}
+
+MacMessage mac_msg_create_ul_harq_nack(uint subframe, uint slot)
+{
+	return mac_msg_create_nack(ul_harq_nack, subframe, slot);
+}
+
 MacMessage mac_msg_create_ul_data(uint data_length, uint8_t final,
 							uint8_t seqNr, uint8_t fragNr, uint8_t* data)
 {
@@ -359,6 +389,13 @@ void mac_msg_parse_mcs_change_req(MacMessage msg)
     msg->hdr.MCSChangeReq.mcs = (msg->hdr_bin[0] & 0b1111);
 }
 
+void mac_msg_parse_harq_nack(MacMessage msg)
+{
+	msg->hdr.HARQNack.ctrl_id = msg->type & 0b111;
+	msg->hdr.HARQNack.subframe = (msg->hdr_bin[0] & 0b11100) >>2;
+	msg->hdr.HARQNack.slot = msg->hdr_bin[0] & 0b11;
+}
+
 void mac_msg_parse_ul_data(MacMessage msg)
 {
 	msg->hdr.ULdata.ctrl_id = msg->type & 0b111;
@@ -417,6 +454,9 @@ MacMessage mac_msg_parse(uint8_t* buf, uint buflen, uint8_t ul_flag)
 		break;
 	case session_end:
 		break;
+	case ul_harq_nack:
+		mac_msg_parse_harq_nack(genericmsg);
+		break;
 	case dl_data:
 		mac_msg_parse_dl_data(genericmsg);
 		break;
@@ -435,6 +475,9 @@ MacMessage mac_msg_parse(uint8_t* buf, uint buflen, uint8_t ul_flag)
     case mcs_chance_req:
         mac_msg_parse_mcs_change_req(genericmsg);
         break;
+	case harq_nack:
+		mac_msg_parse_harq_nack(genericmsg);
+		break;
 	case ul_data:
 		mac_msg_parse_ul_data(genericmsg);
 		break;
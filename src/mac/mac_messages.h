@@ -39,12 +39,14 @@ typedef enum {
 	ul_mcs_info,
 	timing_advance,
 	session_end,
+	ul_harq_nack,
 	dl_data = 7,
 	ul_req = 9,
 	channel_quality,
 	keepalive,
 	control_ack,
     mcs_chance_req,
+	harq_nack,
 	ul_data = 15
 } CtrlID_e;
 
@@ -112,6 +114,14 @@ typedef struct {
     uint32_t mcs :4;
 } MacMCSChangeReq;
 
+// requests the retransmission of a data slot that failed the CRC. harq_nack is sent by the UE
+// for DL data slots, ul_harq_nack by the BS for UL data slots
+typedef struct {
+	uint32_t ctrl_id :3;
+	uint32_t subframe :3;
+	uint32_t slot :2;
+} MacHARQNack;
+
 typedef struct {
 	uint32_t ctrl_id :3;
 	uint32_t data_length : 12;
@@ -135,6 +145,7 @@ typedef struct {
 		MacKeepalive Keepalive;
 		MacControlAck ControlAck;
         MacMCSChangeReq MCSChangeReq;
+		MacHARQNack HARQNack;
 		MacULdata ULdata;
 	} hdr;
 	CtrlID_e type;
@@ -157,6 +168,7 @@ MacMessage mac_msg_create_dl_mcs_info(uint mcs);
 MacMessage mac_msg_create_ul_mcs_info(uint mcs);
 MacMessage mac_msg_create_timing_advance(uint timingAdvance);
 MacMessage mac_msg_create_session_end();
+MacMessage mac_msg_create_ul_harq_nack(uint subframe, uint slot);
 MacMessage mac_msg_create_dl_data(uint data_length, uint8_t fragment,
 								  uint8_t seqNr, uint8_t fragNr, uint8_t* data );
 // Uplink
@@ -165,6 +177,7 @@ MacMessage mac_msg_create_channel_quality(uint quality_idx);
 MacMessage mac_msg_create_keepalive();
 MacMessage mac_msg_create_control_ack(uint acked_ctrl_id);
 MacMessage mac_msg_create_mcs_change_req(uint is_ul, uint mcs);
+MacMessage mac_msg_create_harq_nack(uint subframe, uint slot);
 MacMessage mac_msg_create_ul_data(uint data_length, uint8_t final,
 								  uint8_t seqNr, uint8_t fragNr, uint8_t* data);
 
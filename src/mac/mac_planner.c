@@ -0,0 +1,140 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "mac_planner.h"
+#include "mac_bs.h"
+#include <string.h>
+
+// Candidate slot orders of the head subframe: default order and slots 2/3 first.
+// Slots 0/1 and 2/3 collide with different slots of the other link direction
+#define NUM_SLOT_ORDERS 2
+static const uint8_t slot_orders[NUM_SLOT_ORDERS][MAC_DLDATA_SLOTS] = {{0,1,2,3},{2,3,0,1}};
+
+// Mark the users that would collide with the DL/UL slot of row k of the plan
+static void mac_plan_blocked(mac_plan_s* plan, uint k, uint slot, uint dir, uint8_t* blocked)
+{
+	memset(blocked, 0, MAX_USER);
+	if (dir == DL) {
+		// the user has the overlapping UL slot in the previous subframe
+		if (slot<2)
+			blocked[plan->ul[k-1][slot+2]] = 1;
+	} else if (slot<2) {
+		// the user has the overlapping DL slot. Every user has to receive broadcast slots
+		if (plan->dl[k][slot+2] == USER_BROADCAST)
+			memset(blocked, 1, MAX_USER);
+		blocked[plan->dl[k][slot+2]] = 1;
+	}
+	// users in the UL ctrl slots of the previous subframe cannot receive the DL ctrl slot
+	for (int i=0; i<MAC_ULCTRL_SLOTS; i++)
+		blocked[plan->ulctrl[k-1][i]] = 1;
+}
+
+// Assign the data slots of row k of the plan, which is subframe sfn, in the given order.
+// Returns the number of assigned slots
+static uint mac_plan_fill(mac_sched sched, mac_plan_s* plan, uint k, uint sfn,
+						  const uint8_t* dl_order, const uint8_t* ul_order)
+{
+	uint8_t blocked[MAX_USER];
+	uint filled = 0;
+
+	for (int i=0; i<MAC_DLDATA_SLOTS; i++) {
+		uint slot = dl_order[i];
+		// skip used slots and the sync slot
+		if (plan->dl[k][slot] != USER_UNUSED || (sfn==0 && slot==MAC_DLDATA_SLOTS-1))
+			continue;
+		mac_plan_blocked(plan, k, slot, DL, blocked);
+		plan->dl[k][slot] = mac_sched_select(sched, &plan->run, DL, blocked);
+		filled += plan->dl[k][slot] != USER_UNUSED;
+	}
+	for (int i=0; i<MAC_ULDATA_SLOTS; i++) {
+		uint slot = ul_order[i];
+		// skip the UL slot that overlaps with the sync slot and the RA slot
+		if (sfn==0 && (slot==1 || slot==MAC_ULDATA_SLOTS-1))
+			continue;
+		mac_plan_blocked(plan, k, slot, UL, blocked);
+		plan->ul[k][slot] = mac_sched_select(sched, &plan->run, UL, blocked);
+		filled += plan->ul[k][slot] != USER_UNUSED;
+	}
+	// users with a UL data slot send their control messages in the data slot.
+	// Retransmissions are sent unchanged, so users that only retransmit keep their UL ctrl slot
+	for (int i=0; i<MAC_ULCTRL_SLOTS; i++) {
+		uint userid = plan->ulctrl[k][i];
+		if (userid != USER_UNUSED && num_slot_assigned(plan->ul[k], MAC_ULDATA_SLOTS, userid) > plan->ul_retx[userid])
+			plan->ulctrl[k][i] = USER_UNUSED;
+	}
+	// the UE sends the requested retransmissions in its next UL data slots
+	for (int userid=0; userid<MAX_USER; userid++) {
+		uint assigned = num_slot_assigned(plan->ul[k], MAC_ULDATA_SLOTS, userid);
+		plan->ul_retx[userid] = assigned < plan->ul_retx[userid] ? plan->ul_retx[userid]-assigned : 0;
+	}
+	return filled;
+}
+
+void mac_plan_subframe(struct MacBS_s* mac, mac_sched sched, const mac_sched_run_s* run, uint sfn,
+					   uint8_t* dl, uint8_t* ul, uint8_t* ulctrl)
+{
+	// plan with the fixed assignments
+	mac_plan_s base = {0};
+	uint prev_sfn = (uint)(sfn-1) % FRAME_LEN;
+	memcpy(base.ul[0], mac->ul_data_assignments[prev_sfn], MAC_ULDATA_SLOTS);
+	memcpy(base.ulctrl[0], mac->ul_ctrl_assignments[prev_sfn], MAC_ULCTRL_SLOTS);
+	memcpy(base.dl[1], dl, MAC_DLDATA_SLOTS);
+	memcpy(base.ulctrl[1], ulctrl, MAC_ULCTRL_SLOTS);
+	for (int k=2; k<=MAC_PLAN_WINDOW; k++)
+		for (int i=0; i<MAC_ULCTRL_SLOTS; i++)
+			base.ulctrl[k][i] = mac_bs_get_ulctrl_user(mac, (sfn+k-1) % FRAME_LEN, i);
+	for (int userid=0; userid<MAX_USER; userid++)
+		if (mac->UE[userid] != NULL)
+			base.ul_retx[userid] = phy_bs_ul_harq_pending(mac->phy, userid);
+	base.run = *run;
+
+	// upper bound of the slots that can be filled in the window. The search stops once it is reached
+	uint wanted = 0, free_slots = 0;
+	for (int dir=DL; dir<=UL; dir++)
+		for (int userid=0; userid<MAX_USER; userid++)
+			if (run->queue[dir][userid] > 0)
+				wanted += (run->queue[dir][userid]-1) / run->slot_size[dir][userid] + 1;
+	for (int k=1; k<=MAC_PLAN_WINDOW; k++) {
+		uint k_sfn = (sfn+k-1) % FRAME_LEN;
+		free_slots += num_slot_assigned(base.dl[k], MAC_DLDATA_SLOTS, USER_UNUSED) + MAC_ULDATA_SLOTS;
+		if (k_sfn == 0)
+			free_slots -= 3;	// sync slot, UL slot overlapping with the sync slot, RA slot
+	}
+	uint bound = wanted < free_slots ? wanted : free_slots;
+
+	mac_plan_s plan, best;
+	uint best_total = 0, best_head = 0;
+	for (int c=0; c<NUM_SLOT_ORDERS*NUM_SLOT_ORDERS; c++) {
+		plan = base;
+		uint head = mac_plan_fill(sched, &plan, 1, sfn, slot_orders[c/NUM_SLOT_ORDERS], slot_orders[c%NUM_SLOT_ORDERS]);
+		uint total = head;
+		for (int k=2; k<=MAC_PLAN_WINDOW; k++)
+			total += mac_plan_fill(sched, &plan, k, (sfn+k-1) % FRAME_LEN, slot_orders[0], slot_orders[0]);
+		if (c==0 || total > best_total || (total == best_total && head > best_head)) {
+			best = plan;
+			best_total = total;
+			best_head = head;
+		}
+		if (best_total == bound)
+			break;
+	}
+
+	memcpy(dl, best.dl[1], MAC_DLDATA_SLOTS);
+	memcpy(ul, best.ul[1], MAC_ULDATA_SLOTS);
+	memcpy(ulctrl, best.ulctrl[1], MAC_ULCTRL_SLOTS);
+}
@@ -0,0 +1,63 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef MAC_MAC_PLANNER_H_
+#define MAC_MAC_PLANNER_H_
+
+#include "mac_config.h"
+#include "mac_scheduler.h"
+
+// Lookahead planner for the data slots of the BS.
+// Clients are half-duplex. A user cannot get
+//  - a DL slot 0/1 if it has the UL slot 2/3 in the previous subframe,
+//  - a UL slot 0/1 if it (or broadcast) has the DL slot 2/3 in the same subframe,
+//  - any slot in the subframe after its UL ctrl slot, since it cannot receive the DL ctrl slot.
+// Assigning the slots greedily one subframe at a time leaves slots empty when the users in line
+// collide with their own assignments. The planner plans the DL, UL and UL ctrl slots of
+// MAC_PLAN_WINDOW subframes jointly and fixes only the first (head) subframe in every scheduler run:
+//  - Candidate plans of the head subframe offer the DL and the UL slots to the scheduler policy
+//    in the default order or with slots 2/3 first. Every candidate is completed by planning the
+//    rest of the window in the default order, assuming that no new data arrives.
+//  - The candidate that fills the most slots in the window wins. Ties go to the candidate that
+//    fills the most slots in the head subframe, then to the default order.
+//  - The UL ctrl slot of a user that got a UL data slot in the same subframe is dropped, since the
+//    user can send its control messages in the data slot. The user can then be assigned in the
+//    next subframe. If the data slots are HARQ retransmissions, which are sent unchanged and
+//    carry no new control messages, the UL ctrl slot is kept.
+// The policy decides which user gets a slot, the planner only decides in which order the slots are offered.
+
+// Assignments of the planning window. Row 0 is the subframe before the head subframe, which is fixed
+typedef struct {
+	uint8_t dl[MAC_PLAN_WINDOW+1][MAC_DLDATA_SLOTS];
+	uint8_t ul[MAC_PLAN_WINDOW+1][MAC_ULDATA_SLOTS];
+	uint8_t ulctrl[MAC_PLAN_WINDOW+1][MAC_ULCTRL_SLOTS];
+	uint8_t ul_retx[MAX_USER];		// UL data slots of the user that still wait for a retransmission
+	mac_sched_run_s run;
+} mac_plan_s;
+
+struct MacBS_s;
+
+// Plan the data slots of the window that starts with subframe sfn and return the assignments
+// of subframe sfn in dl, ul and ulctrl.
+// On entry, dl holds the DL slots that are already used (broadcast) and ulctrl the UL ctrl
+// assignments of the subframe. The UL ctrl slots of the following subframes are predicted with
+// mac_bs_get_ulctrl_user(). run holds the selection state from mac_sched_begin()
+void mac_plan_subframe(struct MacBS_s* mac, mac_sched sched, const mac_sched_run_s* run, uint sfn,
+					   uint8_t* dl, uint8_t* ul, uint8_t* ulctrl);
+
+#endif /* MAC_MAC_PLANNER_H_ */
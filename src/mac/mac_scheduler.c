@@ -0,0 +1,137 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "mac_scheduler.h"
+#include "mac_bs.h"
+#include <string.h>
+
+struct mac_sched_s {
+	mac_sched_type type;
+};
+
+mac_sched mac_sched_create(mac_sched_type type)
+{
+	mac_sched sched = calloc(sizeof(struct mac_sched_s),1);
+	sched->type = type;
+	return sched;
+}
+
+void mac_sched_destroy(mac_sched sched)
+{
+	free(sched);
+}
+
+mac_sched_type mac_sched_get_type(mac_sched sched)
+{
+	return sched->type;
+}
+
+const char* mac_sched_type_str(mac_sched_type type)
+{
+	switch (type) {
+	case MAC_SCHED_ROUND_ROBIN:
+		return "round robin";
+	case MAC_SCHED_PROP_FAIR:
+		return "proportional fair";
+	default:
+		return "unknown";
+	}
+}
+
+void mac_sched_begin(mac_sched sched, struct MacBS_s* mac, mac_sched_run_s* run)
+{
+	memset(run, 0, sizeof(mac_sched_run_s));
+	for (int userid=0; userid<MAX_USER; userid++) {
+		user_s* ue = mac->UE[userid];
+		if (ue == NULL)
+			continue;
+		for (int dir=DL; dir<=UL; dir++) {
+			ue->sched.served[dir] = 0;
+			run->queue[dir][userid] = mac_bs_get_queue_size(mac, ue, dir);
+			run->slot_size[dir][userid] = mac_bs_get_slot_size(mac, ue, dir);
+			// the HOL delay counts from the moment the queue became non-empty or was served last
+			if (run->queue[dir][userid] == 0) {
+				ue->sched.backlogged[dir] = 0;
+			} else if (!ue->sched.backlogged[dir]) {
+				ue->sched.backlogged[dir] = 1;
+				ue->sched.hol_time[dir] = mac->subframe_cnt;
+			}
+			float rate = ue->sched.avg_rate[dir] > 1.0f ? ue->sched.avg_rate[dir] : 1.0f;
+			float hol_delay = ue->sched.backlogged[dir] ? mac->subframe_cnt - ue->sched.hol_time[dir] : 0;
+			run->weight[dir][userid] = (1.0f + hol_delay/MAC_SCHED_HOL_NORM) / rate;
+		}
+	}
+
+	// round robin restarts at the first user in every subframe
+	user_s* ue = get_next_user(mac,0);
+	run->last_user[DL] = ue ? ue->userid : 0;
+	run->last_user[UL] = run->last_user[DL];
+}
+
+uint mac_sched_select(mac_sched sched, mac_sched_run_s* run, uint dir, const uint8_t* blocked)
+{
+	uint last = run->last_user[dir];
+	uint best = USER_UNUSED;
+	float best_metric = 0;
+
+	// iterate over all users, starting after the last user that got a slot
+	for (int i=1; i<=MAX_USER; i++) {
+		uint userid = (last+i) % MAX_USER;
+		uint queue = run->queue[dir][userid];
+		if (queue == 0 || blocked[userid])
+			continue;
+		if (sched->type == MAC_SCHED_ROUND_ROBIN) {
+			best = userid;
+			break;
+		}
+		// proportional fair metric, limited to the bytes the user can fill
+		uint slot_size = run->slot_size[dir][userid];
+		float metric = (queue < slot_size ? queue : slot_size) * run->weight[dir][userid];
+		if (best == USER_UNUSED || metric > best_metric) {
+			best = userid;
+			best_metric = metric;
+		}
+	}
+
+	if (best == USER_UNUSED)
+		return USER_UNUSED;
+	run->last_user[dir] = best;
+	uint slot_size = run->slot_size[dir][best];
+	run->queue[dir][best] = run->queue[dir][best] > slot_size ? run->queue[dir][best] - slot_size : 0;
+	return best;
+}
+
+void mac_sched_assigned(mac_sched sched, struct MacBS_s* mac, uint userid, uint dir)
+{
+	user_s* ue = mac->UE[userid];
+	uint capacity = mac_bs_get_slot_size(mac, ue, dir);
+	uint queue = mac_bs_get_queue_size(mac, ue, dir);
+	ue->sched.served[dir] += queue < capacity ? queue : capacity;
+	ue->sched.hol_time[dir] = mac->subframe_cnt;
+}
+
+void mac_sched_end(mac_sched sched, struct MacBS_s* mac)
+{
+	for (int userid=0; userid<MAX_USER; userid++) {
+		user_s* ue = mac->UE[userid];
+		if (ue == NULL)
+			continue;
+		for (int dir=DL; dir<=UL; dir++)
+			ue->sched.avg_rate[dir] += (ue->sched.served[dir] - ue->sched.avg_rate[dir]) / MAC_SCHED_PF_WINDOW;
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef MAC_MAC_SCHEDULER_H_
+#define MAC_MAC_SCHEDULER_H_
+
+#include "mac_config.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+// Scheduler policies of the BS. The policy selects the user of every DL and UL data slot
+// of a subframe. Only users that can be assigned to the slot are considered, i.e. users with
+// pending data, control messages or HARQ retransmissions that do not collide with a slot in
+// the other link direction. The slots are visited in the order chosen by the planner (mac_planner.h).
+//
+// MAC_SCHED_ROUND_ROBIN: Round robin over the users, restarting at the first user in every subframe
+// MAC_SCHED_PROP_FAIR:   Proportional fair. Every slot goes to the user with the largest metric
+//                        min(slot size, queue size) / averaged served rate * (1 + HOL delay/MAC_SCHED_HOL_NORM)
+//                        Ties are resolved round robin.
+
+typedef enum {
+	MAC_SCHED_ROUND_ROBIN,
+	MAC_SCHED_PROP_FAIR
+} mac_sched_type;
+
+// default policy of the BS
+#define MAC_SCHED_DEFAULT MAC_SCHED_PROP_FAIR
+
+// time constant of the averaged served rate in subframes
+#define MAC_SCHED_PF_WINDOW 32
+// HOL delay in subframes that doubles the metric of a user
+#define MAC_SCHED_HOL_NORM 8
+
+// Scheduler state of a user. Part of the user struct, zeroed when the user is created
+// Index: DL/UL
+typedef struct {
+	float avg_rate[2];			// averaged served bytes per subframe
+	uint served[2];				// bytes assigned in the current subframe
+	uint backlogged[2];			// set while the user has data waiting
+	long long unsigned int hol_time[2]; // subframe counter since which the user waits for service
+} mac_sched_ue_s;
+
+// Selection state of one scheduler run. The planner copies it to try alternative slot assignments
+// Index: DL/UL, userid
+typedef struct {
+	uint last_user[2];				// last user that got a slot
+	uint queue[2][MAX_USER];		// bytes the user has queued and that were not assigned yet
+	uint slot_size[2][MAX_USER];	// payload size of a data slot of the user
+	float weight[2][MAX_USER];		// proportional fair weight: (1 + HOL delay/MAC_SCHED_HOL_NORM) / averaged rate
+} mac_sched_run_s;
+
+struct MacBS_s;
+typedef struct mac_sched_s* mac_sched;
+
+mac_sched mac_sched_create(mac_sched_type type);
+void mac_sched_destroy(mac_sched sched);
+
+mac_sched_type mac_sched_get_type(mac_sched sched);
+const char* mac_sched_type_str(mac_sched_type type);
+
+// Has to be called at the start of every scheduler run, before any data slot is assigned.
+// Initializes run with the queues of all users
+void mac_sched_begin(mac_sched sched, struct MacBS_s* mac, mac_sched_run_s* run);
+// Returns the user with queued data that gets the next data slot or USER_UNUSED if there is none.
+// dir: DL or UL. Users with blocked[userid] set are skipped. The slot is deducted from the queue in run
+uint mac_sched_select(mac_sched sched, mac_sched_run_s* run, uint dir, const uint8_t* blocked);
+// Has to be called when the slot was assigned to the user, before the slot is filled
+void mac_sched_assigned(mac_sched sched, struct MacBS_s* mac, uint userid, uint dir);
+// Has to be called after all data slots of the subframe were assigned
+void mac_sched_end(mac_sched sched, struct MacBS_s* mac);
+
+#endif /* MAC_MAC_SCHEDULER_H_ */
@@ -28,7 +28,7 @@
 MacUE mac_ue_init()
 {
 	MacUE mac = calloc(sizeof(struct MacUE_s), 1);
-	mac->msg_control_queue = ringbuf_create(MAC_CTRL_MSG_BUF_SIZE);
+	mac->msg_control_queue = ringbuf_create(MAC_CTRL_MSG_BUF_SIZE, RINGBUF_MPSC);
 	mac->fragmenter = mac_frag_init();
 	mac->reassembler = mac_assmbl_init();
     mac->reassembler_brcst = mac_assmbl_init();
@@ -47,6 +47,9 @@ void mac_ue_destroy(MacUE mac)
 		mac_msg_destroy(p);
 	}
 	ringbuf_destroy(mac->msg_control_queue);
+	for (int sfn=0; sfn<FRAME_LEN; sfn++)
+		for (int i=0; i<MAC_ULDATA_SLOTS; i++)
+			mac_harq_tx_free(&mac->ul_harq[sfn][i]);
 	free(mac);
 }
 
@@ -123,6 +126,11 @@ int mac_ue_handle_message(MacUE mac, MacMessage msg, uint is_broadcast)
 			LOG(INFO,"[MAC UE] switching to UL MCS %d\n",mac->ul_mcs);
 		}
 		break;
+	case ul_harq_nack:
+		// applied by the scheduler, which owns the copies of the UL data slots
+		atomic_fetch_or(&mac->ul_harq_nacks,
+						1u << (msg->hdr.HARQNack.subframe*MAC_ULDATA_SLOTS + msg->hdr.HARQNack.slot));
+		break;
 	case timing_advance:
 		mac->timing_advance = msg->hdr.TimingAdvance.timingAdvance;
 		LOG(INFO,"[MAC UE] Updated TimingAdvance to: %d\n",mac->timing_advance);
@@ -174,6 +182,66 @@ void mac_ue_set_assignments(MacUE mac, uint8_t* dlslot, uint8_t* ulslot, uint8_t
 	memcpy(mac->ul_ctrl_assignments, ulctrl, MAC_ULCTRL_SLOTS);
 }
 
+// Set the HARQ retransmission flags decoded in the DL ctrl slot of the given subframe.
+// Bit i of retx is set if UL data slot i has to carry a retransmission. The UL data slots
+// that are assigned in the same DL ctrl slot belong to the given subframe
+void mac_ue_set_ul_retx(MacUE mac, uint subframe, uint8_t retx)
+{
+	mac->ul_subframe = subframe;
+	mac->ul_retx = retx;
+}
+
+// Mark the UL data slots NACKed by the BS for retransmission. Called by the scheduler
+static void mac_ue_apply_ul_harq_nacks(MacUE mac)
+{
+	uint nacks = atomic_exchange(&mac->ul_harq_nacks, 0);
+	for (int sfn=0; nacks && sfn<FRAME_LEN; sfn++) {
+		for (int i=0; i<MAC_ULDATA_SLOTS; i++) {
+			if (!(nacks & (1u << (sfn*MAC_ULDATA_SLOTS+i))))
+				continue;
+			mac_harq_tx_s* tx = &mac->ul_harq[sfn][i];
+			// subframe and slot numbers are reused every frame, so only NACKs for the last frame are valid
+			if (tx->tx_cnt > 0 && tx->tx_cnt < HARQ_MAX_TX && mac->subframe_cnt - tx->time < FRAME_LEN) {
+				tx->retx = 1;
+				LOG_SFN_MAC(DEBUG,"[MAC UE] NACK for UL slot %d of subframe %d\n",i,sfn);
+			}
+		}
+	}
+}
+
+// Returns the oldest UL data slot whose retransmission was requested. NULL if there is none
+static mac_harq_tx_s* mac_ue_get_ul_retx(MacUE mac)
+{
+	mac_harq_tx_s* retx = NULL;
+	for (int sfn=0; sfn<FRAME_LEN; sfn++) {
+		for (int i=0; i<MAC_ULDATA_SLOTS; i++) {
+			mac_harq_tx_s* tx = &mac->ul_harq[sfn][i];
+			if (!tx->retx || tx->tx_cnt == 0)
+				continue;
+			if (tx->mcs != mac->ul_mcs) {
+				// the BS can only combine slots with the same mcs
+				tx->retx = 0;
+				continue;
+			}
+			if (retx == NULL || tx->time < retx->time)
+				retx = tx;
+		}
+	}
+	return retx;
+}
+
+// Add the NACKs of the failed DL data slots to the logical channel
+static void mac_ue_add_harq_nack(MacUE mac, LogicalChannel chan)
+{
+	uint subframe, slot_nr;
+	while (lchan_unused_bytes(chan) >= mac_msg_get_hdrlen(harq_nack) &&
+		   phy_ue_get_dl_harq_nack(mac->phy, &subframe, &slot_nr)) {
+		MacMessage msg = mac_msg_create_harq_nack(subframe, slot_nr);
+		lchan_add_message(chan, msg);
+		mac_msg_destroy(msg);
+	}
+}
+
 // UE scheduler. Is called once per subframe
 // Will check the ctrl message and data message queues and try
 // to map it to slots. Before running the scheduler, ensure that
@@ -184,6 +252,7 @@ void mac_ue_run_scheduler(MacUE mac)
 	uint slotsize = get_tbs_size(mac->phy->common,mac->ul_mcs)/8;
 	int num_assigned = num_slot_assigned(mac->ul_data_assignments,MAC_ULDATA_SLOTS,UE_ASSIGNED);
 	uint next_sfn = (mac->phy->common->tx_subframe+1) % 2; // subframe for which the scheduler is run
+	mac_ue_apply_ul_harq_nacks(mac);
 	// Log schedule
 	LOG(TRACE,"[MAC UE] Scheduler user assignments:\n");
 	LOG(TRACE,"         DL data slots: %4d %4d %4d %4d\n", mac->dl_data_assignments[0],
@@ -214,7 +283,22 @@ void mac_ue_run_scheduler(MacUE mac)
 		for (int i=0; i<MAC_ULDATA_SLOTS; i++) {
 			if (mac->ul_data_assignments[i] == 1) {
 				num_assigned--;
+				mac_harq_tx_s* tx = &mac->ul_harq[mac->ul_subframe][i];
+				// slots marked by the BS carry the oldest NACKed slot, unchanged.
+				// If there is none, e.g. since the NACK got lost, new data is sent
+				mac_harq_tx_s* retx = (mac->ul_retx & (1<<i)) ? mac_ue_get_ul_retx(mac) : NULL;
+				if (retx) {
+					LogicalChannel chan = mac_harq_tx_get_chan(retx);
+					uint tx_cnt = retx->tx_cnt+1;
+					retx->tx_cnt = 0;
+					phy_map_ulslot(mac->phy,chan,next_sfn, i, mac->ul_mcs);
+					mac_harq_tx_store(tx, chan, mac->userid, mac->ul_mcs, tx_cnt, mac->subframe_cnt);
+					lchan_destroy(chan);
+					mac->stats.harq_retx++;
+					continue;
+				}
 				LogicalChannel chan = lchan_create(slotsize, CRC16);
+				mac_ue_add_harq_nack(mac, chan);
 				lchan_add_all_msgs(chan, mac->msg_control_queue);
 				if (queuesize>0) {
 					// client is assigned to slot and has data
@@ -240,6 +324,7 @@ void mac_ue_run_scheduler(MacUE mac)
 				}
 				lchan_calc_crc(chan);
 				phy_map_ulslot(mac->phy,chan,next_sfn, i, mac->ul_mcs);
+				mac_harq_tx_store(tx, chan, mac->userid, mac->ul_mcs, 1, mac->subframe_cnt);
 				lchan_destroy(chan);
 				queuesize = mac_frag_get_buffersize(mac->fragmenter);
 			}
@@ -264,6 +349,7 @@ void mac_ue_run_scheduler(MacUE mac)
 
 		// create logical channel with control messages
 		LogicalChannel chan = lchan_create(get_ulctrl_slot_size(mac->phy->common)/8,CRC8);
+		mac_ue_add_harq_nack(mac, chan);
 		lchan_add_all_msgs(chan, mac->msg_control_queue);
 		lchan_calc_crc(chan);
 		// find the ulctrl slot in which we can transmit
@@ -355,6 +441,10 @@ void* mac_ue_tap_rx_th(void* arg)
 		// forward to MAC
 		if (mac->tapdevice->bytes_rec>0) {
 			MacDataFrame frame = dataframe_create(mac->tapdevice->bytes_rec);
+			if (frame == NULL) {
+				LOG(DEBUG,"[MAC UE] no free frame, dropping TAP data\n");
+				continue;
+			}
 			memcpy(frame->data,mac->tapdevice->buffer,frame->size);
 			if (!mac_ue_add_txdata(mac, frame)) {
 				dataframe_destroy(frame);
@@ -22,8 +22,10 @@
 #include "mac_channels.h"
 #include "mac_common.h"
 #include "mac_config.h"
+#include <stdatomic.h>
 #include "mac_fragmentation.h"
 #include "tap_dev.h"
+#include "../phy/phy_config.h"
 
 struct PhyUE_s;
 typedef struct PhyUE_s* PhyUE;
@@ -45,6 +47,15 @@ struct MacUE_s {
 	uint8_t ul_data_assignments[MAC_ULDATA_SLOTS];
 	uint8_t dl_data_assignments[MAC_DLDATA_SLOTS];
 
+	// copies of the transmitted UL data slots for HARQ retransmissions
+	// 1. Index: subframe, 2. Index: slot
+	mac_harq_tx_s ul_harq[FRAME_LEN][MAC_ULDATA_SLOTS];
+	uint ul_subframe;	// subframe of the current UL data slot assignments
+	uint8_t ul_retx;	// bit i is set if the BS requested a retransmission in UL data slot i
+	// UL NACKs received from the BS. Bit subframe*MAC_ULDATA_SLOTS+slot is set by the thread that
+	// delivers the DL slots and applied to ul_harq by the scheduler
+	atomic_uint ul_harq_nacks;
+
 	uint8_t is_associated;
 
 	long unsigned int last_assignment;	// Subframe in which user was assigned a slot the last time
@@ -65,6 +76,7 @@ void  mac_ue_set_phy_interface(MacUE mac, PhyUE phy);
 
 /************** MAC INTERFACE FUNCTIONS *************************/
 void mac_ue_set_assignments(MacUE mac, uint8_t* dlslot, uint8_t* ulslot, uint8_t* ulctrl);
+void mac_ue_set_ul_retx(MacUE mac, uint subframe, uint8_t retx);
 void mac_ue_run_scheduler(MacUE mac);
 void mac_ue_rx_channel(MacUE mac, LogicalChannel chan, uint is_broadcast);
 int  mac_ue_add_txdata(MacUE mac, MacDataFrame frame);
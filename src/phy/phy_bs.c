@@ -17,14 +17,17 @@
  */
 
 #include "phy_bs.h"
+#include "../platform/pluto_iq.h"
 
 #ifdef PHY_TEST_BER
 #include "../runtime/test.h"
 #endif
 
 // Forward declarations of local helper functions
-int phy_bs_proc_rach(PhyBS phy, int timing_diff);
+void phy_bs_proc_rach(PhyBS phy, int timing_diff);
 int _bs_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd);
+static void phy_bs_decode_job(void* userd, phy_slot_job job, phy_rx_ctx ctx);
+static void phy_bs_deliver_job(void* userd, phy_slot_job job);
 
 
 // callback for OFDM RACH receiver object
@@ -32,9 +35,12 @@ int _bs_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd);
 int _ofdm_rx_rach_cb(float complex* X,unsigned char* p, uint M, void* userd)
 {
 	PhyBS phy = (PhyBS)userd;
-	memcpy(phy->rach_buffer,X,sizeof(float complex)*nfft);
-	phy_bs_proc_rach(phy, phy->rach_timing);
-
+	// only the first symbol carries the association request. The request is
+	// decoded once ofdmframesync_execute() returned, since decoding passes the sync object on
+	if (!phy->rach_pending) {
+		memcpy(phy->rach_buffer,X,sizeof(float complex)*nfft);
+		phy->rach_pending = 1;
+	}
 	return 0;
 }
 
@@ -51,12 +57,31 @@ PhyBS phy_bs_init()
 	// Create OFDM frame generator: nFFt, CPlen, taperlen, subcarrier alloc
 	phy->fg = ofdmframegen_create(nfft, cp_len, 0, phy->common->pilot_sc);
 
-	// Create OFDM receiver
+	// The sync sequence is constant. Generate the time domain symbols once
+	for (int i=0; i<3; i++)
+		phy->sync_symbols[i] = malloc(sizeof(float complex)*(nfft+cp_len));
+	ofdmframegen_write_S0a(phy->fg, phy->sync_symbols[0]);
+	ofdmframegen_write_S0b(phy->fg, phy->sync_symbols[1]);
+	ofdmframegen_write_S1(phy->fg, phy->sync_symbols[2]);
+
+	// Create the OFDM receivers. The RA slot receiver is acquired when the RA slot starts
+	pthread_mutex_init(&phy->rx_pool_mutex, NULL);
+	for (int i=0; i<BS_RX_POOL_SIZE; i++) {
+		phy->rx_pool[i] = ofdmframesync_create(nfft,cp_len,0,phy->common->pilot_sc,_ofdm_rx_rach_cb, phy);
+		phy->rx_pool_free[i] = phy->rx_pool[i];
+	}
+	phy->rx_pool_num_free = BS_RX_POOL_SIZE;
 	phy->fs_rach = NULL;
 
     // alloc buffer for dl control slot
     phy->dlctrl_buf = calloc((num_data_sc+num_pilot_sc)*DLCTRL_LEN/8, 1);
 
+	// alloc the symbol buffers of the dl control slot cache
+	re_map dlctrl_map = phy_get_re_map(phy->common, RE_MAP_DLCTRL, 0);
+	for (int i=0; i<DLCTRL_CACHE_SIZE; i++) {
+		phy->dlctrl_cache[i].re = malloc(sizeof(float complex)*dlctrl_map->len);
+	}
+
 	// Alloc memory for slot assignments
 	phy->ulslot_assignments = malloc(2*sizeof(uint8_t*));
 	phy->ulctrl_assignments = malloc(2*sizeof(uint8_t*));
@@ -74,6 +99,18 @@ PhyBS phy_bs_init()
     // allocate memory for rach_buffer
     phy->rach_buffer = calloc(sizeof(float complex)*nfft,1);
 
+    // buffer for int16 samples that are converted to float
+    phy->rx_conv_buf = malloc(sizeof(float complex)*(nfft+cp_len)*BS_RX_MAX_RUN);
+
+    pthread_mutex_init(&phy->ul_user_mutex, NULL);
+    for (int i=0; i<MAX_USER; i++)
+        phy->ul_user[i].harq = phy_harq_create(phy->common->rx_ctx->buf_len);
+
+    // channel object for the sync info is reused every frame
+    phy->sync_info_chan = lchan_create(get_ulctrl_slot_size(phy->common)/8, CRC8);
+    phy->sync_info_f = calloc(sizeof(float complex)*nfft,1);
+    phy->sync_info_valid = 0;
+
     // Set RX position
     phy->common->rx_symbol = SUBFRAME_LEN - DL_UL_SHIFT - DL_UL_SHIFT_COMP_BS;
     phy->common->rx_subframe = FRAME_LEN -1;
@@ -88,12 +125,22 @@ PhyBS phy_bs_init()
 
 void phy_bs_destroy(PhyBS phy)
 {
+	// decode pending slots before the PHY objects are freed
+	if (phy->slot_queue)
+		phy_slot_queue_destroy(phy->slot_queue);
+
 	phy_common_destroy(phy->common);
 	ofdmframegen_destroy(phy->fg);
-	if (phy->fs_rach!=NULL)
-		ofdmframesync_destroy(phy->fs_rach);
+	// the pool owns all receivers, including the ones used by the RA slot and the MAC
+	for (int i=0; i<BS_RX_POOL_SIZE; i++)
+		ofdmframesync_destroy(phy->rx_pool[i]);
+	pthread_mutex_destroy(&phy->rx_pool_mutex);
 
 	free(phy->dlctrl_buf);
+	for (int i=0; i<DLCTRL_CACHE_SIZE; i++)
+		free(phy->dlctrl_cache[i].re);
+	for (int i=0; i<MAX_USER; i++)
+		phy_harq_destroy(phy->ul_user[i].harq);
 
 	for (int i=0; i<2; i++) {
 		free(phy->ulslot_assignments[i]);
@@ -106,23 +153,65 @@ void phy_bs_destroy(PhyBS phy)
 	free(phy->ul_symbol_alloc[1]);
 	free(phy->ul_symbol_alloc);
 
+	free(phy->rach_buffer);
+	free(phy->rx_conv_buf);
+	pthread_mutex_destroy(&phy->ul_user_mutex);
+	lchan_destroy(phy->sync_info_chan);
+	free(phy->sync_info_f);
+	for (int i=0; i<3; i++)
+		free(phy->sync_symbols[i]);
+
 	free(phy);
 }
 
+ofdmframesync phy_bs_acquire_receiver(PhyBS phy)
+{
+	ofdmframesync fs = NULL;
+	pthread_mutex_lock(&phy->rx_pool_mutex);
+	if (phy->rx_pool_num_free > 0)
+		fs = phy->rx_pool_free[--phy->rx_pool_num_free];
+	pthread_mutex_unlock(&phy->rx_pool_mutex);
+
+	if (fs) {
+		ofdmframesync_reset(fs);
+		ofdmframesync_set_cb(fs,_ofdm_rx_rach_cb,phy);
+	}
+	return fs;
+}
+
+void phy_bs_release_receiver(PhyBS phy, ofdmframesync fs)
+{
+	pthread_mutex_lock(&phy->rx_pool_mutex);
+	phy->rx_pool_free[phy->rx_pool_num_free++] = fs;
+	pthread_mutex_unlock(&phy->rx_pool_mutex);
+}
+
 void phy_bs_set_mac_interface(PhyBS phy, struct MacBS_s* mac)
 {
 	phy->mac = mac;
 }
 
-// Set the condition which is used to signal the slot processing thread
-void phy_bs_set_rx_slot_th_signal(PhyBS phy, pthread_cond_t* cond)
+// Start num_workers slot decoding threads
+// returns 1 on success, 0 if slots are still decoded in the RX thread
+int phy_bs_start_slot_workers(PhyBS phy, uint num_workers)
 {
-    phy->rx_slot_signal = cond;
+	phy->slot_queue = phy_slot_queue_create(phy->common, num_workers, phy_bs_decode_job, phy_bs_deliver_job, phy);
+	return phy->slot_queue != NULL;
 }
 
+// Create the sync info symbol, which broadcasts the rx and txgain of the basestation.
+// The subcarriers are only encoded again when the gains have changed.
 void phy_bs_write_sync_info(PhyBS phy, float complex* txbuf_time) {
     PhyCommon common = phy->common;
 
+    if (phy->sync_info_valid && phy->sync_info_rxgain == phy->rxgain && phy->sync_info_txgain == phy->txgain) {
+        // The time domain symbol is not cached: ofdmframegen_writesymbol() also advances
+        // the pilot sequence of the frame generator, which the following DL pilot symbols depend on
+        ofdmframegen_writesymbol(phy->fg,phy->sync_info_f,txbuf_time);
+        return;
+    }
+
+    phy_tx_scratch_s* scratch = &common->tx_scratch_symb;
     uint8_t *repacked_b;
     uint bytes_written = 0;
 
@@ -130,8 +219,9 @@ void phy_bs_write_sync_info(PhyBS phy, float complex* txbuf_time) {
     // fixed MCS 0: r=1/2, bps=2, 16tail bits.
     uint32_t blocksize = get_ulctrl_slot_size(phy->common);
 
-    LogicalChannel chan = lchan_create(blocksize / 8, CRC8);
-
+    // reuse the preallocated channel object
+    LogicalChannel chan = phy->sync_info_chan;
+    memset(chan->data, 0, chan->payload_len);
     chan->data[0] = phy->rxgain;
     chan->data[1] = phy->txgain;
     chan->writepos = 2;
@@ -142,44 +232,41 @@ void phy_bs_write_sync_info(PhyBS phy, float complex* txbuf_time) {
 
     // encode channel
     uint enc_len = fec_get_enc_msg_length(common->mcs_fec_scheme[mcs], blocksize / 8);
-    uint8_t *enc_b = malloc(enc_len);
+    uint8_t *enc_b = scratch->enc;
     fec_encode(common->mcs_fec[mcs], blocksize / 8, chan->data, enc_b);
 
     // repack bytes so that each array entry can be mapped to one symbol
     int num_repacked = enc_len * 8 / modem_get_bps(common->mcs_modem[mcs]);
-    repacked_b = malloc(num_repacked);
+    repacked_b = scratch->repacked;
     liquid_repack_bytes(enc_b, 8, enc_len, repacked_b, modem_get_bps(common->mcs_modem[mcs]), num_repacked,
                         &bytes_written);
 
     // modulate signal
     uint written_samps = 0;
-    float complex subcarriers[nfft];
-    for (int i=0; i<nfft; i++) {
-        if (common->pilot_sc[i] == OFDMFRAME_SCTYPE_DATA && written_samps<num_repacked) {
-            modem_modulate(common->mcs_modem[mcs],(uint)repacked_b[written_samps++], &subcarriers[i]);
-        }
-    }
+    phy_mod_buf(common, phy_get_re_map(common, RE_MAP_SYNCINFO, 0), phy->sync_info_f, mcs, repacked_b, num_repacked,
+                &written_samps);
+    phy->sync_info_rxgain = phy->rxgain;
+    phy->sync_info_txgain = phy->txgain;
+    phy->sync_info_valid = 1;
+
     // write symbol in time domain buffer
-    ofdmframegen_writesymbol(phy->fg,subcarriers,txbuf_time);
+    ofdmframegen_writesymbol(phy->fg,phy->sync_info_f,txbuf_time);
 }
 
 
 TIMECHECK_CREATE(timecheck_tx);
 TIMECHECK_CREATE(check_mod);
 TIMECHECK_CREATE(check_fec_tx);
-TIMECHECK_CREATE(check_interl_tx);
 // create phy data channel in frequency domain
 int phy_map_dlslot(PhyBS phy, LogicalChannel chan, uint subframe, uint8_t slot_nr, uint userid, uint mcs)
 {
     TIMECHECK_INIT(check_mod,"bs.tx_slot.mod",10000);
     TIMECHECK_INIT(check_fec_tx,"bs.tx_slot.fec",10000);
-    TIMECHECK_INIT(check_interl_tx,"bs.tx_slot.interleaver",10000);
     TIMECHECK_INIT(timecheck_tx,"bs.tx_slot",10000);
 
 	PhyCommon common = phy->common;
+	phy_tx_scratch_s* scratch = &common->tx_scratch;
 
-	uint8_t* repacked_b;
-	uint bytes_written=0;
 	uint32_t blocksize = get_tbs_size(phy->common, mcs);
 
 	if (blocksize/8 != chan->payload_len) {
@@ -194,35 +281,20 @@ int phy_map_dlslot(PhyBS phy, LogicalChannel chan, uint subframe, uint8_t slot_n
     TIMECHECK_START(check_fec_tx);
 	// encode channel
 	uint enc_len = fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],chan->payload_len);
-	uint8_t* enc_b = malloc(enc_len);
+	uint8_t* enc_b = scratch->enc;
 	fec_encode(common->mcs_fec[mcs], blocksize/8, chan->data, enc_b);
     TIMECHECK_STOP(check_fec_tx);
-    TIMECHECK_START(check_interl_tx);
-	//interleaving
-	uint8_t* interleaved_b = malloc(enc_len);
-	interleaver_encode(common->mcs_interlvr[mcs],enc_b,interleaved_b);
-    TIMECHECK_STOP(check_interl_tx);
     TIMECHECK_START(check_mod);
-	// repack bytes so that each array entry can be mapped to one symbol
-	int num_repacked = ceil(enc_len*8.0/modem_get_bps(common->mcs_modem[mcs]));
-	repacked_b = malloc(num_repacked);
-	liquid_repack_bytes(interleaved_b,8,enc_len,repacked_b,modem_get_bps(common->mcs_modem[mcs]),num_repacked,&bytes_written);
-
 	uint total_samps = 0;
-	uint first_symb = DLCTRL_LEN+2+(SLOT_LEN+1)*slot_nr;
-	uint last_symb = DLCTRL_LEN+2+(SLOT_LEN+1)*(slot_nr+1)-2;
+	re_map map = phy_get_re_map(common, RE_MAP_DLSLOT, slot_nr);
 
-	// modulate signal
-	phy_mod(phy->common,subframe,0,nfft-1,first_symb,last_symb, mcs, repacked_b, num_repacked, &total_samps);
+	// interleave and modulate signal
+	phy_mod_encoded(phy->common, subframe, map, mcs, enc_b, enc_len, &total_samps);
     TIMECHECK_STOP(check_mod);
     TIMECHECK_STOP(timecheck_tx);
-	free(interleaved_b);
-	free(enc_b);
-	free(repacked_b);
 
     TIMECHECK_INFO(timecheck_tx);
     TIMECHECK_INFO(check_mod);
-    TIMECHECK_INFO(check_interl_tx);
     TIMECHECK_INFO(check_fec_tx);
 	return 0;
 }
@@ -230,11 +302,32 @@ int phy_map_dlslot(PhyBS phy, LogicalChannel chan, uint subframe, uint8_t slot_n
 void phy_map_dlctrl(PhyBS phy, uint subframe)
 {
 	PhyCommon common = phy->common;
+	phy_tx_scratch_s* scratch = &common->tx_scratch;
+	re_map map = phy_get_re_map(common, RE_MAP_DLCTRL, 0);
+	float complex* slot_f = common->txdata_f[subframe][map->first_symb];
 
 	// use MCS0 for modulation
 	uint mcs = 0;
 
-	uint buf_size = (2*NUM_SLOT+NUM_ULCTRL_SLOT)/2;
+	uint buf_size = DLCTRL_PAYLOAD_LEN;
+
+	// check if this slot assignment was modulated before. Otherwise replace the least recently used entry
+	phy->dlctrl_cache_tick++;
+	dlctrl_cache_entry_s* entry = &phy->dlctrl_cache[0];
+	for (int i=0; i<DLCTRL_CACHE_SIZE; i++) {
+		dlctrl_cache_entry_s* e = &phy->dlctrl_cache[i];
+		if (e->last_used && memcmp(e->key, phy->dlctrl_buf, buf_size) == 0) {
+			for (int k=0; k<e->num_re; k++)
+				slot_f[map->idx[k]] = e->re[k];
+			e->last_used = phy->dlctrl_cache_tick;
+			phy->dlctrl_cache_hits++;
+			return;
+		}
+		if (e->last_used < entry->last_used)
+			entry = e;
+	}
+	phy->dlctrl_cache_misses++;
+	memcpy(entry->key, phy->dlctrl_buf, buf_size);
 
 	// add CRC
 	phy->dlctrl_buf[buf_size].byte = crc_generate_key(LIQUID_CRC_8, (uint8_t*)phy->dlctrl_buf,buf_size);
@@ -244,20 +337,23 @@ void phy_map_dlctrl(PhyBS phy, uint subframe)
 
 	// encode data
 	uint enc_len = fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],buf_size+1);
-	uint8_t* buf_enc = malloc(enc_len);
+	uint8_t* buf_enc = scratch->enc;
 	fec_encode(common->mcs_fec[mcs], buf_size+1,(uint8_t*)phy->dlctrl_buf, buf_enc);
 
 	// repack bytes and modulate them
 	uint bytes_written;
 	int num_repacked = enc_len*8/modem_get_bps(common->mcs_modem[mcs]);
-	uint8_t* repacked_b = malloc(num_repacked);
+	uint8_t* repacked_b = scratch->repacked;
 	liquid_repack_bytes((uint8_t*)buf_enc,8,enc_len,repacked_b,modem_get_bps(common->mcs_modem[mcs]),num_repacked,&bytes_written);
 
 	uint total_samps = 0;
-	phy_mod(common, subframe, 0, nfft-1, 0, DLCTRL_LEN-1, mcs, repacked_b, num_repacked, &total_samps);
+	phy_mod(common, subframe, map, mcs, repacked_b, num_repacked, &total_samps);
 
-	free(buf_enc);
-	free(repacked_b);
+	// store the modulated slot
+	for (int k=0; k<total_samps; k++)
+		entry->re[k] = slot_f[map->idx[k]];
+	entry->num_re = total_samps;
+	entry->last_used = phy->dlctrl_cache_tick;
 }
 
 //Set the assignments of Downlink data slots
@@ -303,6 +399,236 @@ void phy_assign_dlctrl_uc(PhyBS phy, uint subframe, uint8_t* slot_assignment)
 
 }
 
+// Set the HARQ retransmission flags. The high nibble holds the UL data slots, the low nibble
+// the DL data slots. Only flagged slots are combined with stored transmissions by the receiver
+void phy_assign_dlctrl_harq(PhyBS phy, uint subframe, uint8_t ul_retx, uint8_t dl_retx)
+{
+	phy->ulslot_retx[subframe] = ul_retx;
+	phy->dlctrl_buf[DLCTRL_HARQ_IDX].h4 = ul_retx;
+	phy->dlctrl_buf[DLCTRL_HARQ_IDX].l4 = dl_retx;
+}
+
+// The NACK is dropped if it could not be sent within HARQ_NACK_MAX_DELAY subframes,
+// since the UE reuses the subframe and slot number every frame
+int phy_bs_get_ul_harq_nack(PhyBS phy, uint userid, uint* subframe, uint* slot_nr)
+{
+	if (!phy_harq_poll_nack(phy->ul_user[userid].harq, phy->rx_subframe_cnt, HARQ_NACK_MAX_DELAY,
+							subframe, slot_nr))
+		return 0;
+	phy->ul_harq_nacks++;
+	LOG_SFN_PHY(DEBUG,"[PHY BS] NACK UL slot %d of subframe %d, user %d\n",*slot_nr,*subframe,userid);
+	return 1;
+}
+
+// The UE needs a few subframes to receive the NACK, until then it can not retransmit the slot
+uint phy_bs_ul_harq_pending(PhyBS phy, uint userid)
+{
+	return phy_harq_num_pending(phy->ul_user[userid].harq, phy->rx_subframe_cnt, HARQ_RETX_DELAY);
+}
+
+int phy_bs_request_ul_retx(PhyBS phy, uint userid)
+{
+	return phy_harq_request_retx(phy->ul_user[userid].harq, phy->rx_subframe_cnt, HARQ_RETX_DELAY);
+}
+
+uint phy_bs_get_ul_harq_combined(PhyBS phy)
+{
+	uint combined = 0;
+	for (int userid=0; userid<MAX_USER; userid++)
+		combined += phy_harq_get_combined(phy->ul_user[userid].harq);
+	return combined;
+}
+
+// Decode a received slot. Called by a slot worker thread or by the RX thread
+static void phy_bs_decode_job(void* userd, phy_slot_job job, phy_rx_ctx ctx)
+{
+	PhyBS phy = (PhyBS)userd;
+	PhyCommon common = phy->common;
+	uint mcs = job->mcs;
+	uint32_t blocksize;
+	uint written_samps = 0;
+
+	switch (job->type) {
+	case SLOT_JOB_DATA:
+		blocksize = get_tbs_size(common, mcs);
+		uint buf_len = 8*fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],blocksize/8);
+
+		// demodulate signal
+		phy_demod_soft_buf(common, phy_get_re_map(common, RE_MAP_ULSLOT, job->slot_nr), job->symbols, mcs,
+						   ctx->demod_buf, buf_len, &written_samps);
+
+		//deinterleaving
+		interleaver_decode_soft(ctx->mcs_interlvr[mcs],ctx->demod_buf,ctx->deinterleaved_buf);
+
+		// decoding. Slots which fail the CRC are stored and combined with their retransmission
+		job->chan = lchan_create(blocksize/8,CRC16);
+		job->harq = phy_harq_decode(phy->ul_user[job->userid].harq, ctx->mcs_dec[mcs], mcs, ctx->deinterleaved_buf,
+									buf_len, job->chan, job->retx, job->subframe, job->slot_nr, job->subframe_cnt);
+		break;
+	case SLOT_JOB_CTRL:
+	case SLOT_JOB_RACH:
+		// CTRL slots and association requests use MCS 0
+		blocksize = get_ulctrl_slot_size(common);
+		re_map map = job->type==SLOT_JOB_CTRL ? phy_get_re_map(common, RE_MAP_ULCTRL, job->slot_nr) :
+												phy_get_re_map(common, RE_MAP_RACH, 0);
+		phy_demod_soft_buf(common, map, job->symbols, 0, ctx->demod_buf,
+						   8*fec_get_enc_msg_length(common->mcs_fec_scheme[0],blocksize/8), &written_samps);
+
+		job->chan = lchan_create(blocksize/8,CRC8);
+		phy_fec_decode_soft(ctx->fec_ctrl, blocksize/8, ctx->demod_buf, job->chan->data);
+		break;
+	}
+}
+
+// returns the receiver of a user. NULL if no user is attached to the userid
+static ofdmframesync phy_bs_get_receiver(PhyBS phy, uint userid)
+{
+	return phy->ul_user[userid].fs;
+}
+
+// Attach a new user. fs is the receiver which received the association request
+static void phy_bs_attach_user(PhyBS phy, uint userid, ofdmframesync fs)
+{
+	phy_bs_ul_user_s* user = &phy->ul_user[userid];
+	// change callback from RACH cb to normal cb
+	ofdmframesync_set_cb(fs,_bs_rx_symbol_cb,phy);
+
+	pthread_mutex_lock(&phy->ul_user_mutex);
+	ofdmframesync prev = user->fs;
+	user->fs = fs;
+	// start with the CFO of the association request
+	user->cfo = ofdmframesync_get_cfo(fs);
+	user->last_update = phy->rx_subframe_cnt;
+	pthread_mutex_unlock(&phy->ul_user_mutex);
+	phy_harq_clear(user->harq);
+
+	if (prev) {
+		LOG(WARN,"[PHY BS] user %d was attached twice\n",userid);
+		phy_bs_release_receiver(phy, prev);
+	}
+}
+
+void phy_bs_remove_user(PhyBS phy, uint userid)
+{
+	pthread_mutex_lock(&phy->ul_user_mutex);
+	ofdmframesync fs = phy->ul_user[userid].fs;
+	phy->ul_user[userid].fs = NULL;
+	pthread_mutex_unlock(&phy->ul_user_mutex);
+	phy_harq_clear(phy->ul_user[userid].harq);
+
+	if (fs)
+		phy_bs_release_receiver(phy, fs);
+}
+
+// Start to receive a slot of the given user: the receiver starts with the CFO estimate of the user
+static void phy_bs_ul_est_begin(PhyBS phy, uint userid, ofdmframesync fs)
+{
+	phy_bs_ul_user_s* user = &phy->ul_user[userid];
+	ofdmframesync_reset_soft(fs);
+	pthread_mutex_lock(&phy->ul_user_mutex);
+	if (phy->rx_subframe_cnt - user->last_update <= UL_EST_MAX_AGE)
+		ofdmframesync_set_cfo(fs, user->cfo);
+	pthread_mutex_unlock(&phy->ul_user_mutex);
+
+	user->meas_cfo = 0;
+	user->meas_cnt = 0;
+}
+
+// Take the CFO measured on a pilot symbol of the current slot of the user
+static void phy_bs_ul_est_measure(PhyBS phy, uint userid, ofdmframesync fs)
+{
+	phy_bs_ul_user_s* user = &phy->ul_user[userid];
+	user->meas_cfo += ofdmframesync_get_cfo(fs);
+	user->meas_cnt++;
+}
+
+// Attach the CFO measured in the current slot of the user to a job
+static void phy_bs_ul_est_to_job(PhyBS phy, uint userid, phy_slot_job job)
+{
+	phy_bs_ul_user_s* user = &phy->ul_user[userid];
+	job->has_cfo = user->meas_cnt > 0;
+	job->cfo = user->meas_cnt > 0 ? user->meas_cfo/user->meas_cnt : 0;
+}
+
+// Update the estimate of a user with the measurement of a slot that passed the CRC
+static void phy_bs_ul_est_update(PhyBS phy, phy_slot_job job)
+{
+	if (!job->has_cfo)
+		return;
+	phy_bs_ul_user_s* user = &phy->ul_user[job->userid];
+	pthread_mutex_lock(&phy->ul_user_mutex);
+	if (phy->rx_subframe_cnt - user->last_update > UL_EST_MAX_AGE)
+		user->cfo = job->cfo;
+	else
+		user->cfo = (1-UL_EST_FILT_PARAM)*user->cfo + UL_EST_FILT_PARAM*job->cfo;
+	user->last_update = phy->rx_subframe_cnt;
+	phy->ul_est_updates++;
+	pthread_mutex_unlock(&phy->ul_user_mutex);
+}
+
+// Pass a decoded slot to the MAC layer. Calls are serialized
+static void phy_bs_deliver_job(void* userd, phy_slot_job job)
+{
+	PhyBS phy = (PhyBS)userd;
+	LogicalChannel chan = job->chan;
+
+	switch (job->type) {
+	case SLOT_JOB_DATA:
+#ifdef PHY_TEST_BER
+		for (int i=0; i<chan->payload_len;i++)
+			phy_ul_biterr += liquid_count_ones(phy_ul[job->subframe%2][job->slot_nr][i]^chan->data[i]);
+		phy_ul_tot_bits += chan->payload_len*8;
+#endif
+		// pass to upper layer
+		if(!mac_bs_rx_channel(phy->mac,chan, job->userid)) {
+			// log when crc check failed
+			ofdmframesync fs = phy_bs_get_receiver(phy,job->userid);
+			if (fs!=NULL)
+				LOG_SFN_PHY(TRACE,"cfo was: %.3fHz\n",ofdmframesync_get_cfo(fs)*samplerate/6.28);
+		} else {
+			phy_bs_ul_est_update(phy, job);
+		}
+		break;
+	case SLOT_JOB_CTRL:
+		if (mac_bs_rx_channel(phy->mac,chan, job->userid))
+			phy_bs_ul_est_update(phy, job);
+		break;
+	case SLOT_JOB_RACH: ;
+		// the job owns the sync object which received the association request
+		ofdmframesync fs = (ofdmframesync)job->obj;
+		// TODO Fix definition of Associate Request message
+		if (lchan_verify_crc(chan)) {
+			uint8_t rach_userid = chan->data[0];
+			uint8_t rach_try_cnt = chan->data[1];
+			int userid = mac_bs_add_new_ue(phy->mac,rach_userid, rach_try_cnt, job->timing);
+			if (userid >= 0)
+				phy_bs_attach_user(phy, userid, fs);
+			else
+				phy_bs_release_receiver(phy, fs);
+		} else {
+			LOG(WARN,"[PHY BS] assoc request could not be decoded. invalid CRC!\n");
+			phy_bs_release_receiver(phy, fs);
+		}
+		lchan_destroy(chan);
+		break;
+	}
+}
+
+// Decode a slot in the worker threads if they are running, otherwise in the calling thread
+static void phy_bs_dispatch_job(PhyBS phy, phy_slot_job job)
+{
+#ifdef USE_RX_SLOT_THREAD
+	if (phy->slot_queue) {
+		// a dropped association request still owns its receiver
+		if (!phy_slot_queue_push(phy->slot_queue, job) && job->type == SLOT_JOB_RACH)
+			phy_bs_release_receiver(phy, (ofdmframesync)job->obj);
+		return;
+	}
+#endif
+	phy_bs_decode_job(phy, job, phy->common->rx_ctx);
+	phy_bs_deliver_job(phy, job);
+}
+
 // Decode a PHY ul slot and call the MAC callback function
 void phy_bs_proc_slot(PhyBS phy, uint slotnr)
 {
@@ -320,49 +646,19 @@ void phy_bs_proc_slot(PhyBS phy, uint slotnr)
 		return;
 	}
 
-	uint mcs = phy->mac->UE[userid]->ul_mcs; // TODO create method to fetch this?
-	uint32_t blocksize = get_tbs_size(common, mcs);
-
-	uint buf_len = 8*fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],blocksize/8);
-	uint8_t* demod_buf = malloc(buf_len);
-
-	// demodulate signal
-	uint written_samps = 0;
-	uint first_symb = (SLOT_LEN+1)*slotnr;
-	uint last_symb = (SLOT_LEN+1)*(slotnr+1)-2; //TODO use more constants and explain how to calc this
-	// slot 3 and 4 are shifted back since the ULCTRL lies between slot 2 and 3
-	if(slotnr>=2) {
-		first_symb += 4;
-		last_symb +=4;
-	}
-	phy_demod_soft(common, 0, nfft-1, first_symb, last_symb, mcs,
-				   demod_buf, buf_len, &written_samps);
-
-	//deinterleaving
-	uint8_t* deinterleaved_b = malloc(buf_len);
-	interleaver_decode_soft(common->mcs_interlvr[mcs],demod_buf,deinterleaved_b);
-
-	// decoding
-	LogicalChannel chan = lchan_create(blocksize/8,CRC16);
-	fec_decode_soft(common->mcs_fec[mcs], blocksize/8, deinterleaved_b, chan->data);
-
-#ifdef PHY_TEST_BER
-	uint32_t num_biterr = 0;
-	for (int i=0; i<chan->payload_len;i++)
-		num_biterr += liquid_count_ones(phy_ul[sfn][slotnr][i]^chan->data[i]);
-	phy_ul_tot_bits += chan->payload_len*8;
-	phy_ul_biterr += num_biterr;
-#endif
-
-	// pass to upper layer
-	if(!mac_bs_rx_channel(phy->mac,chan, userid)) {
-		// log when crc check failed
-		ofdmframesync fs = mac_bs_get_receiver(phy->mac,userid);
-		if (fs!=NULL)
-			LOG_SFN_PHY(TRACE,"cfo was: %.3fHz\n",ofdmframesync_get_cfo(fs)*samplerate/6.28);
-	}
-	free(deinterleaved_b);
-	free(demod_buf);
+	re_map map = phy_get_re_map(common, RE_MAP_ULSLOT, slotnr);
+	phy_slot_job_s job = {0};
+	job.type = SLOT_JOB_DATA;
+	job.subframe = common->rx_subframe;
+	job.subframe_cnt = phy->rx_subframe_cnt;
+	job.slot_nr = slotnr;
+	job.userid = userid;
+	job.mcs = phy->mac->UE[userid]->ul_mcs; // TODO create method to fetch this?
+	job.retx = (phy->ulslot_retx[sfn] >> slotnr) & 1;
+	job.symbols = common->rxdata_f[map->first_symb];
+	job.num_symb = map->num_symb;
+	phy_bs_ul_est_to_job(phy, userid, &job);
+	phy_bs_dispatch_job(phy, &job);
 }
 
 // Decode a PHY ul ctrl slot and call the MAC callback function
@@ -373,77 +669,47 @@ void phy_bs_proc_ulctrl(PhyBS phy, uint slotnr)
 
 	//get user that was supposed to send in this slot
 	uint userid =  phy->ulctrl_assignments[sfn][slotnr];
-	uint mcs = 0; // CTRL slots use MCS 0
-	uint32_t blocksize = get_ulctrl_slot_size(common);
-
-	uint buf_len = 8*fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],blocksize/8);
-	uint8_t* demod_buf = malloc(buf_len);
-
-	// demodulate signal
-	uint written_samps = 0;
-	uint first_symb = (SLOT_LEN+1)*2 + 2*slotnr;
-	uint last_symb  = (SLOT_LEN+1)*2 + 2*slotnr; //TODO use more constants and explain how to calc this
-
-	phy_demod_soft(common, 0, nfft-1, first_symb, last_symb, mcs,
-				   demod_buf, buf_len, &written_samps);
-
-	// decoding
-	LogicalChannel chan = lchan_create(blocksize/8,CRC8);
-	fec_decode_soft(common->fec_ctrl, blocksize/8, demod_buf, chan->data);
+	if (userid==0) {
+		return; // Slot was not assigned. Nothing to decode
+	}
 
-	// pass to upper layer
-	mac_bs_rx_channel(phy->mac,chan, userid);
-	free(demod_buf);
+	re_map map = phy_get_re_map(common, RE_MAP_ULCTRL, slotnr);
+	phy_slot_job_s job = {0};
+	job.type = SLOT_JOB_CTRL;
+	job.subframe = common->rx_subframe;
+	job.slot_nr = slotnr;
+	job.userid = userid;
+	job.symbols = common->rxdata_f[map->first_symb];
+	job.num_symb = map->num_symb;
+	phy_bs_ul_est_to_job(phy, userid, &job);
+	phy_bs_dispatch_job(phy, &job);
 }
 
-
-int phy_bs_proc_rach(PhyBS phy, int timing_diff)
+// Decode a received association request.
+// The sync object of the RA procedure is passed on with the request:
+// it becomes the receiver of the new user or is destroyed if the request is invalid
+void phy_bs_proc_rach(PhyBS phy, int timing_diff)
 {
-	PhyCommon common = phy->common;
-
-	uint mcs = 0; // CTRL slots use MCS 0
-	uint32_t blocksize = get_ulctrl_slot_size(common);
+	ofdmframesync fs = phy->fs_rach;
+	//set to NULL to ensure RA procedure does not use sync object anymore
+	phy->fs_rach = NULL;
+	phy->rach_pending = 0;
 
     if (timing_diff<0) {
         // Client sent too early. This should not happen, ignore the request
         LOG(WARN,"[PHY BS] Some client sent Assoc request too early! ignore\n");
-        phy->fs_rach = NULL;
-        return 0;
+        phy_bs_release_receiver(phy, fs);
+        return;
     }
 
-    uint buf_len = 8*fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],blocksize/8);
-	uint8_t* demod_buf = malloc(buf_len);
-
-	// demodulate signal
-	uint written_samps = 0, symbol = 0;
-	for (int i=0; i<nfft; i++) {
-		if (common->pilot_sc[i] == OFDMFRAME_SCTYPE_DATA && written_samps<buf_len) {
-			modem_demodulate_soft(common->mcs_modem[mcs], phy->rach_buffer[i], &symbol, &demod_buf[written_samps]);
-			written_samps += modem_get_bps(common->mcs_modem[mcs]);
-		}
-	}
-
-	// decoding
-	LogicalChannel chan = lchan_create(blocksize/8,CRC8);
-	fec_decode_soft(common->fec_ctrl, blocksize/8, demod_buf, chan->data);
-
-	free(demod_buf);
-
-	// TODO Fix definition of Associate Request message
-	if (lchan_verify_crc(chan)) {
-		uint8_t rach_userid = chan->data[0];
-		uint8_t rach_try_cnt = chan->data[1];
-		// change callback from RACH cb to normal cb
-		ofdmframesync_set_cb(phy->fs_rach,_bs_rx_symbol_cb,phy);
-		mac_bs_add_new_ue(phy->mac,rach_userid, rach_try_cnt, phy->fs_rach, timing_diff);
-	} else {
-	    LOG(WARN,"[PHY BS] assoc request could not be decoded. invalid CRC!\n");
-	}
-	lchan_destroy(chan);
-
-	//set to NULL to ensure RA procedure does not use sync object anymore
-	phy->fs_rach = NULL;
-	return 1;
+	phy_slot_job_s job = {0};
+	job.type = SLOT_JOB_RACH;
+	job.subframe = phy->common->rx_subframe;
+	job.timing = timing_diff;
+	job.obj = fs;
+	job.symbols = phy->rach_buffer;
+	job.num_symb = 1;
+	phy_bs_dispatch_job(phy, &job);
 }
 
 // callback for OFDM receiver
@@ -452,29 +718,24 @@ int _bs_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd)
 {
 	PhyBS phy = (PhyBS)userd;
 	PhyCommon common = phy->common;
+	// a run of several symbols can be passed to the receiver at once
+	uint rx_symbol = phy->rx_run_symbol++;
 
-	memcpy(common->rxdata_f[common->rx_symbol],X,sizeof(float complex)*nfft);
+#ifdef USE_RX_SLOT_THREAD
+	// receive data slots directly into the buffer which is passed to the slot decoder
+	if (phy->slot_queue)
+		phy_slot_queue_rx_symbol(phy->slot_queue, common, RE_MAP_ULSLOT, rx_symbol);
+#endif
+	memcpy(common->rxdata_f[rx_symbol],X,sizeof(float complex)*nfft);
 
-	switch (common->rx_symbol) {
+	switch (rx_symbol) {
 	case (SLOT_LEN-1):
 		// finished receiving one of the UL slots
-#ifdef USE_RX_SLOT_THREAD
-            phy->rx_slot_nr = 0;
-            if (phy->rx_slot_signal)
-                pthread_cond_signal(phy->rx_slot_signal);
-            else
-#endif
-                phy_bs_proc_slot(phy,0);
+		phy_bs_proc_slot(phy,0);
 		break;
 	case (2*SLOT_LEN):
 		// finished receiving one of the UL slots
-#ifdef USE_RX_SLOT_THREAD
-            phy->rx_slot_nr = 1;
-            if (phy->rx_slot_signal)
-                pthread_cond_signal(phy->rx_slot_signal);
-            else
-#endif
-		        phy_bs_proc_slot(phy, 1);
+		phy_bs_proc_slot(phy,1);
 		break;
 	case 2*(SLOT_LEN+1):
 		// finished receiving first ULCTRL slot
@@ -486,23 +747,11 @@ int _bs_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd)
 		break;
 	case 2*(SLOT_LEN+1)+4+SLOT_LEN-1:
 		// finished receiving one of the UL slots
-#ifdef USE_RX_SLOT_THREAD
-            phy->rx_slot_nr = 2;
-            if (phy->rx_slot_signal)
-                pthread_cond_signal(phy->rx_slot_signal);
-            else
-#endif
-		        phy_bs_proc_slot(phy,2);
+		phy_bs_proc_slot(phy,2);
 		break;
 	case 3*(SLOT_LEN+1)+4+SLOT_LEN-1:
 		// finished receiving one of the UL slots
-#ifdef USE_RX_SLOT_THREAD
-            phy->rx_slot_nr = 3;
-            if (phy->rx_slot_signal)
-                pthread_cond_signal(phy->rx_slot_signal);
-            else
-#endif
-		        phy_bs_proc_slot(phy,3);
+		phy_bs_proc_slot(phy,3);
 		break;
 	default:
 		break;
@@ -529,11 +778,11 @@ void phy_bs_write_symbol(PhyBS phy, float complex* txbuf_time)
 	// check if we have to add synch sequence in this subframe
 	if (common->tx_subframe == 0 && tx_symb == SUBFRAME_LEN-1-SYNC_SYMBOLS) {
 		ofdmframegen_reset(phy->fg);
-		ofdmframegen_write_S0a(phy->fg, txbuf_time);
+		memcpy(txbuf_time, phy->sync_symbols[0], sizeof(float complex)*(nfft+cp_len));
 	} else if (common->tx_subframe == 0 && tx_symb == SUBFRAME_LEN-1-SYNC_SYMBOLS+1) {
-		ofdmframegen_write_S0b(phy->fg, txbuf_time);
+		memcpy(txbuf_time, phy->sync_symbols[1], sizeof(float complex)*(nfft+cp_len));
 	} else if (common->tx_subframe == 0 && tx_symb == SUBFRAME_LEN-1-SYNC_SYMBOLS+2) {
-        ofdmframegen_write_S1(phy->fg, txbuf_time);
+		memcpy(txbuf_time, phy->sync_symbols[2], sizeof(float complex)*(nfft+cp_len));
     } else if (common->tx_subframe == 0 && tx_symb == SUBFRAME_LEN-1-SYNC_SYMBOLS+3) {
         phy_bs_write_sync_info(phy, txbuf_time);
 	} else if (common->pilot_symbols_tx[tx_symb] == PILOT) {
@@ -554,11 +803,52 @@ void phy_bs_write_symbol(PhyBS phy, float complex* txbuf_time)
 	}
 }
 
-// Main PHY receive function
-//receive one ofdm symbol amount of samples and process them
-// NOTE: in constrast to the phyUE receive function, the amount of processed
-// 		 samples per call is fixed
-void phy_bs_rx_symbol(PhyBS phy, float complex* rxbuf_time)
+// returns 1 if symbol symb is the last symbol of an UL slot or UL ctrl slot
+static int phy_bs_slot_complete(PhyCommon common, uint symb)
+{
+	for (int i=0; i<NUM_SLOT; i++) {
+		re_map map = phy_get_re_map(common, RE_MAP_ULSLOT, i);
+		if (symb == map->first_symb+map->num_symb-1)
+			return 1;
+	}
+	for (int i=0; i<NUM_ULCTRL_SLOT; i++) {
+		re_map map = phy_get_re_map(common, RE_MAP_ULCTRL, i);
+		if (symb == map->first_symb+map->num_symb-1)
+			return 1;
+	}
+	return 0;
+}
+
+// returns the number of symbols starting at common->rx_symbol that are received in one run:
+// symbols of the same user without pilots, and only the last one may complete a slot.
+// Pilot symbols and the RA slot are received one by one
+static uint phy_bs_rx_run_len(PhyBS phy, uint max_symbols)
+{
+	PhyCommon common = phy->common;
+	uint sfn = common->rx_subframe%2;
+	uint symb = common->rx_symbol;
+	uint userid = phy->ul_symbol_alloc[sfn][symb];
+	uint ra_start = SUBFRAME_LEN-SLOT_LEN-2;
+
+	if ((common->rx_subframe == 0 && symb >= ra_start) ||
+			(userid != 0 && common->pilot_symbols_rx[symb] == PILOT))
+		return 1;
+
+	uint n = 1;
+	while (n < max_symbols && symb+n < SUBFRAME_LEN && !phy_bs_slot_complete(common, symb+n-1)) {
+		uint next = symb+n;
+		if (phy->ul_symbol_alloc[sfn][next] != userid ||
+				(userid != 0 && common->pilot_symbols_rx[next] == PILOT) ||
+				(common->rx_subframe == 0 && next >= ra_start))
+			break;
+		n++;
+	}
+	return n;
+}
+
+// Receive a run of num_symbols symbols, see phy_bs_rx_run_len()
+// rxbuf_time may be NULL if the samples are not used, see phy_bs_rx_run_used()
+static void phy_bs_rx_run(PhyBS phy, float complex* rxbuf_time, uint num_symbols)
 {
 	PhyCommon common = phy->common;
 	uint rx_sym = nfft+cp_len;
@@ -569,8 +859,11 @@ void phy_bs_rx_symbol(PhyBS phy, float complex* rxbuf_time)
 		if (phy->fs_rach!=NULL) {
 			ofdmframesync_reset(phy->fs_rach); // if we didnt find a new user in last RACH, sync object still exists. Reset it
 		} else {
-			phy->fs_rach = ofdmframesync_create(nfft,cp_len,0,phy->common->pilot_sc,_ofdm_rx_rach_cb, phy);
+			phy->fs_rach = phy_bs_acquire_receiver(phy);
+			if (phy->fs_rach == NULL)
+				LOG(WARN,"[PHY BS] no free OFDM receiver. Skip RA slot\n");
 		}
+		phy->rach_pending = 0;
 	}
 
 	if (sfn == 0 && common->rx_symbol>=SUBFRAME_LEN-SLOT_LEN-2) {
@@ -583,6 +876,8 @@ void phy_bs_rx_symbol(PhyBS phy, float complex* rxbuf_time)
 													common->rx_subframe, common->rx_symbol, phy->rach_timing, ofdmframesync_get_cfo(phy->fs_rach)*samplerate/6.28);
 				// rach can be unaligned to symbol boundaries. receive rx_sym-offset samps
 				ofdmframesync_execute(phy->fs_rach, rxbuf_time+offset,rx_sym-offset);
+				if (phy->rach_pending)
+					phy_bs_proc_rach(phy, phy->rach_timing);
 			}
 		} else if (phy->fs_rach){
 			// receive the last samps of the association request
@@ -590,34 +885,103 @@ void phy_bs_rx_symbol(PhyBS phy, float complex* rxbuf_time)
 				ofdmframesync_execute(phy->fs_rach, rxbuf_time, nfft+cp_len);
             else
 				ofdmframesync_execute(phy->fs_rach, rxbuf_time, phy->rach_timing % rx_sym);
+			if (phy->rach_pending)
+				phy_bs_proc_rach(phy, phy->rach_timing);
 		}
 	} else {
 		// not in RA slot. Do normal receive
 		uint userid = phy->ul_symbol_alloc[sfn%2][common->rx_symbol];
-		ofdmframesync fs = mac_bs_get_receiver(phy->mac,userid);
+		ofdmframesync fs = phy_bs_get_receiver(phy,userid);
 		if (fs!=NULL) {
 			// if this is the first symbol of a slot, soft reset the
-			// sync object
+			// sync object and start with the estimate of the user
 			uint prev_rx_symb = (common->rx_symbol-1) % SUBFRAME_LEN;
 			if (common->rx_symbol == 0 || phy->ul_symbol_alloc[sfn%2][prev_rx_symb]==0) {
-				ofdmframesync_reset_soft(fs);
+				phy_bs_ul_est_begin(phy, userid, fs);
 			}
 
+			phy->rx_run_symbol = common->rx_symbol;
 			if (common->pilot_symbols_rx[common->rx_symbol] == PILOT) {
 				ofdmframesync_reset_msequence(fs);
 				ofdmframesync_execute(fs,rxbuf_time,rx_sym);
 				LOG_SFN_PHY(TRACE,"[PHY BS] cfo was: %.3fHz\n",ofdmframesync_get_cfo(fs)*samplerate/6.28);
-				//ofdmframesync_set_cfo(fs,0); // TODO cfo estimation. Currently not working since we often receive if no data is sent. -> wrong pilot -> wrong cfo
+				// the measurement is only used if the slot passes the CRC, i.e. the user did send
+				phy_bs_ul_est_measure(phy, userid, fs);
 			} else {
-				ofdmframesync_execute_nopilot(fs,rxbuf_time,rx_sym);
+				ofdmframesync_execute_nopilot(fs,rxbuf_time,rx_sym*num_symbols);
 			}
 		}
 	}
 
-	// Update the tx counters
-	common->rx_symbol++;
+	// Update the rx counters
+	common->rx_symbol += num_symbols;
 	if (common->rx_symbol == SUBFRAME_LEN) {
 		common->rx_subframe = (common->rx_subframe+1) % FRAME_LEN;
 		common->rx_symbol = 0;
+		phy->rx_subframe_cnt++;
+	}
+}
+
+// returns 1 if the samples of the run starting at common->rx_symbol are passed to an OFDM receiver
+static int phy_bs_rx_run_used(PhyBS phy)
+{
+	PhyCommon common = phy->common;
+	if (common->rx_subframe == 0 && common->rx_symbol >= SUBFRAME_LEN-SLOT_LEN-2)
+		return 1;
+	uint userid = phy->ul_symbol_alloc[common->rx_subframe%2][common->rx_symbol];
+	return phy_bs_get_receiver(phy,userid) != NULL;
+}
+
+// Receive symbols given as float complex (cf) or as interleaved int16 I/Q (cs), which is converted
+// with the given scale. Only the runs that are passed to an OFDM receiver are converted
+static void phy_bs_rx(PhyBS phy, float complex* cf, const int16_t* cs, float scale, uint num_symbols)
+{
+	uint symb_len = nfft+cp_len;
+	while (num_symbols > 0) {
+		uint n = phy_bs_rx_run_len(phy, num_symbols < BS_RX_MAX_RUN ? num_symbols : BS_RX_MAX_RUN);
+		float complex* rx = cf;
+		if (cs != NULL) {
+			rx = NULL;
+			if (phy_bs_rx_run_used(phy)) {
+				pluto_iq_to_float(cs, phy->rx_conv_buf, n*symb_len, scale);
+				rx = phy->rx_conv_buf;
+			}
+			cs += 2*n*symb_len;
+		} else {
+			cf += n*symb_len;
+		}
+		phy_bs_rx_run(phy, rx, n);
+		num_symbols -= n;
 	}
 }
+
+// Main PHY receive function
+// receive a block of num_symbols ofdm symbols, e.g. a whole platform buffer, and process them.
+// Consecutive symbols of the same user are passed to the OFDM receiver in one call
+// NOTE: in constrast to the phyUE receive function, the buffer has to hold whole symbols
+void phy_bs_rx_block(PhyBS phy, float complex* rxbuf_time, uint num_symbols)
+{
+	phy_bs_rx(phy, rxbuf_time, NULL, 1.0f, num_symbols);
+}
+
+// Receive a block of num_symbols ofdm symbols given as interleaved int16 I/Q samples
+void phy_bs_rx_block_cs16(PhyBS phy, const int16_t* iq, uint num_symbols, float scale)
+{
+	phy_bs_rx(phy, NULL, iq, scale, num_symbols);
+}
+
+// Receive the samples of a platform rx view. The view has to hold whole symbols
+void phy_bs_rx_view(PhyBS phy, const platform_rx_view_s* view)
+{
+	uint num_symbols = view->num_samples/(nfft+cp_len);
+	if (view->fmt == PLATFORM_FMT_CS16)
+		phy_bs_rx_block_cs16(phy, view->samples, num_symbols, view->scale);
+	else
+		phy_bs_rx_block(phy, (float complex*)view->samples, num_symbols);
+}
+
+// receive one ofdm symbol amount of samples and process them
+void phy_bs_rx_symbol(PhyBS phy, float complex* rxbuf_time)
+{
+	phy_bs_rx_block(phy, rxbuf_time, 1);
+}
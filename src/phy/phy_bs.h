@@ -20,6 +20,7 @@
 #define PHY_BS_H_
 
 #include "phy_common.h"
+#include "phy_slot_queue.h"
 #include "../mac/mac_bs.h"
 #include "../platform/platform.h"
 #include <pthread.h>
@@ -27,16 +28,56 @@
 // forward declaration of mac struct
 struct MacBS_s;
 
+#define DLCTRL_CACHE_SIZE 8		// number of cached DL ctrl slots
+#define BS_RX_MAX_RUN SLOT_LEN	// max number of symbols passed to an OFDM receiver at once
+#define BS_RX_POOL_SIZE (MAX_USER+1)	// number of OFDM receivers: one per user and one for the RA slot
+#define UL_EST_FILT_PARAM 0.3f			// weight of a new CFO measurement in the per user estimate
+#define UL_EST_MAX_AGE (4*FRAME_LEN)	// number of subframes after which a per user estimate is discarded
+
+// modulated DL ctrl slot for one slot assignment
+typedef struct {
+	uint8_t key[DLCTRL_PAYLOAD_LEN];	// slot assignments, i.e. the unscrambled DL ctrl data without CRC
+	float complex* re;					// modulated resource elements of the DL ctrl slot
+	uint num_re;
+	uint64_t last_used;					// 0 if the entry is unused
+} dlctrl_cache_entry_s;
+
+// Compact UL receive state of a user that is kept across slots and subframes.
+// The OFDM receiver is taken from the receiver pool when the user is attached and returned
+// when the user is removed.
+// The CFO is measured on the pilots of every slot of the user. Only slots that pass the CRC
+// update the estimate, since pilots of slots in which the user did not send give random values.
+// Every slot starts with the current estimate instead of the state the last slot left behind
+typedef struct {
+	ofdmframesync fs;	// receiver of the user. NULL if no user is attached to the userid
+	float cfo;			// filtered CFO estimate
+	uint last_update;	// rx_subframe_cnt of the last update
+	// measurement of the slot that is currently received. Only used by the RX thread
+	float meas_cfo;
+	uint meas_cnt;
+	// UL HARQ process. Failed data slots of the user are NACKed with a MAC control message
+	phy_harq harq;
+} phy_bs_ul_user_s;
+
 struct PhyBS_s {
 	PhyCommon common;			// pointer to common phy objects
 	ofdmframegen fg;			// OFDM frame generator object
-	ofdmframesync fs_rach; 		// OFDM receiver for rach slot
+	ofdmframesync fs_rach; 		// OFDM receiver for rach slot. Taken from the receiver pool
+
+	// Pool of OFDM receivers, created at init. The receiver of the RA slot and the receivers of all
+	// users are taken from the pool, so attaching and removing users never allocates on the RX path
+	ofdmframesync rx_pool[BS_RX_POOL_SIZE];
+	ofdmframesync rx_pool_free[BS_RX_POOL_SIZE];	// stack of unused receivers
+	uint rx_pool_num_free;
+	pthread_mutex_t rx_pool_mutex;
 
 	// Variables to store the slot assignments
 	// 1. array index: 0 for even subframes, 1 for uneven subframe
 	// 2. array index: slot index
 	uint8_t** ulslot_assignments;
 	uint8_t** ulctrl_assignments;
+	// bit i is set if UL data slot i carries a requested HARQ retransmission. Index: even/uneven subframe
+	uint8_t ulslot_retx[2];
 
 	// store uplink resource allocation on OFDM symbol basis
 	// BS has to pick the correct ofdmframesync object depending on the user
@@ -46,9 +87,25 @@ struct PhyBS_s {
 
 	dlctrl_alloc_t* dlctrl_buf;	// holds DL ctrl slot data
 
+	// LRU cache of modulated DL ctrl slots. Most subframes repeat a few slot assignments
+	dlctrl_cache_entry_s dlctrl_cache[DLCTRL_CACHE_SIZE];
+	uint64_t dlctrl_cache_tick;
+	uint dlctrl_cache_hits;
+	uint dlctrl_cache_misses;
+
 	// buffer stores data which is sent by users during RACH procedure
 	float complex* rach_buffer;
 
+	// preallocated channel object for the sync info symbol
+	LogicalChannel sync_info_chan;
+
+	// cached symbols which only change with their inputs
+	float complex* sync_symbols[3];	// S0a, S0b, S1 in time domain
+	float complex* sync_info_f;		// sync info subcarriers. Valid for the stored gain values
+	int8_t sync_info_rxgain;
+	int8_t sync_info_txgain;
+	int sync_info_valid;
+
 	// stores timing offset of a received RA message
 	int rach_timing;
 	// we have to store the remaining samps that have to be received after sync with a new user is achieved
@@ -56,10 +113,22 @@ struct PhyBS_s {
 
 	struct MacBS_s* mac;
 
-	// Pthread condition used to trigger slot processing
-	pthread_cond_t* rx_slot_signal;
-	// indicates received slot nr to the slot processing thread
-	int rx_slot_nr;
+	// worker threads which decode the received slots. NULL if slots are decoded in the RX thread
+	phy_slot_queue slot_queue;
+	// set by the RACH receiver when the association request symbol was received
+	int rach_pending;
+	// index of the next symbol passed to the rx symbol callback. Set when a run of symbols is received
+	uint rx_run_symbol;
+	// received int16 samples converted to float
+	float complex* rx_conv_buf;
+
+	// UL receive state per userid. Users are attached and estimates are updated when
+	// slots are delivered, users are removed by the MAC. Read by the RX thread
+	phy_bs_ul_user_s ul_user[MAX_USER];
+	pthread_mutex_t ul_user_mutex;
+	uint rx_subframe_cnt;		// number of received subframes
+	uint ul_est_updates;		// number of estimate updates
+	uint ul_harq_nacks;			// number of UL data slots that were NACKed
 
 	// current rx and txgain values. Broadcasted in the sync slot
 	int8_t rxgain;
@@ -72,7 +141,25 @@ typedef struct PhyBS_s* PhyBS;
 PhyBS phy_bs_init();
 void phy_bs_destroy(PhyBS phy);
 void phy_bs_set_mac_interface(PhyBS phy, struct MacBS_s* mac);
-void phy_bs_set_rx_slot_th_signal(PhyBS phy, pthread_cond_t* cond);
+int phy_bs_start_slot_workers(PhyBS phy, uint num_workers);
+
+// Take a receiver from the pool. It is reset and uses the RACH callback.
+// Returns NULL if all receivers are in use
+ofdmframesync phy_bs_acquire_receiver(PhyBS phy);
+// Return a receiver to the pool
+void phy_bs_release_receiver(PhyBS phy, ofdmframesync fs);
+// Remove the UL receive state of a user and return its receiver to the pool. Called by the MAC
+void phy_bs_remove_user(PhyBS phy, uint userid);
+// Returns 1 and the position of a failed UL data slot of the user if its NACK has to be sent
+int phy_bs_get_ul_harq_nack(PhyBS phy, uint userid, uint* subframe, uint* slot_nr);
+// Returns the number of NACKed UL data slots of the user whose retransmission can be requested.
+// The user should get a UL data slot for each
+uint phy_bs_ul_harq_pending(PhyBS phy, uint userid);
+// Request the retransmission of the oldest pending UL data slot of the user.
+// Returns 1 if the UL data slot assigned to the user has to be marked as retransmission
+int phy_bs_request_ul_retx(PhyBS phy, uint userid);
+// Returns the number of UL data slots which were decoded after combining them with a retransmission
+uint phy_bs_get_ul_harq_combined(PhyBS phy);
 
 /************* TX mapper functions *************************/
 int phy_map_dlslot(PhyBS phy, LogicalChannel chan, uint subframe, uint8_t slot_nr, uint userid, uint mcs);
@@ -80,9 +167,15 @@ void phy_map_dlctrl(PhyBS phy, uint subframe);
 void phy_assign_dlctrl_dd(PhyBS phy, uint8_t* slot_assignment);
 void phy_assign_dlctrl_ud(PhyBS phy, uint subframe, uint8_t* slot_assignment);
 void phy_assign_dlctrl_uc(PhyBS phy, uint subframe, uint8_t* slot_assignment);
+// Set the retransmission flags of the DL ctrl slot. Bit i of ul_retx/dl_retx is set if
+// UL/DL data slot i carries a HARQ retransmission
+void phy_assign_dlctrl_harq(PhyBS phy, uint subframe, uint8_t ul_retx, uint8_t dl_retx);
 
 /************** Main RX/TX functions ***********************/
 void phy_bs_rx_symbol(PhyBS phy, float complex* rxbuf_time);
+void phy_bs_rx_block(PhyBS phy, float complex* rxbuf_time, uint num_symbols);
+void phy_bs_rx_block_cs16(PhyBS phy, const int16_t* iq, uint num_symbols, float scale);
+void phy_bs_rx_view(PhyBS phy, const platform_rx_view_s* view);
 void phy_bs_write_symbol(PhyBS phy, float complex* txbuf_time);
 void phy_bs_proc_slot(PhyBS phy, uint slotnr);
 
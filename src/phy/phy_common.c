@@ -19,6 +19,11 @@
 #include "phy_common.h"
 #include "phy_config.h"
 
+static uint phy_num_re_maps(re_map_type type);
+static void phy_tx_scratch_init(PhyCommon phy, phy_tx_scratch_s* scratch);
+static void phy_tx_scratch_free(phy_tx_scratch_s* scratch);
+static uint16_t* phy_gen_interleaver_perm(interleaver q, uint enc_len);
+
 
 // Init the PHY instance
 PhyCommon phy_common_init()
@@ -29,13 +34,17 @@ PhyCommon phy_common_init()
 	phy->txdata_f = malloc(sizeof(float complex**)*2);
 
     // alloc buffer for one subframe of symbols in frequency domain
+    // symbols are stored contiguously, so that the resource element maps can address a whole slot
 	phy->txdata_f[0] = malloc(sizeof(float complex*)*SUBFRAME_LEN);
 	phy->txdata_f[1] = malloc(sizeof(float complex*)*SUBFRAME_LEN);
 	phy->rxdata_f    = malloc(sizeof(float complex*)*SUBFRAME_LEN);
+	phy->txdata_f[0][0] = calloc(sizeof(float complex)*nfft*SUBFRAME_LEN,1);
+	phy->txdata_f[1][0] = calloc(sizeof(float complex)*nfft*SUBFRAME_LEN,1);
+	phy->rxdata_f_mem   = calloc(sizeof(float complex)*nfft*SUBFRAME_LEN,1);
     for (int i=0; i<SUBFRAME_LEN; i++) {
-    	phy->txdata_f[0][i] = calloc(sizeof(float complex)*(nfft),1);
-    	phy->txdata_f[1][i] = calloc(sizeof(float complex)*(nfft),1);
-    	phy->rxdata_f[i]    = calloc(sizeof(float complex)*(nfft),1);
+    	phy->txdata_f[0][i] = phy->txdata_f[0][0] + i*nfft;
+    	phy->txdata_f[1][i] = phy->txdata_f[1][0] + i*nfft;
+    	phy->rxdata_f[i]    = phy->rxdata_f_mem + i*nfft;
     }
 
     // alloc buffer for subcarrier definitions
@@ -51,9 +60,16 @@ PhyCommon phy_common_init()
     phy->mcs_modem[4] = modem_create(LIQUID_MODEM_QAM64);
     phy->mcs_modem[5] = modem_create(LIQUID_MODEM_QAM64);
     phy->mcs_modem[6] = modem_create(LIQUID_MODEM_QAM256);
+    for (int mcs=0; mcs<NUM_MCS_SCHEMES; mcs++) {
+        phy->mcs_demapper[mcs] = phy_demapper_create(phy->mcs_modem[mcs]);
+        // store the constellation to map symbols without calling the modem
+        uint num_points = 1<<modem_get_bps(phy->mcs_modem[mcs]);
+        phy->mcs_constellation[mcs] = malloc(sizeof(float complex)*num_points);
+        for (int s=0; s<num_points; s++)
+            modem_modulate(phy->mcs_modem[mcs], s, &phy->mcs_constellation[mcs][s]);
+    }
 
     // init FEC modules
-    phy->fec_ctrl = fec_create(LIQUID_FEC_CONV_V27, NULL);
     phy->mcs_fec[0] = fec_create(LIQUID_FEC_CONV_V27, NULL);
     phy->mcs_fec[1] = fec_create(LIQUID_FEC_CONV_V27P34, NULL);
     phy->mcs_fec[2] = fec_create(LIQUID_FEC_CONV_V27, NULL);
@@ -82,19 +98,26 @@ PhyCommon phy_common_init()
     	uint payload_size = get_tbs_size(phy,mcs)/8;
     	uint enc_size = fec_get_enc_msg_length(phy->mcs_fec_scheme[mcs],payload_size);
         phy->mcs_interlvr[mcs] = interleaver_create(enc_size);
+        phy->mcs_interlvr_perm[mcs] = phy_gen_interleaver_perm(phy->mcs_interlvr[mcs], enc_size);
     }
 
+    // init the TX encoding buffers
+    phy_tx_scratch_init(phy, &phy->tx_scratch);
+    phy_tx_scratch_init(phy, &phy->tx_scratch_symb);
+
+    // init decoders of the RX thread
+    phy->rx_ctx = phy_rx_ctx_create(phy);
+    LOG(INFO,"[PHY] using %s viterbi decoder\n", phy_fec_impl_str(phy_fec_get_impl(phy->rx_ctx->fec_ctrl)));
+
     return phy;
 }
 
 void phy_common_destroy(PhyCommon phy)
 {
     // free buffer for symbols in frequency domain
-    for (int i=0; i<SUBFRAME_LEN; i++) {
-    	free(phy->txdata_f[0][i]);
-    	free(phy->txdata_f[1][i]);
-    	free(phy->rxdata_f[i]);
-    }
+	free(phy->txdata_f[0][0]);
+	free(phy->txdata_f[1][0]);
+	free(phy->rxdata_f_mem);
 	free(phy->txdata_f[0]);
 	free(phy->txdata_f[1]);
 
@@ -106,12 +129,27 @@ void phy_common_destroy(PhyCommon phy)
     free(phy->pilot_symbols_rx);
     free(phy->pilot_symbols_tx);
 
+    // free resource element maps
+    for (int type=0; type<NUM_RE_MAP_TYPES; type++) {
+        if (phy->re_maps[type] == NULL)
+            continue;
+        for (int i=0; i<phy_num_re_maps(type); i++)
+            free(phy->re_maps[type][i].idx);
+        free(phy->re_maps[type]);
+    }
+
     // delete modulator, fec and interleaver objects
     for (int i=0; i<NUM_MCS_SCHEMES; i++) {
         modem_destroy(phy->mcs_modem[i]);
+        demapper_destroy(phy->mcs_demapper[i]);
+        free(phy->mcs_constellation[i]);
         fec_destroy(phy->mcs_fec[i]);
         interleaver_destroy(phy->mcs_interlvr[i]);
+        free(phy->mcs_interlvr_perm[i]);
     }
+    phy_rx_ctx_destroy(phy->rx_ctx);
+    phy_tx_scratch_free(&phy->tx_scratch);
+    phy_tx_scratch_free(&phy->tx_scratch_symb);
     free(phy);
 }
 
@@ -134,61 +172,362 @@ int get_ulctrl_slot_size(PhyCommon phy)
 }
 
 
+// Allocate the TX encoding buffers. The size is the largest encoded message of
+// all data slots, the DL ctrl slot and the UL ctrl slot, repacked with the lowest modulation order
+static void phy_tx_scratch_init(PhyCommon phy, phy_tx_scratch_s* scratch)
+{
+	uint dlctrl_size = DLCTRL_PAYLOAD_LEN+1;	// including the CRC8
+	uint max_enc = fec_get_enc_msg_length(phy->mcs_fec_scheme[0], dlctrl_size);
+	uint ulctrl_enc = fec_get_enc_msg_length(phy->mcs_fec_scheme[0], get_ulctrl_slot_size(phy)/8);
+	max_enc = ulctrl_enc > max_enc ? ulctrl_enc : max_enc;
+	uint min_bps = 8;
+	for (int mcs=0; mcs<NUM_MCS_SCHEMES; mcs++) {
+		uint enc_len = fec_get_enc_msg_length(phy->mcs_fec_scheme[mcs], get_tbs_size(phy,mcs)/8);
+		max_enc = enc_len > max_enc ? enc_len : max_enc;
+		min_bps = modem_get_bps(phy->mcs_modem[mcs]) < min_bps ? modem_get_bps(phy->mcs_modem[mcs]) : min_bps;
+	}
+	scratch->len = (max_enc*8+min_bps-1)/min_bps;
+	scratch->enc = calloc(scratch->len,1);
+	scratch->interleaved = calloc(scratch->len,1);
+	scratch->repacked = calloc(scratch->len,1);
+}
+
+static void phy_tx_scratch_free(phy_tx_scratch_s* scratch)
+{
+	free(scratch->enc);
+	free(scratch->interleaved);
+	free(scratch->repacked);
+}
+
+// Create the decoder objects for one slot decoding thread
+// The decoders are selected depending on build options and CPU features
+phy_rx_ctx phy_rx_ctx_create(PhyCommon common)
+{
+	phy_rx_ctx ctx = calloc(sizeof(phy_rx_ctx_s),1);
+
+	uint ctrl_size = DLCTRL_PAYLOAD_LEN+1;
+	ctrl_size = get_ulctrl_slot_size(common)/8 > ctrl_size ? get_ulctrl_slot_size(common)/8 : ctrl_size;
+	ctx->fec_ctrl = phy_fec_create(LIQUID_FEC_CONV_V27, ctrl_size, PHY_FEC_IMPL_AUTO);
+	ctx->buf_len = 8*fec_get_enc_msg_length(LIQUID_FEC_CONV_V27, ctrl_size);
+
+	for (int mcs=0; mcs<NUM_MCS_SCHEMES; mcs++) {
+		uint payload_size = get_tbs_size(common,mcs)/8;
+		uint enc_size = fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],payload_size);
+		ctx->mcs_dec[mcs] = phy_fec_create(common->mcs_fec_scheme[mcs], payload_size, PHY_FEC_IMPL_AUTO);
+		ctx->mcs_interlvr[mcs] = interleaver_create(enc_size);
+		ctx->buf_len = 8*enc_size > ctx->buf_len ? 8*enc_size : ctx->buf_len;
+	}
+	ctx->demod_buf = malloc(ctx->buf_len);
+	ctx->deinterleaved_buf = malloc(ctx->buf_len);
+	return ctx;
+}
+
+void phy_rx_ctx_destroy(phy_rx_ctx ctx)
+{
+	phy_fec_destroy(ctx->fec_ctrl);
+	for (int mcs=0; mcs<NUM_MCS_SCHEMES; mcs++) {
+		phy_fec_destroy(ctx->mcs_dec[mcs]);
+		interleaver_destroy(ctx->mcs_interlvr[mcs]);
+	}
+	free(ctx->demod_buf);
+	free(ctx->deinterleaved_buf);
+	free(ctx);
+}
+
+// returns the resource element map of the given slot
+re_map phy_get_re_map(PhyCommon common, re_map_type type, uint slot_nr)
+{
+	return &common->re_maps[type][slot_nr];
+}
+
+// Let the rxdata_f symbols of a slot point to buf, which has to hold map->num_symb symbols
+void phy_rx_slot_bind(PhyCommon common, re_map map, float complex* buf)
+{
+	for (int i=0; i<map->num_symb; i++)
+		common->rxdata_f[map->first_symb+i] = buf + i*nfft;
+}
+
+// Let the rxdata_f symbols of a slot point to the default memory again
+void phy_rx_slot_unbind(PhyCommon common, re_map map)
+{
+	for (int i=map->first_symb; i<map->first_symb+map->num_symb; i++)
+		common->rxdata_f[i] = common->rxdata_f_mem + i*nfft;
+}
+
 /* Modulate the given data to the frequency domain data of the Phy object
  * returns the number of symbols that have been generated
  * Params:	common: 	pointer to the common phy struct
  *			subframe:	subframe number. Currently only even and uneven (0/1) is defined
- *			first_sc:	index of the first subcarrier that shall be used
- *			last_sc:	index of the last subcarrier that shall be used.
- *			first_symb:	index of the first symbol within the subframe that shall be mapped to
- *			last_symb:	index of the last symbol
+ *			map:		resource element map of the slot that shall be used
  *			mcs:		the MCS index that shall be used
  *			data:		array of symbols that will be modulated
  *			buf_len:	length of the data array
  *
  * Returns:	written_samps:	the number of symbols that have been generated
  */
-void phy_mod(PhyCommon common, uint subframe, uint first_sc, uint last_sc, uint first_symb, uint last_symb,
-			 uint mcs, uint8_t* data, uint buf_len, uint* written_samps)
-{
-	*written_samps = 0;
-	for (int sym_idx=first_symb; sym_idx<=last_symb; sym_idx++) {
-		for (int i=first_sc; i<=last_sc; i++) {
-			if ((common->pilot_symbols_tx[sym_idx] == NO_PILOT && !(common->pilot_sc[i] == OFDMFRAME_SCTYPE_NULL)) ||
-			    (common->pilot_sc[i] == OFDMFRAME_SCTYPE_DATA)) {
-				modem_modulate(common->mcs_modem[mcs],(uint)data[(*written_samps)++], &common->txdata_f[subframe][sym_idx][i]);
-				if (*written_samps >= buf_len) {
-					return;
-				}
+void phy_mod(PhyCommon common, uint subframe, re_map map, uint mcs, uint8_t* data, uint buf_len, uint* written_samps)
+{
+	phy_mod_buf(common, map, common->txdata_f[subframe][map->first_symb], mcs, data, buf_len, written_samps);
+}
+
+// Modulate the given data into a slot. slot_f points to the first subcarrier of the first symbol of the slot
+void phy_mod_buf(PhyCommon common, re_map map, float complex* slot_f, uint mcs, uint8_t* data, uint buf_len,
+				 uint* written_samps)
+{
+	const float complex* constellation = common->mcs_constellation[mcs];
+	uint num_re = buf_len < map->len ? buf_len : map->len;
+
+	for (int k=0; k<num_re; k++)
+		slot_f[map->idx[k]] = constellation[data[k]];
+	*written_samps = num_re;
+}
+
+// Probe the interleaver to obtain its bit permutation. Probe b sets every input bit n to
+// bit b of n, so bit b of the source index of output bit k can be read from output bit k.
+// This takes log2(bits) interleaver runs instead of one run per bit.
+// Returns NULL if the interleaver does not simply permute the bits
+static uint16_t* phy_gen_interleaver_perm(interleaver q, uint enc_len)
+{
+	uint num_bits = enc_len*8;
+	if (num_bits > UINT16_MAX)
+		return NULL;
+
+	uint num_probes = 1;
+	while ((1u<<num_probes) < num_bits)
+		num_probes++;
+
+	uint16_t* perm = calloc(num_bits,sizeof(uint16_t));
+	uint8_t* in = malloc(enc_len);
+	uint8_t* out = malloc(enc_len);
+	int valid = 1;
+
+	for (int b=0; b<num_probes; b++) {
+		memset(in, 0, enc_len);
+		for (int n=0; n<num_bits; n++)
+			in[n/8] |= ((n>>b) & 1) << (7-n%8);
+		interleaver_encode(q, in, out);
+		for (int k=0; k<num_bits; k++)
+			perm[k] |= ((out[k/8] >> (7-k%8)) & 1) << b;
+	}
+
+	// all bits of the input have to be used exactly once
+	uint8_t* hit = calloc(num_bits,1);
+	for (int k=0; k<num_bits && valid; k++) {
+		valid = perm[k]<num_bits && !hit[perm[k]];
+		if (valid)
+			hit[perm[k]] = 1;
+	}
+
+	// the probes cannot tell a permutation from other bit mixing.
+	// Verify the permutation with a few pseudo random messages. A local xorshift generator
+	// is used to keep the rand() sequence of simulations and tests unchanged
+	uint32_t x = 0x2545f491;
+	for (int m=0; m<4 && valid; m++) {
+		for (int i=0; i<enc_len; i++) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			in[i] = x >> 24;
+		}
+		interleaver_encode(q, in, out);
+		for (int k=0; k<num_bits && valid; k++)
+			valid = ((out[k/8] >> (7-k%8)) & 1) == ((in[perm[k]/8] >> (7-perm[k]%8)) & 1);
+	}
+
+	free(hit);
+	free(in);
+	free(out);
+	if (!valid) {
+		printf("[PHY] interleaver is not a bit permutation. Fused TX path is disabled\n");
+		free(perm);
+		return NULL;
+	}
+	return perm;
+}
+
+/* Interleave, repack and modulate the encoded data of a slot in a single pass.
+ * Each modulation symbol is assembled directly from the bits of the encoder output
+ * using the interleaver permutation and written to its final resource element.
+ * This replaces interleaver_encode(), liquid_repack_bytes() and phy_mod()
+ * Params:	common: 	pointer to the common phy struct
+ *			subframe:	subframe number. Currently only even and uneven (0/1) is defined
+ *			map:		resource element map of the slot that shall be used
+ *			mcs:		the MCS index that shall be used
+ *			enc:		output of the channel encoder. Must be encoded with mcs_fec[mcs]
+ *			enc_len:	length of the encoded message in bytes
+ *
+ * Returns:	written_samps:	the number of symbols that have been generated
+ */
+void phy_mod_encoded(PhyCommon common, uint subframe, re_map map, uint mcs, uint8_t* enc, uint enc_len,
+					 uint* written_samps)
+{
+	const uint16_t* perm = common->mcs_interlvr_perm[mcs];
+	uint bps = modem_get_bps(common->mcs_modem[mcs]);
+	uint num_bits = enc_len*8;
+
+	// fall back to separate processing steps
+	if (perm == NULL) {
+		uint bytes_written;
+		uint num_repacked = (num_bits+bps-1)/bps;
+		phy_tx_scratch_s* scratch = &common->tx_scratch;
+		interleaver_encode(common->mcs_interlvr[mcs], enc, scratch->interleaved);
+		liquid_repack_bytes(scratch->interleaved, 8, enc_len, scratch->repacked, bps, num_repacked, &bytes_written);
+		phy_mod(common, subframe, map, mcs, scratch->repacked, num_repacked, written_samps);
+		return;
+	}
+
+	const float complex* constellation = common->mcs_constellation[mcs];
+	float complex* slot_f = common->txdata_f[subframe][map->first_symb];
+
+	// symbols that are completely filled with encoded bits
+	uint num_full = num_bits/bps;
+	uint num_re = num_full < map->len ? num_full : map->len;
+	const uint16_t* p = perm;
+	for (int k=0; k<num_re; k++) {
+		uint sym = 0;
+		for (int b=0; b<bps; b++) {
+			uint n = *p++;
+			sym = (sym<<1) | ((enc[n>>3] >> (7-(n&7))) & 1);
+		}
+		slot_f[map->idx[k]] = constellation[sym];
+	}
+
+	// last symbol is padded with zeros, like liquid_repack_bytes() does
+	if (num_re == num_full && num_full*bps < num_bits && num_re < map->len) {
+		uint sym = 0;
+		for (int b=0; b<bps; b++) {
+			uint bit = 0;
+			if (num_full*bps+b < num_bits) {
+				uint n = *p++;
+				bit = (enc[n>>3] >> (7-(n&7))) & 1;
 			}
+			sym = (sym<<1) | bit;
 		}
+		slot_f[map->idx[num_re++]] = constellation[sym];
+	}
+	*written_samps = num_re;
+}
+
+// Create a soft demapper with the constellation and LLR scaling of the given liquid modem
+demapper phy_demapper_create(modem mod)
+{
+	uint bps = modem_get_bps(mod);
+	float complex constellation[1<<bps];
+	for (int s=0; s<(1<<bps); s++)
+		modem_modulate(mod, s, &constellation[s]);
+
+	// liquid approximates the LLR with gamma*(dmin_0-dmin_1)*16 with gamma=1.2*M for QAM.
+	// QPSK uses -2*gamma*x*16 with gamma=5.8, i.e. 8*gamma/a with a the amplitude per axis
+	float scale;
+	if (bps == 2)
+		scale = 8.0f*5.8f/fabsf(crealf(constellation[0]));
+	else
+		scale = 1.2f*(1<<bps)*16.0f;
+
+	demapper q = demapper_create(constellation, bps, scale);
+	if (q == NULL) {
+		printf("[PHY] Error: cannot create soft demapper for modem with %d bits per symbol\n",bps);
+		exit(EXIT_FAILURE);
 	}
+	return q;
 }
 
 // Symbol demapper with soft decision
 // returns an array with n llr values for each demapped symbol and the number of demapped bits
-void phy_demod_soft(PhyCommon common, uint first_sc, uint last_sc, uint first_symb, uint last_symb,
-					uint mcs, uint8_t* llr, uint num_llr, uint* written_samps)
+void phy_demod_soft(PhyCommon common, re_map map, uint mcs, uint8_t* llr, uint num_llr, uint* written_samps)
 {
-	*written_samps = 0;
-	uint bps = modem_get_bps(common->mcs_modem[mcs]);
+	phy_demod_soft_buf(common, map, common->rxdata_f[map->first_symb], mcs, llr, num_llr, written_samps);
+}
+
+// Soft demapping of a slot. slot_f points to the first subcarrier of the first symbol of the slot
+// The data resource elements are gathered first and demapped in one batch.
+void phy_demod_soft_buf(PhyCommon common, re_map map, float complex* slot_f, uint mcs, uint8_t* llr, uint num_llr,
+						uint* written_samps)
+{
+	demapper dem = common->mcs_demapper[mcs];
+	uint bps = demapper_get_bps(dem);
+	uint num_re = num_llr/bps < map->len ? num_llr/bps : map->len;
+
+	// collect data symbols
+	float complex re[num_re];
+	for (int k=0; k<num_re; k++)
+		re[k] = slot_f[map->idx[k]];
 
 	// demodulate signal
-	uint symbol = 0;
-	for (int sym_idx=first_symb; sym_idx<=last_symb; sym_idx++) {
-		for (int i=first_sc; i<=last_sc; i++) {
-			if ((common->pilot_symbols_rx[sym_idx] == NO_PILOT && !(common->pilot_sc[i] == OFDMFRAME_SCTYPE_NULL)) ||
-			    (common->pilot_sc[i] == OFDMFRAME_SCTYPE_DATA)) {
-				modem_demodulate_soft(common->mcs_modem[mcs], common->rxdata_f[sym_idx][i], &symbol, &llr[*written_samps]);
-				*written_samps+=bps;
-				if (*written_samps+bps >= num_llr) {
-					return;
-				}
+#ifdef PHY_FIXED_POINT
+	demapper_execute_q(dem, re, num_re, llr);
+#else
+	demapper_execute(dem, re, num_re, llr);
+#endif
+	*written_samps = num_re*bps;
+}
+
+// number of slots of the given slot type
+static uint phy_num_re_maps(re_map_type type)
+{
+	switch (type) {
+	case RE_MAP_DLSLOT:
+	case RE_MAP_ULSLOT:
+		return NUM_SLOT;
+	case RE_MAP_ULCTRL:
+		return NUM_ULCTRL_SLOT;
+	default:
+		return 1;
+	}
+}
+
+// Create the resource element map for one slot
+// If data_sc_only is set, only data subcarriers are used, even if the symbol does not contain pilots
+static void phy_gen_re_map(re_map map, uint8_t* pilot_symb, uint8_t* pilot_sc, uint first_symb, uint num_symb,
+						   int data_sc_only)
+{
+	map->first_symb = first_symb;
+	map->num_symb = num_symb;
+	map->len = 0;
+	free(map->idx);
+	map->idx = malloc(sizeof(uint16_t)*num_symb*nfft);
+
+	for (int symb=0; symb<num_symb; symb++) {
+		int no_pilot = !data_sc_only && pilot_symb[first_symb+symb] == NO_PILOT;
+		for (int i=0; i<nfft; i++) {
+			if ((no_pilot && !(pilot_sc[i] == OFDMFRAME_SCTYPE_NULL)) ||
+				(pilot_sc[i] == OFDMFRAME_SCTYPE_DATA)) {
+				map->idx[map->len++] = symb*nfft+i;
 			}
 		}
 	}
 }
 
+// Create the resource element maps of all slot types
+static void phy_gen_re_maps(PhyCommon phy, uint8_t* pilot_dl, uint8_t* pilot_ul)
+{
+	if (SLOT_LEN*nfft > UINT16_MAX) {
+		printf("[PHY] Error: FFT size %d is too large for the resource element maps\n",nfft);
+		exit(EXIT_FAILURE);
+	}
+	for (int type=0; type<NUM_RE_MAP_TYPES; type++) {
+		if (phy->re_maps[type] == NULL)
+			phy->re_maps[type] = calloc(sizeof(re_map_s),phy_num_re_maps(type));
+	}
+
+	phy_gen_re_map(phy->re_maps[RE_MAP_DLCTRL], pilot_dl, phy->pilot_sc, 0, DLCTRL_LEN, 0);
+	for (int slot=0; slot<NUM_SLOT; slot++) {
+		// DL slots start after DLCTRL, one guard symbol and the first pilot symbol of the slot
+		uint first_dl = DLCTRL_LEN+2+(SLOT_LEN+SLOT_GUARD_INTERVAL)*slot;
+		phy_gen_re_map(&phy->re_maps[RE_MAP_DLSLOT][slot], pilot_dl, phy->pilot_sc, first_dl, SLOT_LEN, 0);
+
+		// UL slot 2 and 3 are shifted back since the ULCTRL slots lie between slot 1 and 2
+		uint first_ul = (SLOT_LEN+SLOT_GUARD_INTERVAL)*slot + (slot>=2 ? 2*NUM_ULCTRL_SLOT : 0);
+		phy_gen_re_map(&phy->re_maps[RE_MAP_ULSLOT][slot], pilot_ul, phy->pilot_sc, first_ul, SLOT_LEN, 0);
+	}
+	for (int slot=0; slot<NUM_ULCTRL_SLOT; slot++) {
+		uint first_ulctrl = 2*(SLOT_LEN+SLOT_GUARD_INTERVAL)+2*slot;
+		phy_gen_re_map(&phy->re_maps[RE_MAP_ULCTRL][slot], pilot_ul, phy->pilot_sc, first_ulctrl, 1, 0);
+	}
+	// sync info and association request are written as pilot symbols, data is mapped to data subcarriers only
+	phy_gen_re_map(phy->re_maps[RE_MAP_SYNCINFO], pilot_dl, phy->pilot_sc, SUBFRAME_LEN-2, 1, 1);
+	phy_gen_re_map(phy->re_maps[RE_MAP_RACH], pilot_ul, phy->pilot_sc, SUBFRAME_LEN-SLOT_LEN+3, 1, 1);
+}
 
 void gen_pilot_symbols(PhyCommon phy, uint is_bs)
 {
@@ -230,4 +569,7 @@ void gen_pilot_symbols(PhyCommon phy, uint is_bs)
     //ulctrl slots
     pilot_ul[2*(SLOT_LEN+SLOT_GUARD_INTERVAL)] = PILOT;
     pilot_ul[2*(SLOT_LEN+SLOT_GUARD_INTERVAL)+2] = PILOT;
+
+    // create resource element maps based on the pilot allocation
+    phy_gen_re_maps(phy, pilot_dl, pilot_ul);
 }
\ No newline at end of file
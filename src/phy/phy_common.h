@@ -20,6 +20,8 @@
 #define PHY_COMMON_H_
 
 #include "phy_config.h"
+#include "phy_demapper.h"
+#include "phy_fec.h"
 #include "../mac/mac_channels.h"
 
 #include <liquid/liquid.h>
@@ -49,6 +51,30 @@ typedef union {
 
 enum {NO_PILOT, PILOT};		// definition for pilot_symbols variable
 
+// Slot types with a resource element map
+typedef enum {RE_MAP_DLCTRL, RE_MAP_DLSLOT, RE_MAP_ULSLOT, RE_MAP_ULCTRL,
+			  RE_MAP_SYNCINFO, RE_MAP_RACH, NUM_RE_MAP_TYPES} re_map_type;
+
+// Resource element map of one slot. Lists all data resource elements of the slot in mapping order.
+// Positions are stored relative to the first symbol of the slot: idx = symbol_offset*nfft + subcarrier
+typedef struct {
+	uint first_symb;	// index of the first OFDM symbol of the slot within the subframe
+	uint num_symb;		// number of OFDM symbols of the slot
+	uint len;			// number of data resource elements
+	uint16_t* idx;		// resource element positions
+} re_map_s;
+
+typedef re_map_s* re_map;
+
+// Preallocated buffers for channel encoding on the TX path. Sized at init for the largest
+// encoded message of all MCS, so that no heap allocations are required while building slots
+typedef struct {
+	uint8_t* enc;			// output of the channel encoder
+	uint8_t* interleaved;	// output of the interleaver
+	uint8_t* repacked;		// encoded bits repacked to one modulation symbol per entry
+	uint len;				// size of each buffer in bytes
+} phy_tx_scratch_s;
+
 
 // Struct contains PHY variables common to UE and BS Phy layer
 typedef struct {
@@ -66,24 +92,53 @@ typedef struct {
 	// 1. Index: subframe index: 0 for even subframes, 1 for uneven
 	// 2. Index: ofdm symbol idx.
 	// 3. Index: subcarrier idx.
+	// The symbols of one subframe are stored contiguously, i.e. txdata_f[sfn][i+1] = txdata_f[sfn][i]+nfft
 	float complex*** txdata_f;
 	// hold RX data in frequency domain
 	// 1. Index: ofdm symbol number
 	// 2. Index subcarrier idx
+	// The symbols are stored contiguously, i.e. rxdata_f[i+1] = rxdata_f[i]+nfft
+	// The symbols of a data slot can be redirected to a separate buffer with phy_rx_slot_bind(),
+	// so the OFDM receiver writes directly into the buffer that is passed to the slot decoder
 	float complex** rxdata_f;
+	float complex* rxdata_f_mem;	// default memory of rxdata_f
+
+	// resource element maps for each slot type. 1. Index: slot type, 2. Index: slot number
+	re_map_s* re_maps[NUM_RE_MAP_TYPES];
 
 	modem mcs_modem[8];	// array of modems for different mcs
-	fec fec_ctrl;       // ctrl slots are encoded with MCS 0. we add a separate coder, because data and control slots
-	                    // might be decoded in parallel (multithreading) and cannot use the same coder
-	fec mcs_fec[8];		// array of encoders/decoders for different mcs
+	float complex* mcs_constellation[8]; // constellation points of the modems, indexed by symbol
+	demapper mcs_demapper[8]; // soft demappers matching the modems. Used for all RX demodulation
+	fec mcs_fec[8];		// array of encoders for different mcs
 	fec_scheme mcs_fec_scheme[8];
 
 	interleaver mcs_interlvr[8]; // array of interleavers for different mcs
+	// bit permutation of the interleavers: bit k of the interleaved message is bit mcs_interlvr_perm[mcs][k]
+	// of the encoded message. NULL if the interleaver cannot be expressed as a bit permutation
+	uint16_t* mcs_interlvr_perm[8];
+
+	phy_tx_scratch_s tx_scratch;		// used by the slot mapping functions, called from the MAC thread
+	phy_tx_scratch_s tx_scratch_symb;	// used by the TX thread to create sync info/association request symbols
+
+	struct phy_rx_ctx_s* rx_ctx;		// decoder objects of the RX thread
 
 } PhyCommon_s;
 
 typedef PhyCommon_s* PhyCommon;
 
+// Objects required to decode a slot. Decoders and interleavers keep internal state,
+// so every thread that decodes slots owns a separate context
+typedef struct phy_rx_ctx_s {
+	phy_fec fec_ctrl;				// decoder for ctrl slots, which are encoded with MCS 0
+	phy_fec mcs_dec[8];				// array of decoders for different mcs
+	interleaver mcs_interlvr[8];	// array of interleavers for different mcs
+	uint8_t* demod_buf;				// soft bits of the received slot
+	uint8_t* deinterleaved_buf;		// deinterleaved soft bits
+	uint buf_len;					// size of the soft bit buffers
+} phy_rx_ctx_s;
+
+typedef phy_rx_ctx_s* phy_rx_ctx;
+
 // Create the common phy struct
 PhyCommon phy_common_init();
 
@@ -95,15 +150,39 @@ int get_tbs_size(PhyCommon phy, uint mcs);
 // returns the size of an UL control slot in bits
 int get_ulctrl_slot_size(PhyCommon phy);
 
+// Create the decoder objects for one slot decoding thread
+phy_rx_ctx phy_rx_ctx_create(PhyCommon common);
+void phy_rx_ctx_destroy(phy_rx_ctx ctx);
+
+// returns the resource element map of the given slot
+re_map phy_get_re_map(PhyCommon common, re_map_type type, uint slot_nr);
+
+// Let the rxdata_f symbols of a slot point to buf, which has to hold map->num_symb symbols
+void phy_rx_slot_bind(PhyCommon common, re_map map, float complex* buf);
+// Let the rxdata_f symbols of a slot point to the default memory again
+void phy_rx_slot_unbind(PhyCommon common, re_map map);
+
 // Modulate the given data to the frequency domain data of the Phy object
 // returns the number of symbols that have been generated
-void phy_mod(PhyCommon common, uint subframe, uint first_sc, uint last_sc, uint first_symb, uint last_symb,
-			 uint mcs, uint8_t* data, uint buf_len, uint* written_samps);
+void phy_mod(PhyCommon common, uint subframe, re_map map, uint mcs, uint8_t* data, uint buf_len, uint* written_samps);
+// Modulate the given data into the slot starting at the given symbol buffer
+void phy_mod_buf(PhyCommon common, re_map map, float complex* slot_f, uint mcs, uint8_t* data, uint buf_len,
+				 uint* written_samps);
+
+// Interleave, repack and modulate an encoded data slot in one pass
+// enc holds the output of the channel encoder of the given mcs
+void phy_mod_encoded(PhyCommon common, uint subframe, re_map map, uint mcs, uint8_t* enc, uint enc_len,
+					 uint* written_samps);
+
+// Create a soft demapper with the constellation and LLR scaling of the given liquid modem
+demapper phy_demapper_create(modem mod);
 
-// Symbol demapper with soft decision
+// Symbol demapper with soft decision. Uses the fixed point demapper if PHY_FIXED_POINT is defined
 // returns an array with n llr values for each demapped symbol and the number of demapped bits
-void phy_demod_soft(PhyCommon common, uint first_sc, uint last_sc, uint first_symb, uint last_symb,
-					uint mcs, uint8_t* llr, uint num_llr, uint* written_samps);
+void phy_demod_soft(PhyCommon common, re_map map, uint mcs, uint8_t* llr, uint num_llr, uint* written_samps);
+// Soft demapping of the slot starting at the given symbol buffer
+void phy_demod_soft_buf(PhyCommon common, re_map map, float complex* slot_f, uint mcs, uint8_t* llr, uint num_llr,
+						uint* written_samps);
 
 // Define which OFDM symbols whithin a subframe contain pilots
 void gen_pilot_symbols(PhyCommon phy, uint is_bs);
@@ -21,6 +21,23 @@
 #include <libconfig.h>
 #include <liquid/liquid.h>
 
+// set the numerology. If it is fixed at build time, the values are only checked
+static void phy_config_set_numerology(int cfg_nfft, int cfg_cp_len, int cfg_samplerate)
+{
+#ifdef PHY_STATIC_NUMEROLOGY
+    if (cfg_nfft!=nfft || cfg_cp_len!=cp_len || cfg_samplerate!=samplerate) {
+        LOG(ERR, "[PHY CONFIG] this build only supports nfft %d, cp_len %d, samplerate %d. "
+                 "Configuration has nfft %d, cp_len %d, samplerate %d\n",
+            nfft, cp_len, samplerate, cfg_nfft, cfg_cp_len, cfg_samplerate);
+        exit(EXIT_FAILURE);
+    }
+#else
+    nfft = cfg_nfft;
+    cp_len = cfg_cp_len;
+    samplerate = cfg_samplerate;
+#endif
+}
+
 void phy_config_load_file(char* config_file)
 {
     config_t cfg;
@@ -39,9 +56,11 @@ void phy_config_load_file(char* config_file)
     if (phy_settings!=NULL) {
         config_setting_lookup_int64(phy_settings, "dl_lo", &dl_lo);
         config_setting_lookup_int64(phy_settings,"ul_lo",&ul_lo);
-        config_setting_lookup_int(phy_settings, "nfft",&nfft);
-        config_setting_lookup_int(phy_settings, "cp_len",&cp_len);
-        config_setting_lookup_int(phy_settings, "samplerate",&samplerate);
+        int cfg_nfft = nfft, cfg_cp_len = cp_len, cfg_samplerate = samplerate;
+        config_setting_lookup_int(phy_settings, "nfft",&cfg_nfft);
+        config_setting_lookup_int(phy_settings, "cp_len",&cfg_cp_len);
+        config_setting_lookup_int(phy_settings, "samplerate",&cfg_samplerate);
+        phy_config_set_numerology(cfg_nfft, cfg_cp_len, cfg_samplerate);
         config_setting_lookup_float(phy_settings,"coarse_cfo_filt_param",&coarse_cfo_filt_param);
         config_setting_lookup_float(phy_settings,"agc_rssi_filt_param",&agc_rssi_filt_param);
         config_setting_lookup_int(phy_settings,"agc_change_threshold",&agc_change_threshold);
@@ -95,9 +114,11 @@ void phy_config_default_64()
 {
     dl_lo = DEFAULT_LO_FREQ_DL;
     ul_lo = DEFAULT_LO_FREQ_UL;
+#ifndef PHY_STATIC_NUMEROLOGY
     nfft = DEFAULT_NFFT;
     cp_len = DEFAULT_CP_LEN;
     samplerate = DEFAULT_SAMPLERATE;
+#endif
     subcarrier_alloc = malloc(nfft);
     // generate frequency domain allocation of pilot symbols
     // initialize as NULL
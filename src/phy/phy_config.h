@@ -28,6 +28,10 @@
 #define USE_RX_SLOT_THREAD
 #endif
 
+// UE_RX_SKIP_UNASSIGNED (CMake option): the UE runs the OFDM receiver (FFT, equalization) only for
+// the symbols it needs: DL ctrl, sync info, pilot symbols and the DL slots assigned to it or to broadcast.
+// All other symbols are only counted to keep the symbol timing.
+
 // Default LO frequency
 #define DEFAULT_LO_FREQ_UL 434900000 // Hz
 #define DEFAULT_LO_FREQ_DL 439700000 // Hz
@@ -49,6 +53,17 @@
 #define DL_UL_SHIFT 34		// number of ofdm symbols the UL is shifted behind
 #define MAX_USER 16
 
+// DL ctrl slot layout: DL data, UL data and UL ctrl assignments, one nibble each, followed by the HARQ byte
+#define DLCTRL_HARQ_IDX ((2*NUM_SLOT+NUM_ULCTRL_SLOT)/2)	// byte with the retransmission flags: UL slots in h4, DL slots in l4
+#define DLCTRL_PAYLOAD_LEN (DLCTRL_HARQ_IDX+1)			// DL ctrl slot size in bytes without CRC
+
+// HARQ with chase combining of data slots
+#define HARQ_MAX_TX 3				// max number of transmissions of a data slot, including the first one
+#define HARQ_NUM_BUF 4				// max number of failed data slots stored per user and direction
+#define HARQ_NACK_MAX_DELAY (FRAME_LEN/2)	// max number of subframes between a failed data slot and its NACK
+#define HARQ_RETX_DELAY 2			// min number of subframes between a UL NACK and the retransmission request
+#define HARQ_MAX_AGE (2*FRAME_LEN)	// number of subframes after which stored soft bits are discarded
+
 
 #define DEFAULT_COARSE_CFO_FILT_PARAM 0.8f
 
@@ -78,9 +93,32 @@ enum {NOT_USED, DATA, PTT_UP, PTT_DOWN}; // definition for tx_symbol allocation
 long long int dl_lo;        // Downlink carrier frequency
 long long int ul_lo;        // Uplink carrier frequency
 
+#ifdef PHY_STATIC_NUMEROLOGY
+// The numerology is fixed at build time. nfft, cp_len and samplerate are compile time
+// constants, so arrays sized by nfft have a fixed size and loops over all nfft subcarriers
+// or the samples of a symbol have constant trip counts.
+// The subcarrier allocation (num_data_sc, num_pilot_sc) and the resource element maps stay
+// runtime values, and the PHY buffers stay allocated per BS/UE instance.
+// phy_config_load_file() rejects configuration files with a different numerology
+#ifndef PHY_STATIC_NFFT
+#define PHY_STATIC_NFFT DEFAULT_NFFT
+#endif
+#ifndef PHY_STATIC_CP_LEN
+#define PHY_STATIC_CP_LEN DEFAULT_CP_LEN
+#endif
+#ifndef PHY_STATIC_SAMPLERATE
+#define PHY_STATIC_SAMPLERATE DEFAULT_SAMPLERATE
+#endif
+enum {
+    nfft = PHY_STATIC_NFFT,
+    cp_len = PHY_STATIC_CP_LEN,
+    samplerate = PHY_STATIC_SAMPLERATE
+};
+#else
 int nfft;                   // size of the fft
 int cp_len;                 // number of cyclic prefix samples
 int samplerate;             // sample-rate in samples/sec
+#endif
 char* subcarrier_alloc;     // subcarrier allocation in frequency domain
 int num_data_sc;            // total number of data subcarriers
 int num_pilot_sc;           // total number of pilot subcarriers
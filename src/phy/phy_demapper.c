@@ -0,0 +1,426 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "phy_demapper.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DEMAPPER_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DEMAPPER_SSE2
+#endif
+
+struct demapper_s {
+	uint bps;		// bits per symbol
+	uint bits_hi;	// number of bits (MSBs of the symbol) mapped to the first axis
+	uint bits_lo;	// number of bits (LSBs of the symbol) mapped to the second axis
+	int hi_is_real;	// 1 if the MSBs are mapped to the inphase axis, 0 if to the quadrature axis
+
+	// PAM levels of both axis, indexed by their bit label
+	float lvl_hi[DEMAPPER_MAX_LEVELS];
+	float lvl_lo[DEMAPPER_MAX_LEVELS];
+
+	float scale;	// scaling of the distance difference before quantization
+
+	// fixed point version of the levels and scaling. The soft bit is
+	// 127 + clamp((d0-d1)*scale_q >> 16, -256, 256) << scale_shift
+	int16_t lvl_hi_q[DEMAPPER_MAX_LEVELS];
+	int16_t lvl_lo_q[DEMAPPER_MAX_LEVELS];
+	int16_t scale_q;
+	int scale_shift;
+};
+
+// quantize a level or sample to Q13
+static inline int16_t demapper_to_q(float x)
+{
+	x = x<-DEMAPPER_Q_LIMIT ? -DEMAPPER_Q_LIMIT : x;
+	x = x>DEMAPPER_Q_LIMIT ? DEMAPPER_Q_LIMIT : x;
+	return (int16_t)(x*(1<<DEMAPPER_Q_FRAC_BITS));
+}
+
+// create the fixed point levels and scaling from the float ones
+static void demapper_gen_q(demapper q)
+{
+	for (int l=0; l<(1<<q->bits_hi); l++)
+		q->lvl_hi_q[l] = (int16_t)lroundf(q->lvl_hi[l]*(1<<DEMAPPER_Q_FRAC_BITS));
+	for (int l=0; l<(1<<q->bits_lo); l++)
+		q->lvl_lo_q[l] = (int16_t)lroundf(q->lvl_lo[l]*(1<<DEMAPPER_Q_FRAC_BITS));
+
+	// distances are Q10, i.e. the float scaling has to be multiplied with 2^16/2^10
+	float s = q->scale*64.0f;
+	q->scale_shift = 0;
+	while (s > 32767.0f && q->scale_shift < 6) {
+		s /= 2.0f;
+		q->scale_shift++;
+	}
+	q->scale_q = (int16_t)lroundf(s>32767.0f ? 32767.0f : s);
+}
+
+// extract the PAM levels of both axis. Returns 1 if the constellation is separable
+// with the MSBs on the given axis
+static int demapper_gen_levels(demapper q, const float complex* constellation, int hi_is_real)
+{
+	uint mask_lo = (1<<q->bits_lo)-1;
+	q->hi_is_real = hi_is_real;
+	for (int l=0; l<(1<<q->bits_hi); l++) {
+		float complex c = constellation[l<<q->bits_lo];
+		q->lvl_hi[l] = hi_is_real ? crealf(c) : cimagf(c);
+	}
+	for (int l=0; l<(1<<q->bits_lo); l++) {
+		float complex c = constellation[l];
+		q->lvl_lo[l] = hi_is_real ? cimagf(c) : crealf(c);
+	}
+
+	for (int s=0; s<(1<<q->bps); s++) {
+		float hi = hi_is_real ? crealf(constellation[s]) : cimagf(constellation[s]);
+		float lo = hi_is_real ? cimagf(constellation[s]) : crealf(constellation[s]);
+		if (fabsf(hi-q->lvl_hi[s>>q->bits_lo])>1e-5f || fabsf(lo-q->lvl_lo[s&mask_lo])>1e-5f)
+			return 0;
+	}
+	return 1;
+}
+
+demapper demapper_create(const float complex* constellation, uint bps, float llr_scale)
+{
+	if (bps<2 || bps>8 || bps%2)
+		return NULL;
+
+	demapper q = calloc(sizeof(struct demapper_s),1);
+	q->bps = bps;
+	q->bits_lo = bps/2;
+	q->bits_hi = bps-q->bits_lo;
+	q->scale = llr_scale;
+
+	// QAM maps the MSBs to the inphase axis, liquid's QPSK maps them to the quadrature axis
+	if (!demapper_gen_levels(q, constellation, 1) && !demapper_gen_levels(q, constellation, 0)) {
+		free(q);
+		return NULL;
+	}
+	demapper_gen_q(q);
+	return q;
+}
+
+void demapper_destroy(demapper q)
+{
+	free(q);
+}
+
+uint demapper_get_bps(demapper q)
+{
+	return q->bps;
+}
+
+// convert the distance difference to a liquid compatible soft bit
+static inline uint8_t demapper_quantize(float d0, float d1, float scale)
+{
+	float v = 127.0f + (d0-d1)*scale;
+	v = v<0.0f ? 0.0f : v;
+	v = v>255.0f ? 255.0f : v;
+	return (uint8_t)v;
+}
+
+// max-log demapping of one PAM axis for a single sample
+// out[0] receives the soft bit of the MSB
+static inline void demapper_axis_ref(const float* lvl, uint nbits, float x, float scale, uint8_t* out)
+{
+	float d0[8], d1[8];
+	for (int b=0; b<nbits; b++) {
+		d0[b] = FLT_MAX;
+		d1[b] = FLT_MAX;
+	}
+	for (int l=0; l<(1<<nbits); l++) {
+		float d = (x-lvl[l])*(x-lvl[l]);
+		for (int b=0; b<nbits; b++) {
+			if ((l>>b) & 1)
+				d1[b] = fminf(d1[b],d);
+			else
+				d0[b] = fminf(d0[b],d);
+		}
+	}
+	for (int b=0; b<nbits; b++)
+		out[nbits-1-b] = demapper_quantize(d0[b],d1[b],scale);
+}
+
+void demapper_execute_ref(demapper q, const float complex* x, uint num_symbols, uint8_t* soft_bits)
+{
+	for (int n=0; n<num_symbols; n++) {
+		float hi = q->hi_is_real ? crealf(x[n]) : cimagf(x[n]);
+		float lo = q->hi_is_real ? cimagf(x[n]) : crealf(x[n]);
+		demapper_axis_ref(q->lvl_hi, q->bits_hi, hi, q->scale, &soft_bits[n*q->bps]);
+		demapper_axis_ref(q->lvl_lo, q->bits_lo, lo, q->scale, &soft_bits[n*q->bps+q->bits_hi]);
+	}
+}
+
+#if defined(DEMAPPER_SSE2)
+// demap one axis of 4 samples. soft[k][lane] receives the result for output bit k of the axis
+static inline void demapper_axis_sse(const float* lvl, uint nbits, __m128 x, __m128 scale, int32_t soft[][4])
+{
+	__m128 d0[8], d1[8];
+	const __m128 vmax = _mm_set1_ps(FLT_MAX);
+	for (int b=0; b<nbits; b++) {
+		d0[b] = vmax;
+		d1[b] = vmax;
+	}
+	for (int l=0; l<(1<<nbits); l++) {
+		__m128 diff = _mm_sub_ps(x,_mm_set1_ps(lvl[l]));
+		__m128 d = _mm_mul_ps(diff,diff);
+		for (int b=0; b<nbits; b++) {
+			if ((l>>b) & 1)
+				d1[b] = _mm_min_ps(d1[b],d);
+			else
+				d0[b] = _mm_min_ps(d0[b],d);
+		}
+	}
+	const __m128 offset = _mm_set1_ps(127.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 full = _mm_set1_ps(255.0f);
+	for (int b=0; b<nbits; b++) {
+		__m128 v = _mm_add_ps(offset,_mm_mul_ps(_mm_sub_ps(d0[b],d1[b]),scale));
+		v = _mm_min_ps(_mm_max_ps(v,zero),full);
+		_mm_storeu_si128((__m128i*)soft[nbits-1-b],_mm_cvttps_epi32(v));
+	}
+}
+#elif defined(DEMAPPER_NEON)
+static inline void demapper_axis_neon(const float* lvl, uint nbits, float32x4_t x, float32x4_t scale, int32_t soft[][4])
+{
+	float32x4_t d0[8], d1[8];
+	const float32x4_t vmax = vdupq_n_f32(FLT_MAX);
+	for (int b=0; b<nbits; b++) {
+		d0[b] = vmax;
+		d1[b] = vmax;
+	}
+	for (int l=0; l<(1<<nbits); l++) {
+		float32x4_t diff = vsubq_f32(x,vdupq_n_f32(lvl[l]));
+		float32x4_t d = vmulq_f32(diff,diff);
+		for (int b=0; b<nbits; b++) {
+			if ((l>>b) & 1)
+				d1[b] = vminq_f32(d1[b],d);
+			else
+				d0[b] = vminq_f32(d0[b],d);
+		}
+	}
+	const float32x4_t offset = vdupq_n_f32(127.0f);
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	const float32x4_t full = vdupq_n_f32(255.0f);
+	for (int b=0; b<nbits; b++) {
+		// no vmlaq here: keep the rounding identical to the scalar reference
+		float32x4_t v = vaddq_f32(offset,vmulq_f32(vsubq_f32(d0[b],d1[b]),scale));
+		v = vminq_f32(vmaxq_f32(v,zero),full);
+		vst1q_s32(soft[nbits-1-b],vcvtq_s32_f32(v));
+	}
+}
+#endif
+
+void demapper_execute(demapper q, const float complex* x, uint num_symbols, uint8_t* soft_bits)
+{
+	uint n = 0;
+#if defined(DEMAPPER_SSE2) || defined(DEMAPPER_NEON)
+	const uint bps = q->bps;
+	int32_t soft[8][4];
+	for (; n+4<=num_symbols; n+=4) {
+#if defined(DEMAPPER_SSE2)
+		// deinterleave 4 complex samples into real and imaginary vectors
+		__m128 a = _mm_loadu_ps((const float*)&x[n]);
+		__m128 b = _mm_loadu_ps((const float*)&x[n+2]);
+		__m128 re = _mm_shuffle_ps(a,b,_MM_SHUFFLE(2,0,2,0));
+		__m128 im = _mm_shuffle_ps(a,b,_MM_SHUFFLE(3,1,3,1));
+		__m128 scale = _mm_set1_ps(q->scale);
+		demapper_axis_sse(q->lvl_hi, q->bits_hi, q->hi_is_real ? re : im, scale, &soft[0]);
+		demapper_axis_sse(q->lvl_lo, q->bits_lo, q->hi_is_real ? im : re, scale, &soft[q->bits_hi]);
+#else
+		float32x4x2_t v = vld2q_f32((const float*)&x[n]);
+		float32x4_t scale = vdupq_n_f32(q->scale);
+		demapper_axis_neon(q->lvl_hi, q->bits_hi, v.val[q->hi_is_real ? 0 : 1], scale, &soft[0]);
+		demapper_axis_neon(q->lvl_lo, q->bits_lo, v.val[q->hi_is_real ? 1 : 0], scale, &soft[q->bits_hi]);
+#endif
+		// write soft bits in symbol order
+		uint8_t* out = &soft_bits[n*bps];
+		for (int lane=0; lane<4; lane++)
+			for (int k=0; k<bps; k++)
+				*out++ = (uint8_t)soft[k][lane];
+	}
+#endif
+	// remaining symbols
+	if (n<num_symbols)
+		demapper_execute_ref(q, &x[n], num_symbols-n, &soft_bits[n*q->bps]);
+}
+
+// max-log demapping of one PAM axis for a single sample in fixed point
+static inline void demapper_axis_q_ref(const int16_t* lvl, uint nbits, int16_t x, int16_t scale, int shift,
+									   uint8_t* out)
+{
+	int16_t d0[8], d1[8];
+	for (int b=0; b<nbits; b++) {
+		d0[b] = INT16_MAX;
+		d1[b] = INT16_MAX;
+	}
+	for (int l=0; l<(1<<nbits); l++) {
+		int32_t diff = x-lvl[l];
+		int16_t d = (diff*diff)>>16;
+		for (int b=0; b<nbits; b++) {
+			if ((l>>b) & 1)
+				d1[b] = d<d1[b] ? d : d1[b];
+			else
+				d0[b] = d<d0[b] ? d : d0[b];
+		}
+	}
+	for (int b=0; b<nbits; b++) {
+		int32_t v = ((d0[b]-d1[b])*scale)>>16;
+		v = v<-256 ? -256 : (v>256 ? 256 : v);
+		v = 127 + v*(1<<shift);
+		out[nbits-1-b] = v<0 ? 0 : (v>255 ? 255 : v);
+	}
+}
+
+void demapper_execute_q_ref(demapper q, const float complex* x, uint num_symbols, uint8_t* soft_bits)
+{
+	for (int n=0; n<num_symbols; n++) {
+		int16_t hi = demapper_to_q(q->hi_is_real ? crealf(x[n]) : cimagf(x[n]));
+		int16_t lo = demapper_to_q(q->hi_is_real ? cimagf(x[n]) : crealf(x[n]));
+		demapper_axis_q_ref(q->lvl_hi_q, q->bits_hi, hi, q->scale_q, q->scale_shift, &soft_bits[n*q->bps]);
+		demapper_axis_q_ref(q->lvl_lo_q, q->bits_lo, lo, q->scale_q, q->scale_shift,
+							&soft_bits[n*q->bps+q->bits_hi]);
+	}
+}
+
+#if defined(DEMAPPER_SSE2)
+// quantize 4 float samples to Q13, truncating like the scalar reference
+static inline __m128i demapper_to_q_sse(__m128 x)
+{
+	const __m128 lim = _mm_set1_ps(DEMAPPER_Q_LIMIT);
+	x = _mm_min_ps(_mm_max_ps(x,_mm_sub_ps(_mm_setzero_ps(),lim)),lim);
+	return _mm_cvttps_epi32(_mm_mul_ps(x,_mm_set1_ps(1<<DEMAPPER_Q_FRAC_BITS)));
+}
+
+// demap one axis of 8 samples. soft[k] receives the results for output bit k of the axis
+static inline void demapper_axis_q_sse(const int16_t* lvl, uint nbits, __m128i x, __m128i scale, __m128i shift,
+									   uint8_t soft[][8])
+{
+	__m128i d0[8], d1[8];
+	const __m128i vmax = _mm_set1_epi16(INT16_MAX);
+	for (int b=0; b<nbits; b++) {
+		d0[b] = vmax;
+		d1[b] = vmax;
+	}
+	for (int l=0; l<(1<<nbits); l++) {
+		__m128i diff = _mm_sub_epi16(x,_mm_set1_epi16(lvl[l]));
+		__m128i d = _mm_mulhi_epi16(diff,diff);
+		for (int b=0; b<nbits; b++) {
+			if ((l>>b) & 1)
+				d1[b] = _mm_min_epi16(d1[b],d);
+			else
+				d0[b] = _mm_min_epi16(d0[b],d);
+		}
+	}
+	const __m128i lo = _mm_set1_epi16(-256);
+	const __m128i hi = _mm_set1_epi16(256);
+	const __m128i offset = _mm_set1_epi16(127);
+	for (int b=0; b<nbits; b++) {
+		__m128i v = _mm_mulhi_epi16(_mm_sub_epi16(d0[b],d1[b]),scale);
+		v = _mm_min_epi16(_mm_max_epi16(v,lo),hi);
+		v = _mm_adds_epi16(_mm_sll_epi16(v,shift),offset);
+		_mm_storel_epi64((__m128i*)soft[nbits-1-b],_mm_packus_epi16(v,v));
+	}
+}
+#elif defined(DEMAPPER_NEON)
+static inline int16x4_t demapper_to_q_neon(float32x4_t x)
+{
+	const float32x4_t lim = vdupq_n_f32(DEMAPPER_Q_LIMIT);
+	x = vminq_f32(vmaxq_f32(x,vnegq_f32(lim)),lim);
+	return vmovn_s32(vcvtq_n_s32_f32(x,DEMAPPER_Q_FRAC_BITS));
+}
+
+static inline void demapper_axis_q_neon(const int16_t* lvl, uint nbits, int16x8_t x, int16x8_t scale,
+										int16x8_t shift, uint8_t soft[][8])
+{
+	int16x8_t d0[8], d1[8];
+	const int16x8_t vmax = vdupq_n_s16(INT16_MAX);
+	for (int b=0; b<nbits; b++) {
+		d0[b] = vmax;
+		d1[b] = vmax;
+	}
+	for (int l=0; l<(1<<nbits); l++) {
+		int16x8_t diff = vsubq_s16(x,vdupq_n_s16(lvl[l]));
+		// (2*diff*diff)>>16>>1 equals (diff*diff)>>16, diff is never -32768
+		int16x8_t d = vshrq_n_s16(vqdmulhq_s16(diff,diff),1);
+		for (int b=0; b<nbits; b++) {
+			if ((l>>b) & 1)
+				d1[b] = vminq_s16(d1[b],d);
+			else
+				d0[b] = vminq_s16(d0[b],d);
+		}
+	}
+	const int16x8_t lo = vdupq_n_s16(-256);
+	const int16x8_t hi = vdupq_n_s16(256);
+	const int16x8_t offset = vdupq_n_s16(127);
+	for (int b=0; b<nbits; b++) {
+		int16x8_t v = vshrq_n_s16(vqdmulhq_s16(vsubq_s16(d0[b],d1[b]),scale),1);
+		v = vminq_s16(vmaxq_s16(v,lo),hi);
+		v = vqaddq_s16(vshlq_s16(v,shift),offset);
+		vst1_u8(soft[nbits-1-b],vqmovun_s16(v));
+	}
+}
+#endif
+
+void demapper_execute_q(demapper q, const float complex* x, uint num_symbols, uint8_t* soft_bits)
+{
+	uint n = 0;
+#if defined(DEMAPPER_SSE2) || defined(DEMAPPER_NEON)
+	const uint bps = q->bps;
+	uint8_t soft[8][8];
+	for (; n+8<=num_symbols; n+=8) {
+#if defined(DEMAPPER_SSE2)
+		// deinterleave 8 complex samples into real and imaginary vectors
+		__m128 a = _mm_loadu_ps((const float*)&x[n]);
+		__m128 b = _mm_loadu_ps((const float*)&x[n+2]);
+		__m128 c = _mm_loadu_ps((const float*)&x[n+4]);
+		__m128 d = _mm_loadu_ps((const float*)&x[n+6]);
+		__m128i re = _mm_packs_epi32(demapper_to_q_sse(_mm_shuffle_ps(a,b,_MM_SHUFFLE(2,0,2,0))),
+									 demapper_to_q_sse(_mm_shuffle_ps(c,d,_MM_SHUFFLE(2,0,2,0))));
+		__m128i im = _mm_packs_epi32(demapper_to_q_sse(_mm_shuffle_ps(a,b,_MM_SHUFFLE(3,1,3,1))),
+									 demapper_to_q_sse(_mm_shuffle_ps(c,d,_MM_SHUFFLE(3,1,3,1))));
+		__m128i scale = _mm_set1_epi16(q->scale_q);
+		__m128i shift = _mm_cvtsi32_si128(q->scale_shift);
+		demapper_axis_q_sse(q->lvl_hi_q, q->bits_hi, q->hi_is_real ? re : im, scale, shift, &soft[0]);
+		demapper_axis_q_sse(q->lvl_lo_q, q->bits_lo, q->hi_is_real ? im : re, scale, shift, &soft[q->bits_hi]);
+#else
+		float32x4x2_t v0 = vld2q_f32((const float*)&x[n]);
+		float32x4x2_t v1 = vld2q_f32((const float*)&x[n+4]);
+		int16x8_t re = vcombine_s16(demapper_to_q_neon(v0.val[0]),demapper_to_q_neon(v1.val[0]));
+		int16x8_t im = vcombine_s16(demapper_to_q_neon(v0.val[1]),demapper_to_q_neon(v1.val[1]));
+		int16x8_t scale = vdupq_n_s16(q->scale_q);
+		int16x8_t shift = vdupq_n_s16(q->scale_shift);
+		demapper_axis_q_neon(q->lvl_hi_q, q->bits_hi, q->hi_is_real ? re : im, scale, shift, &soft[0]);
+		demapper_axis_q_neon(q->lvl_lo_q, q->bits_lo, q->hi_is_real ? im : re, scale, shift, &soft[q->bits_hi]);
+#endif
+		// write soft bits in symbol order
+		uint8_t* out = &soft_bits[n*bps];
+		for (int lane=0; lane<8; lane++)
+			for (int k=0; k<bps; k++)
+				*out++ = soft[k][lane];
+	}
+#endif
+	// remaining symbols
+	if (n<num_symbols)
+		demapper_execute_q_ref(q, &x[n], num_symbols-n, &soft_bits[n*q->bps]);
+}
@@ -0,0 +1,69 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef PHY_DEMAPPER_H_
+#define PHY_DEMAPPER_H_
+
+#include <complex.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Table driven max-log soft demapper for square QAM constellations (incl. QPSK)
+// The constellation is split into two independent PAM axes. For each axis the
+// distance to every level is computed and the minimum distance for bit=0/bit=1
+// is tracked per bit. Several symbols are processed in parallel with NEON/SSE.
+//
+// Output format is identical to liquid's modem_demodulate_soft():
+// one byte per bit, MSB first, 0 = strong '0', 255 = strong '1', 127 = erasure
+
+// maximum number of levels per axis (256-QAM)
+#define DEMAPPER_MAX_LEVELS 16
+
+// Fixed point demapping (demapper_execute_q): samples and levels are quantized to Q13 int16.
+// Samples are limited to +-DEMAPPER_Q_LIMIT, where the soft bits of all supported
+// constellations are saturated already. Squared distances are kept in Q10 and all
+// 8 samples of a vector are processed in int16 lanes.
+#define DEMAPPER_Q_FRAC_BITS 13
+#define DEMAPPER_Q_LIMIT (16383.0f/(1<<DEMAPPER_Q_FRAC_BITS))
+
+typedef struct demapper_s* demapper;
+
+// Create a demapper object for a constellation with 2^bps points
+// constellation[s] has to hold the complex point of symbol s.
+// llr_scale is the factor applied to the distance difference before quantization.
+// Returns NULL if the constellation is not a separable square QAM
+demapper demapper_create(const float complex* constellation, uint bps, float llr_scale);
+void demapper_destroy(demapper q);
+
+// number of bits per symbol
+uint demapper_get_bps(demapper q);
+
+// demap num_symbols constellation points to num_symbols*bps soft bits
+void demapper_execute(demapper q, const float complex* x, uint num_symbols, uint8_t* soft_bits);
+
+// scalar reference implementation. Produces the same output as demapper_execute()
+void demapper_execute_ref(demapper q, const float complex* x, uint num_symbols, uint8_t* soft_bits);
+
+// fixed point demapping. Same output format, the soft bits differ from demapper_execute()
+// by the quantization of the distances only
+void demapper_execute_q(demapper q, const float complex* x, uint num_symbols, uint8_t* soft_bits);
+
+// scalar reference implementation. Produces exactly the same output as demapper_execute_q()
+void demapper_execute_q_ref(demapper q, const float complex* x, uint num_symbols, uint8_t* soft_bits);
+
+#endif /* PHY_DEMAPPER_H_ */
@@ -0,0 +1,306 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "phy_fec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PHY_FEC_SSE2
+#endif
+
+// NEON kernel is compiled in a separate translation unit with NEON enabled
+#if defined(PHY_FEC_HAVE_NEON) && defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// Generator polynomials of the K=7 r=1/2 code. Same as liquid/libfec V27POLYA and V27POLYB
+#define PHY_FEC_K 7
+#define PHY_FEC_POLYA 0x4f
+#define PHY_FEC_POLYB 0x6d
+
+// initial metric of all states except the start state
+#define PHY_FEC_INIT_METRIC 4096
+
+// puncturing pattern of rate 3/4. Same as liquid's fec_conv27p34_matrix
+#define PHY_FEC_P34_PERIOD 3
+static const uint8_t phy_fec_p34_matrix[2][PHY_FEC_P34_PERIOD] = {{1,1,0},{1,0,1}};
+
+struct phy_fec_s {
+	fec_scheme scheme;
+	phy_fec_impl impl;
+	fec liquid;				// liquid decoder, only used with PHY_FEC_IMPL_LIQUID
+
+	uint max_dec_len;		// maximum message length in bytes
+	uint8_t* sym;			// depunctured soft bits, two per trellis step
+	uint32_t* dec;			// decision bits, two words per trellis step
+	int16_t metrics[PHY_FEC_NUM_STATES];
+
+	// expected output of butterfly i for input bit 0: 255 for '1', 0 for '0'
+	int16_t mask_a[PHY_FEC_NUM_STATES/2];
+	int16_t mask_b[PHY_FEC_NUM_STATES/2];
+};
+
+static int phy_fec_parity(uint x)
+{
+	return __builtin_parity(x);
+}
+
+static int phy_fec_has_simd()
+{
+#if defined(PHY_FEC_HAVE_NEON) && defined(__aarch64__)
+	return 1;
+#elif defined(PHY_FEC_HAVE_NEON) && defined(__arm__)
+	return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#elif defined(PHY_FEC_SSE2)
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+static void phy_fec_alloc(phy_fec q, uint dec_msg_len)
+{
+	uint num_steps = 8*dec_msg_len+PHY_FEC_K-1;
+	free(q->sym);
+	free(q->dec);
+	q->sym = malloc(2*num_steps);
+	q->dec = malloc(sizeof(uint32_t)*2*num_steps);
+	q->max_dec_len = dec_msg_len;
+}
+
+phy_fec phy_fec_create(fec_scheme scheme, uint max_dec_msg_len, phy_fec_impl impl)
+{
+	phy_fec q = calloc(sizeof(struct phy_fec_s),1);
+	q->scheme = scheme;
+
+#ifdef PHY_FEC_LIQUID
+	impl = PHY_FEC_IMPL_LIQUID;
+#endif
+	if (scheme != LIQUID_FEC_CONV_V27 && scheme != LIQUID_FEC_CONV_V27P34)
+		impl = PHY_FEC_IMPL_LIQUID;
+	if (impl == PHY_FEC_IMPL_AUTO || impl == PHY_FEC_IMPL_SIMD)
+		impl = phy_fec_has_simd() ? PHY_FEC_IMPL_SIMD : PHY_FEC_IMPL_SCALAR;
+	q->impl = impl;
+
+	if (impl == PHY_FEC_IMPL_LIQUID) {
+		q->liquid = fec_create(scheme, NULL);
+		return q;
+	}
+
+	// branch outputs for state i and input bit 0, i.e. shift register 2*i
+	for (int i=0; i<PHY_FEC_NUM_STATES/2; i++) {
+		q->mask_a[i] = phy_fec_parity((2*i) & PHY_FEC_POLYA) ? 255 : 0;
+		q->mask_b[i] = phy_fec_parity((2*i) & PHY_FEC_POLYB) ? 255 : 0;
+	}
+	phy_fec_alloc(q, max_dec_msg_len);
+	return q;
+}
+
+void phy_fec_destroy(phy_fec q)
+{
+	if (q->liquid)
+		fec_destroy(q->liquid);
+	free(q->sym);
+	free(q->dec);
+	free(q);
+}
+
+phy_fec_impl phy_fec_get_impl(phy_fec q)
+{
+	return q->impl;
+}
+
+const char* phy_fec_impl_str(phy_fec_impl impl)
+{
+	switch (impl) {
+	case PHY_FEC_IMPL_LIQUID:
+		return "liquid";
+	case PHY_FEC_IMPL_SCALAR:
+		return "scalar";
+	case PHY_FEC_IMPL_SIMD:
+#if defined(PHY_FEC_HAVE_NEON)
+		return "neon";
+#else
+		return "sse2";
+#endif
+	default:
+		return "auto";
+	}
+}
+
+// subtract the smallest metric from all states
+static void phy_fec_renormalize(int16_t* metrics)
+{
+	int16_t min = metrics[0];
+	for (int s=1; s<PHY_FEC_NUM_STATES; s++)
+		min = metrics[s]<min ? metrics[s] : min;
+	for (int s=0; s<PHY_FEC_NUM_STATES; s++)
+		metrics[s] -= min;
+}
+
+// Portable add-compare-select. The butterfly of state i and i+32 feeds state 2i and 2i+1.
+// Since both polynomials have the first and last tap set, the branch metrics of
+// the butterfly are m (i->2i, i+32->2i+1) and 510-m (i->2i+1, i+32->2i)
+static void phy_fec_acs_scalar(const int16_t* mask_a, const int16_t* mask_b, int16_t* metrics, const uint8_t* sym,
+							   uint num_steps, uint32_t* dec)
+{
+	int16_t new_metrics[PHY_FEC_NUM_STATES];
+	const int half = PHY_FEC_NUM_STATES/2;
+
+	for (int t=0; t<num_steps; t++) {
+		uint32_t dec_even = 0, dec_odd = 0;
+		for (int i=0; i<half; i++) {
+			int16_t m = (sym[2*t] ^ mask_a[i]) + (sym[2*t+1] ^ mask_b[i]);
+			int16_t mc = 510 - m;
+			int16_t e0 = metrics[i] + m;
+			int16_t e1 = metrics[i+half] + mc;
+			int16_t o0 = metrics[i] + mc;
+			int16_t o1 = metrics[i+half] + m;
+			new_metrics[2*i]   = e1<e0 ? e1 : e0;
+			new_metrics[2*i+1] = o1<o0 ? o1 : o0;
+			dec_even |= (uint32_t)(e1<e0) << i;
+			dec_odd  |= (uint32_t)(o1<o0) << i;
+		}
+		dec[2*t] = dec_even;
+		dec[2*t+1] = dec_odd;
+		memcpy(metrics, new_metrics, sizeof(new_metrics));
+		if ((t+1) % PHY_FEC_RENORM_INTERVAL == 0)
+			phy_fec_renormalize(metrics);
+	}
+}
+
+#if defined(PHY_FEC_SSE2)
+// SSE2 add-compare-select. Processes 8 butterflies per vector, see phy_fec_acs_scalar()
+static void phy_fec_acs_sse2(const int16_t* mask_a, const int16_t* mask_b, int16_t* metrics, const uint8_t* sym,
+							 uint num_steps, uint32_t* dec)
+{
+	__m128i m_a[4], m_b[4], old[8];
+	for (int k=0; k<4; k++) {
+		m_a[k] = _mm_loadu_si128((const __m128i*)&mask_a[8*k]);
+		m_b[k] = _mm_loadu_si128((const __m128i*)&mask_b[8*k]);
+	}
+	for (int k=0; k<8; k++)
+		old[k] = _mm_loadu_si128((const __m128i*)&metrics[8*k]);
+	const __m128i max_m = _mm_set1_epi16(510);
+
+	for (int t=0; t<num_steps; t++) {
+		__m128i s_a = _mm_set1_epi16(sym[2*t]);
+		__m128i s_b = _mm_set1_epi16(sym[2*t+1]);
+		__m128i new[8], d_even[4], d_odd[4];
+		for (int k=0; k<4; k++) {
+			__m128i m = _mm_add_epi16(_mm_xor_si128(s_a,m_a[k]),_mm_xor_si128(s_b,m_b[k]));
+			__m128i mc = _mm_sub_epi16(max_m,m);
+			__m128i e0 = _mm_add_epi16(old[k],m);
+			__m128i e1 = _mm_add_epi16(old[k+4],mc);
+			__m128i o0 = _mm_add_epi16(old[k],mc);
+			__m128i o1 = _mm_add_epi16(old[k+4],m);
+			__m128i even = _mm_min_epi16(e0,e1);
+			__m128i odd = _mm_min_epi16(o0,o1);
+			d_even[k] = _mm_cmplt_epi16(e1,e0);
+			d_odd[k] = _mm_cmplt_epi16(o1,o0);
+			// interleave to natural state order
+			new[2*k] = _mm_unpacklo_epi16(even,odd);
+			new[2*k+1] = _mm_unpackhi_epi16(even,odd);
+		}
+		dec[2*t] = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(d_even[0],d_even[1])) |
+				   (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(d_even[2],d_even[3])) << 16;
+		dec[2*t+1] = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(d_odd[0],d_odd[1])) |
+					 (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(d_odd[2],d_odd[3])) << 16;
+
+		if ((t+1) % PHY_FEC_RENORM_INTERVAL == 0) {
+			__m128i min = new[0];
+			for (int k=1; k<8; k++)
+				min = _mm_min_epi16(min,new[k]);
+			min = _mm_min_epi16(min,_mm_shuffle_epi32(min,_MM_SHUFFLE(1,0,3,2)));
+			min = _mm_min_epi16(min,_mm_shuffle_epi32(min,_MM_SHUFFLE(2,3,0,1)));
+			min = _mm_min_epi16(min,_mm_shufflelo_epi16(_mm_shufflehi_epi16(min,_MM_SHUFFLE(2,3,0,1)),
+														 _MM_SHUFFLE(2,3,0,1)));
+			for (int k=0; k<8; k++)
+				new[k] = _mm_sub_epi16(new[k],min);
+		}
+		for (int k=0; k<8; k++)
+			old[k] = new[k];
+	}
+	for (int k=0; k<8; k++)
+		_mm_storeu_si128((__m128i*)&metrics[8*k],old[k]);
+}
+#endif
+
+// Restore one pair of soft bits per trellis step. Punctured bits are inserted as erasures
+static void phy_fec_depuncture(phy_fec q, const uint8_t* msg_enc, uint num_steps)
+{
+	if (q->scheme == LIQUID_FEC_CONV_V27) {
+		memcpy(q->sym, msg_enc, 2*num_steps);
+		return;
+	}
+	uint n = 0;
+	for (int t=0; t<num_steps; t++) {
+		int p = t % PHY_FEC_P34_PERIOD;
+		q->sym[2*t]   = phy_fec_p34_matrix[0][p] ? msg_enc[n++] : 127;
+		q->sym[2*t+1] = phy_fec_p34_matrix[1][p] ? msg_enc[n++] : 127;
+	}
+}
+
+// Trace back from the zero state. The encoder is terminated with K-1 zero bits
+static void phy_fec_chainback(phy_fec q, uint dec_msg_len, uint num_steps, uint8_t* msg_dec)
+{
+	uint state = 0;
+	memset(msg_dec, 0, dec_msg_len);
+	for (int t=num_steps-1; t>=0; t--) {
+		uint i = state >> 1;
+		uint bit = state & 1;
+		if (t < 8*dec_msg_len)
+			msg_dec[t/8] |= bit << (7-t%8);
+		uint d = (q->dec[2*t+bit] >> i) & 1;
+		state = i + d*(PHY_FEC_NUM_STATES/2);
+	}
+}
+
+void phy_fec_decode_soft(phy_fec q, uint dec_msg_len, uint8_t* msg_enc, uint8_t* msg_dec)
+{
+	if (q->impl == PHY_FEC_IMPL_LIQUID) {
+		fec_decode_soft(q->liquid, dec_msg_len, msg_enc, msg_dec);
+		return;
+	}
+	if (dec_msg_len > q->max_dec_len)
+		phy_fec_alloc(q, dec_msg_len);
+
+	uint num_steps = 8*dec_msg_len+PHY_FEC_K-1;
+	phy_fec_depuncture(q, msg_enc, num_steps);
+
+	// start in the zero state
+	q->metrics[0] = 0;
+	for (int s=1; s<PHY_FEC_NUM_STATES; s++)
+		q->metrics[s] = PHY_FEC_INIT_METRIC;
+
+	if (q->impl == PHY_FEC_IMPL_SIMD) {
+#if defined(PHY_FEC_HAVE_NEON)
+		phy_fec_acs_neon(q->mask_a, q->mask_b, q->metrics, q->sym, num_steps, q->dec);
+#elif defined(PHY_FEC_SSE2)
+		phy_fec_acs_sse2(q->mask_a, q->mask_b, q->metrics, q->sym, num_steps, q->dec);
+#endif
+	} else {
+		phy_fec_acs_scalar(q->mask_a, q->mask_b, q->metrics, q->sym, num_steps, q->dec);
+	}
+	phy_fec_chainback(q, dec_msg_len, num_steps, msg_dec);
+}
@@ -0,0 +1,66 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef PHY_FEC_H_
+#define PHY_FEC_H_
+
+#include <liquid/liquid.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Soft decision decoder for the convolutional codes of the MCS table.
+// LIQUID_FEC_CONV_V27 and LIQUID_FEC_CONV_V27P34 are decoded with an in-tree
+// K=7 Viterbi decoder (NEON/SSE2 with scalar fallback). The implementation is
+// selected at runtime depending on the CPU features. All other schemes, or all
+// schemes if PHY_FEC_LIQUID is defined at build time, are passed to liquid.
+//
+// Input and output format is identical to liquid's fec_decode_soft():
+// one soft bit per byte, 0 = strong '0', 255 = strong '1', 127 = erasure
+
+typedef enum {
+	PHY_FEC_IMPL_AUTO,		// pick the fastest implementation available
+	PHY_FEC_IMPL_LIQUID,	// liquid's fec_decode_soft()
+	PHY_FEC_IMPL_SCALAR,	// in-tree Viterbi decoder, portable C
+	PHY_FEC_IMPL_SIMD		// in-tree Viterbi decoder, NEON/SSE2
+} phy_fec_impl;
+
+typedef struct phy_fec_s* phy_fec;
+
+// Create a decoder for messages of up to max_dec_msg_len bytes.
+// If the requested implementation is not available, the next best one is used.
+phy_fec phy_fec_create(fec_scheme scheme, uint max_dec_msg_len, phy_fec_impl impl);
+void phy_fec_destroy(phy_fec q);
+
+// returns the implementation that is used by the decoder
+phy_fec_impl phy_fec_get_impl(phy_fec q);
+const char* phy_fec_impl_str(phy_fec_impl impl);
+
+// decode a message of dec_msg_len bytes from fec_get_enc_msg_length() soft bits
+void phy_fec_decode_soft(phy_fec q, uint dec_msg_len, uint8_t* msg_enc, uint8_t* msg_dec);
+
+// Internal: add-compare-select over num_steps trellis steps of the K=7 code.
+// mask_a/mask_b hold 255 if butterfly i expects a '1' on the respective output, otherwise 0.
+// sym holds two soft bits per step, metrics the 64 path metrics. Two decision words are written per step:
+// dec[2t] for the even states (bit i: new state 2i), dec[2t+1] for the odd states (bit i: new state 2i+1)
+// The 16bit path metrics are normalized every PHY_FEC_RENORM_INTERVAL steps
+#define PHY_FEC_NUM_STATES 64
+#define PHY_FEC_RENORM_INTERVAL 32
+void phy_fec_acs_neon(const int16_t* mask_a, const int16_t* mask_b, int16_t* metrics, const uint8_t* sym,
+					  uint num_steps, uint32_t* dec);
+
+#endif /* PHY_FEC_H_ */
@@ -0,0 +1,96 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// NEON add-compare-select of the Viterbi decoder.
+// This file is compiled with NEON enabled, phy_fec.c only calls it if the CPU supports NEON.
+
+#include "phy_fec.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+// collect the MSB of 16 byte lanes into a bitmask
+static inline uint32_t phy_fec_movemask_neon(uint8x16_t x)
+{
+	static const uint8_t weights[16] = {1,2,4,8,16,32,64,128,1,2,4,8,16,32,64,128};
+	uint8x16_t bits = vandq_u8(vshrq_n_u8(x,7),vld1q_u8(weights));
+	// weights are distinct powers of two, so the sums are the or'ed bitmask
+	uint8x8_t sum = vpadd_u8(vget_low_u8(bits),vget_high_u8(bits));
+	sum = vpadd_u8(sum,sum);
+	sum = vpadd_u8(sum,sum);
+	return vget_lane_u8(sum,0) | (uint32_t)vget_lane_u8(sum,1) << 8;
+}
+
+// Processes 8 butterflies per vector, see phy_fec_acs_scalar()
+void phy_fec_acs_neon(const int16_t* mask_a, const int16_t* mask_b, int16_t* metrics, const uint8_t* sym,
+					  uint num_steps, uint32_t* dec)
+{
+	int16x8_t m_a[4], m_b[4], old[8];
+	for (int k=0; k<4; k++) {
+		m_a[k] = vld1q_s16(&mask_a[8*k]);
+		m_b[k] = vld1q_s16(&mask_b[8*k]);
+	}
+	for (int k=0; k<8; k++)
+		old[k] = vld1q_s16(&metrics[8*k]);
+	const int16x8_t max_m = vdupq_n_s16(510);
+
+	for (int t=0; t<num_steps; t++) {
+		int16x8_t s_a = vdupq_n_s16(sym[2*t]);
+		int16x8_t s_b = vdupq_n_s16(sym[2*t+1]);
+		int16x8_t new[8];
+		uint16x8_t d_even[4], d_odd[4];
+		for (int k=0; k<4; k++) {
+			int16x8_t m = vaddq_s16(veorq_s16(s_a,m_a[k]),veorq_s16(s_b,m_b[k]));
+			int16x8_t mc = vsubq_s16(max_m,m);
+			int16x8_t e0 = vaddq_s16(old[k],m);
+			int16x8_t e1 = vaddq_s16(old[k+4],mc);
+			int16x8_t o0 = vaddq_s16(old[k],mc);
+			int16x8_t o1 = vaddq_s16(old[k+4],m);
+			int16x8_t even = vminq_s16(e0,e1);
+			int16x8_t odd = vminq_s16(o0,o1);
+			d_even[k] = vcltq_s16(e1,e0);
+			d_odd[k] = vcltq_s16(o1,o0);
+			// interleave to natural state order
+			int16x8x2_t z = vzipq_s16(even,odd);
+			new[2*k] = z.val[0];
+			new[2*k+1] = z.val[1];
+		}
+		dec[2*t] = phy_fec_movemask_neon(vcombine_u8(vmovn_u16(d_even[0]),vmovn_u16(d_even[1]))) |
+				   phy_fec_movemask_neon(vcombine_u8(vmovn_u16(d_even[2]),vmovn_u16(d_even[3]))) << 16;
+		dec[2*t+1] = phy_fec_movemask_neon(vcombine_u8(vmovn_u16(d_odd[0]),vmovn_u16(d_odd[1]))) |
+					 phy_fec_movemask_neon(vcombine_u8(vmovn_u16(d_odd[2]),vmovn_u16(d_odd[3]))) << 16;
+
+		if ((t+1) % PHY_FEC_RENORM_INTERVAL == 0) {
+			int16x8_t min = new[0];
+			for (int k=1; k<8; k++)
+				min = vminq_s16(min,new[k]);
+			int16x4_t min4 = vpmin_s16(vget_low_s16(min),vget_high_s16(min));
+			min4 = vpmin_s16(min4,min4);
+			min4 = vpmin_s16(min4,min4);
+			int16x8_t vmin = vdupq_lane_s16(min4,0);
+			for (int k=0; k<8; k++)
+				new[k] = vsubq_s16(new[k],vmin);
+		}
+		for (int k=0; k<8; k++)
+			old[k] = new[k];
+	}
+	for (int k=0; k<8; k++)
+		vst1q_s16(&metrics[8*k],old[k]);
+}
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "phy_harq.h"
+#include <string.h>
+
+// A stored slot. The soft bits are those of the first transmission
+typedef struct {
+	uint8_t* soft;		// stored LLRs, signed 4 bit, two per byte
+	uint num_soft;		// number of stored soft bits. 0 if the buffer is unused
+	uint mcs;
+	uint tx_cnt;		// number of received transmissions
+	uint subframe;		// subframe and slot of the last transmission, named in the NACK
+	uint slot_nr;
+	uint stamp;			// subframe counter of the last transmission
+	uint nack_stamp;	// subframe counter when the NACK was sent
+	int nack_sent;
+	int retx_req;		// set once the retransmission was requested
+	uint gen;			// incremented whenever the buffer is reused
+} phy_harq_buf_s;
+
+struct phy_harq_s {
+	phy_harq_buf_s buf[HARQ_NUM_BUF];
+	uint max_soft;
+	uint combined;		// statistics
+	pthread_mutex_t mutex;
+};
+
+phy_harq phy_harq_create(uint max_soft)
+{
+	phy_harq h = calloc(sizeof(struct phy_harq_s),1);
+	for (int i=0; i<HARQ_NUM_BUF; i++)
+		h->buf[i].soft = calloc((max_soft+1)/2,1);
+	h->max_soft = max_soft;
+	pthread_mutex_init(&h->mutex, NULL);
+	return h;
+}
+
+void phy_harq_destroy(phy_harq h)
+{
+	pthread_mutex_destroy(&h->mutex);
+	for (int i=0; i<HARQ_NUM_BUF; i++)
+		free(h->buf[i].soft);
+	free(h);
+}
+
+static void phy_harq_quant_buf(uint8_t* dst, const uint8_t* soft, uint num_soft)
+{
+	for (int i=0; i<num_soft; i+=2) {
+		uint8_t hi = i+1 < num_soft ? phy_harq_quant(soft[i+1]) : 0;
+		dst[i/2] = phy_harq_quant(soft[i]) | (hi << 4);
+	}
+}
+
+// Add the stored LLRs to the soft bits
+static void phy_harq_combine(const uint8_t* stored, uint8_t* soft, uint num_soft)
+{
+	for (int i=0; i<num_soft; i++) {
+		uint8_t q = (stored[i/2] >> (4*(i&1))) & 0xf;
+		int v = soft[i] + phy_harq_dequant(q);
+		soft[i] = v < 0 ? 0 : (v > 255 ? 255 : v);
+	}
+}
+
+static void phy_harq_expire(phy_harq h, uint now)
+{
+	for (int i=0; i<HARQ_NUM_BUF; i++)
+		if (h->buf[i].num_soft && now - h->buf[i].stamp > HARQ_MAX_AGE)
+			h->buf[i].num_soft = 0;
+}
+
+// Store a failed slot in an unused buffer or in place of the oldest one
+static phy_harq_result phy_harq_store(phy_harq h, uint mcs, uint8_t* soft, uint num_soft,
+									  uint subframe, uint slot_nr, uint now)
+{
+	if (num_soft > h->max_soft)
+		return HARQ_RX_FAIL;
+
+	pthread_mutex_lock(&h->mutex);
+	phy_harq_expire(h, now);
+	phy_harq_buf_s* b = NULL;
+	for (int i=0; i<HARQ_NUM_BUF; i++) {
+		phy_harq_buf_s* c = &h->buf[i];
+		if (c->num_soft == 0) {
+			b = c;
+			break;
+		}
+		if (b == NULL || now - c->stamp > now - b->stamp)
+			b = c;
+	}
+	phy_harq_quant_buf(b->soft, soft, num_soft);
+	b->num_soft = num_soft;
+	b->mcs = mcs;
+	b->tx_cnt = 1;
+	b->subframe = subframe;
+	b->slot_nr = slot_nr;
+	b->stamp = now;
+	b->nack_sent = 0;
+	b->retx_req = 0;
+	b->gen++;
+	pthread_mutex_unlock(&h->mutex);
+	return HARQ_RX_NACK;
+}
+
+// Get the NACKed slots a retransmission with the given mcs and size can belong to, oldest first.
+// The caller has to hold the lock
+static uint phy_harq_candidates(phy_harq h, uint mcs, uint num_soft, uint now, int* idx)
+{
+	uint n = 0;
+	for (int i=0; i<HARQ_NUM_BUF; i++) {
+		phy_harq_buf_s* b = &h->buf[i];
+		if (b->num_soft != num_soft || b->mcs != mcs || !b->nack_sent)
+			continue;
+		int k = n++;
+		while (k > 0 && now - h->buf[idx[k-1]].stamp < now - b->stamp) {
+			idx[k] = idx[k-1];
+			k--;
+		}
+		idx[k] = i;
+	}
+	return n;
+}
+
+phy_harq_result phy_harq_decode(phy_harq h, phy_fec dec, uint mcs, uint8_t* soft, uint num_soft,
+								LogicalChannel chan, int retx, uint subframe, uint slot_nr, uint now)
+{
+	int idx[HARQ_NUM_BUF];
+	uint gen[HARQ_NUM_BUF];
+
+	phy_fec_decode_soft(dec, chan->payload_len, soft, chan->data);
+	if (lchan_verify_crc(chan)) {
+		if (retx) {
+			// the retransmission got through on its own. It belongs to the oldest NACKed slot
+			pthread_mutex_lock(&h->mutex);
+			if (phy_harq_candidates(h, mcs, num_soft, now, idx))
+				h->buf[idx[0]].num_soft = 0;
+			pthread_mutex_unlock(&h->mutex);
+		}
+		return HARQ_RX_OK;
+	}
+	// slots which are not marked as retransmission are never combined
+	if (!retx)
+		return phy_harq_store(h, mcs, soft, num_soft, subframe, slot_nr, now);
+
+	// copy the LLRs of the candidates, so the lock is not held while decoding
+	uint num_bytes = (num_soft+1)/2;
+	uint8_t* copies = NULL;
+	pthread_mutex_lock(&h->mutex);
+	phy_harq_expire(h, now);
+	uint n = phy_harq_candidates(h, mcs, num_soft, now, idx);
+	if (n > 0) {
+		copies = malloc(n*num_bytes + num_soft);
+		for (int k=0; k<n; k++) {
+			memcpy(copies + k*num_bytes, h->buf[idx[k]].soft, num_bytes);
+			gen[k] = h->buf[idx[k]].gen;
+		}
+	}
+	pthread_mutex_unlock(&h->mutex);
+	// nothing to combine with, e.g. the first transmission was not received
+	if (n == 0)
+		return phy_harq_store(h, mcs, soft, num_soft, subframe, slot_nr, now);
+
+	uint8_t* received = copies + n*num_bytes;
+	memcpy(received, soft, num_soft);
+	for (int k=0; k<n; k++) {
+		if (k > 0)
+			memcpy(soft, received, num_soft);
+		phy_harq_combine(copies + k*num_bytes, soft, num_soft);
+		phy_fec_decode_soft(dec, chan->payload_len, soft, chan->data);
+		if (lchan_verify_crc(chan)) {
+			pthread_mutex_lock(&h->mutex);
+			if (h->buf[idx[k]].gen == gen[k])
+				h->buf[idx[k]].num_soft = 0;
+			h->combined++;
+			pthread_mutex_unlock(&h->mutex);
+			free(copies);
+			return HARQ_RX_COMBINED;
+		}
+	}
+	free(copies);
+
+	// the transmitter sends the oldest NACKed slot first. NACK it again with the position
+	// of this transmission, which is where the transmitter keeps its copy now
+	phy_harq_result res = HARQ_RX_FAIL;
+	pthread_mutex_lock(&h->mutex);
+	phy_harq_buf_s* b = &h->buf[idx[0]];
+	if (b->gen == gen[0] && b->num_soft) {
+		if (++b->tx_cnt >= HARQ_MAX_TX) {
+			b->num_soft = 0;
+		} else {
+			b->subframe = subframe;
+			b->slot_nr = slot_nr;
+			b->stamp = now;
+			b->nack_sent = 0;
+			b->retx_req = 0;
+			res = HARQ_RX_NACK;
+		}
+	}
+	pthread_mutex_unlock(&h->mutex);
+	return res;
+}
+
+int phy_harq_poll_nack(phy_harq h, uint now, uint max_delay, uint* subframe, uint* slot_nr)
+{
+	phy_harq_buf_s* nack = NULL;
+	pthread_mutex_lock(&h->mutex);
+	phy_harq_expire(h, now);
+	for (int i=0; i<HARQ_NUM_BUF; i++) {
+		phy_harq_buf_s* b = &h->buf[i];
+		if (b->num_soft == 0 || b->nack_sent)
+			continue;
+		if (now - b->stamp > max_delay) {
+			b->num_soft = 0;
+			continue;
+		}
+		if (nack == NULL || now - b->stamp > now - nack->stamp)
+			nack = b;
+	}
+	if (nack) {
+		nack->nack_sent = 1;
+		nack->nack_stamp = now;
+		*subframe = nack->subframe;
+		*slot_nr = nack->slot_nr;
+	}
+	pthread_mutex_unlock(&h->mutex);
+	return nack != NULL;
+}
+
+static int phy_harq_is_pending(phy_harq_buf_s* b, uint now, uint min_delay)
+{
+	return b->num_soft && b->nack_sent && !b->retx_req && now - b->nack_stamp >= min_delay;
+}
+
+uint phy_harq_num_pending(phy_harq h, uint now, uint min_delay)
+{
+	uint pending = 0;
+	pthread_mutex_lock(&h->mutex);
+	phy_harq_expire(h, now);
+	for (int i=0; i<HARQ_NUM_BUF; i++)
+		pending += phy_harq_is_pending(&h->buf[i], now, min_delay);
+	pthread_mutex_unlock(&h->mutex);
+	return pending;
+}
+
+int phy_harq_request_retx(phy_harq h, uint now, uint min_delay)
+{
+	phy_harq_buf_s* req = NULL;
+	pthread_mutex_lock(&h->mutex);
+	phy_harq_expire(h, now);
+	for (int i=0; i<HARQ_NUM_BUF; i++) {
+		phy_harq_buf_s* b = &h->buf[i];
+		if (phy_harq_is_pending(b, now, min_delay) && (req == NULL || now - b->stamp > now - req->stamp))
+			req = b;
+	}
+	if (req)
+		req->retx_req = 1;
+	pthread_mutex_unlock(&h->mutex);
+	return req != NULL;
+}
+
+void phy_harq_clear(phy_harq h)
+{
+	pthread_mutex_lock(&h->mutex);
+	for (int i=0; i<HARQ_NUM_BUF; i++)
+		h->buf[i].num_soft = 0;
+	pthread_mutex_unlock(&h->mutex);
+}
+
+uint phy_harq_get_combined(phy_harq h)
+{
+	pthread_mutex_lock(&h->mutex);
+	uint combined = h->combined;
+	pthread_mutex_unlock(&h->mutex);
+	return combined;
+}
@@ -0,0 +1,85 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef PHY_HARQ_H_
+#define PHY_HARQ_H_
+
+#include "phy_common.h"
+#include <pthread.h>
+
+// Soft buffers of one HARQ process with chase combining.
+// If a data slot fails its CRC, its deinterleaved soft bits are stored with 4 bits per soft bit,
+// keyed by the subframe and slot it was received in. Up to HARQ_NUM_BUF slots are stored and every
+// stored slot is NACKed once. The transmitter marks retransmissions in the DL ctrl slot and only
+// marked slots are combined: the LLRs are summed with those of each NACKed slot with the same mcs
+// and size, oldest first, until the CRC passes. The stored soft bits are never overwritten by a
+// combination, so a marked slot with new data can not corrupt them. The buffers are locked,
+// so slots of the same process can be decoded by different threads.
+
+typedef enum {
+	HARQ_RX_OK,			// slot passed the CRC on its own
+	HARQ_RX_COMBINED,	// slot passed the CRC after combining it with a stored transmission
+	HARQ_RX_NACK,		// CRC failed. The slot is stored, a retransmission should be requested
+	HARQ_RX_FAIL		// CRC failed and HARQ_MAX_TX transmissions were combined. The slot is lost
+} phy_harq_result;
+
+typedef struct phy_harq_s* phy_harq;
+
+// Create the soft buffers for slots of up to max_soft soft bits
+phy_harq phy_harq_create(uint max_soft);
+void phy_harq_destroy(phy_harq h);
+
+// Decode the deinterleaved soft bits of a data slot into chan, which has to be created with
+// the TBS of the mcs and CRC16. retx is set if the transmitter marked the slot as retransmission.
+// The soft bits are overwritten if the slot is combined. subframe and slot_nr identify the slot
+// in the NACK. now is a subframe counter used to age out slots
+phy_harq_result phy_harq_decode(phy_harq h, phy_fec dec, uint mcs, uint8_t* soft, uint num_soft,
+								LogicalChannel chan, int retx, uint subframe, uint slot_nr, uint now);
+
+// Returns 1, the subframe and the slot number of the oldest stored slot whose NACK was not sent yet.
+// The NACK is marked as sent. Stored slots that could not be NACKed within max_delay subframes
+// are discarded, since the transmitter reuses the subframe and slot number every frame
+int phy_harq_poll_nack(phy_harq h, uint now, uint max_delay, uint* subframe, uint* slot_nr);
+// Returns the number of stored slots which were NACKed at least min_delay subframes ago
+// and whose retransmission was not requested yet
+uint phy_harq_num_pending(phy_harq h, uint now, uint min_delay);
+// Marks the retransmission of the oldest pending slot (see phy_harq_num_pending) as requested.
+// Returns 0 if no slot is pending
+int phy_harq_request_retx(phy_harq h, uint now, uint min_delay);
+// Discard all stored slots
+void phy_harq_clear(phy_harq h);
+
+// Returns the number of slots which passed the CRC after combining
+uint phy_harq_get_combined(phy_harq h);
+
+// Soft bits are centered at 127. The stored LLR is the offset to 127 in steps of 16,
+// which is close to the 3-4 bit soft decisions the Viterbi decoder needs
+static inline uint8_t phy_harq_quant(uint8_t soft)
+{
+	int q = ((int)soft - 127 + 8) >> 4;
+	q = q < -8 ? -8 : (q > 7 ? 7 : q);
+	return q & 0xf;
+}
+
+// Returns the offset to 127 of a stored LLR
+static inline int phy_harq_dequant(uint8_t q)
+{
+	return ((int)(q ^ 0x8) - 8) * 16;
+}
+
+#endif /* PHY_HARQ_H_ */
@@ -0,0 +1,239 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "phy_slot_queue.h"
+#include "../util/log.h"
+
+struct phy_slot_worker_s {
+	pthread_t thread;
+	phy_rx_ctx ctx;				// decoder objects of this worker
+	struct phy_slot_queue_s* q;
+};
+
+struct phy_slot_queue_s {
+	phy_slot_job_s jobs[PHY_SLOT_QUEUE_LEN];	// job i is used for every seq with seq%PHY_SLOT_QUEUE_LEN==i
+
+	// receive buffer. Only used by the RX thread
+	float complex* rx_buf;		// buffer of SLOT_LEN symbols which is filled by the RX thread
+	re_map rx_map;				// slot which is currently received into rx_buf. NULL if none
+
+	// sequence counters. Jobs in [taken,submitted) wait for a worker,
+	// jobs in [delivered,taken) are decoded or wait for delivery
+	uint64_t submitted;
+	uint64_t taken;
+	uint64_t delivered;
+	uint stalls;				// number of dropped slots
+	time_t last_drop_log;		// time of the last log message about dropped slots. Only used by the RX thread
+	int stop;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t job_avail;		// signaled when a job is submitted
+	pthread_cond_t job_done;		// signaled when a job is delivered
+
+	phy_slot_decode_cb decode;
+	phy_slot_deliver_cb deliver;
+	void* userd;
+
+	struct phy_slot_worker_s* workers;
+	uint num_workers;
+};
+
+static void* phy_slot_queue_worker(void* arg)
+{
+	struct phy_slot_worker_s* w = arg;
+	struct phy_slot_queue_s* q = w->q;
+
+	pthread_mutex_lock(&q->mutex);
+	while (1) {
+		while (q->taken == q->submitted && !q->stop)
+			pthread_cond_wait(&q->job_avail, &q->mutex);
+		// on shutdown, pending jobs are decoded first
+		if (q->taken == q->submitted)
+			break;
+		phy_slot_job job = &q->jobs[q->taken % PHY_SLOT_QUEUE_LEN];
+		q->taken++;
+		pthread_mutex_unlock(&q->mutex);
+
+		q->decode(q->userd, job, w->ctx);
+
+		// deliver in submission order
+		pthread_mutex_lock(&q->mutex);
+		while (q->delivered != job->seq)
+			pthread_cond_wait(&q->job_done, &q->mutex);
+		pthread_mutex_unlock(&q->mutex);
+
+		q->deliver(q->userd, job);
+
+		pthread_mutex_lock(&q->mutex);
+		q->delivered++;
+		pthread_cond_broadcast(&q->job_done);
+	}
+	pthread_mutex_unlock(&q->mutex);
+	return NULL;
+}
+
+phy_slot_queue phy_slot_queue_create(PhyCommon common, uint num_workers, phy_slot_decode_cb decode,
+									 phy_slot_deliver_cb deliver, void* userd)
+{
+	phy_slot_queue q = calloc(sizeof(struct phy_slot_queue_s),1);
+	q->decode = decode;
+	q->deliver = deliver;
+	q->userd = userd;
+	pthread_mutex_init(&q->mutex, NULL);
+	pthread_cond_init(&q->job_avail, NULL);
+	pthread_cond_init(&q->job_done, NULL);
+
+	for (int i=0; i<PHY_SLOT_QUEUE_LEN; i++)
+		q->jobs[i].symbols = malloc(sizeof(float complex)*nfft*SLOT_LEN);
+	q->rx_buf = malloc(sizeof(float complex)*nfft*SLOT_LEN);
+
+	q->workers = calloc(sizeof(struct phy_slot_worker_s),num_workers);
+	for (int i=0; i<num_workers; i++) {
+		q->workers[i].q = q;
+		q->workers[i].ctx = phy_rx_ctx_create(common);
+		if (pthread_create(&q->workers[i].thread, NULL, phy_slot_queue_worker, &q->workers[i]) != 0) {
+			LOG(ERR,"[PHY] could not create slot decoding thread %d!\n",i);
+			phy_rx_ctx_destroy(q->workers[i].ctx);
+			break;
+		}
+		q->num_workers++;
+	}
+	if (q->num_workers == 0) {
+		phy_slot_queue_destroy(q);
+		return NULL;
+	}
+	return q;
+}
+
+void phy_slot_queue_destroy(phy_slot_queue q)
+{
+	pthread_mutex_lock(&q->mutex);
+	q->stop = 1;
+	pthread_cond_broadcast(&q->job_avail);
+	pthread_mutex_unlock(&q->mutex);
+
+	for (int i=0; i<q->num_workers; i++) {
+		pthread_join(q->workers[i].thread, NULL);
+		phy_rx_ctx_destroy(q->workers[i].ctx);
+	}
+	for (int i=0; i<PHY_SLOT_QUEUE_LEN; i++)
+		free(q->jobs[i].symbols);
+	free(q->rx_buf);
+
+	pthread_mutex_destroy(&q->mutex);
+	pthread_cond_destroy(&q->job_avail);
+	pthread_cond_destroy(&q->job_done);
+	free(q->workers);
+	free(q);
+}
+
+// returns the next free job or NULL if PHY_SLOT_QUEUE_LEN jobs are in flight. Never blocks on the workers
+static phy_slot_job phy_slot_queue_next(phy_slot_queue q)
+{
+	phy_slot_job qjob = NULL;
+	pthread_mutex_lock(&q->mutex);
+	if (q->submitted - q->delivered < PHY_SLOT_QUEUE_LEN)
+		qjob = &q->jobs[q->submitted % PHY_SLOT_QUEUE_LEN];
+	else
+		q->stalls++;
+	pthread_mutex_unlock(&q->mutex);
+	return qjob;
+}
+
+// log dropped slots at most once per second
+static void phy_slot_queue_log_drop(phy_slot_queue q)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec != q->last_drop_log) {
+		q->last_drop_log = now.tv_sec;
+		LOG(WARN,"[PHY] slot decoding is too slow, %d slots in flight. %d slots dropped so far\n",
+			PHY_SLOT_QUEUE_LEN, phy_slot_queue_get_stalls(q));
+	}
+}
+
+void phy_slot_queue_rx_symbol(phy_slot_queue q, PhyCommon common, re_map_type type, uint rx_symbol)
+{
+	// release the binding once the receive buffer was handed over or the slot is left
+	re_map map = q->rx_map;
+	if (map && (common->rxdata_f[map->first_symb] != q->rx_buf ||
+				rx_symbol < map->first_symb || rx_symbol >= map->first_symb+map->num_symb)) {
+		phy_rx_slot_unbind(common, map);
+		q->rx_map = NULL;
+	}
+
+	if (q->rx_map == NULL) {
+		for (int i=0; i<NUM_SLOT; i++) {
+			map = phy_get_re_map(common, type, i);
+			if (map->first_symb == rx_symbol) {
+				phy_rx_slot_bind(common, map, q->rx_buf);
+				q->rx_map = map;
+				break;
+			}
+		}
+	}
+}
+
+int phy_slot_queue_push(phy_slot_queue q, phy_slot_job job)
+{
+	phy_slot_job qjob = phy_slot_queue_next(q);
+	if (qjob == NULL) {
+		// the RX thread must not wait for the workers: drop the new slot.
+		// The receive buffer stays with the queue and is reused for the next slot
+		phy_slot_queue_log_drop(q);
+		return 0;
+	}
+
+	// the job is not visible to the workers until submitted is increased
+	float complex* symbols = qjob->symbols;
+	if (job->symbols == q->rx_buf) {
+		// hand over the receive buffer. The buffer of the delivered job is used for the next slot
+		q->rx_buf = symbols;
+		symbols = job->symbols;
+	} else {
+		memcpy(symbols, job->symbols, sizeof(float complex)*nfft*job->num_symb);
+	}
+	*qjob = *job;
+	qjob->symbols = symbols;
+	qjob->chan = NULL;
+
+	pthread_mutex_lock(&q->mutex);
+	qjob->seq = q->submitted;
+	q->submitted++;
+	pthread_cond_signal(&q->job_avail);
+	pthread_mutex_unlock(&q->mutex);
+	return 1;
+}
+
+pthread_t phy_slot_queue_get_thread(phy_slot_queue q, uint i)
+{
+	return q->workers[i].thread;
+}
+
+uint phy_slot_queue_get_num_workers(phy_slot_queue q)
+{
+	return q->num_workers;
+}
+
+uint phy_slot_queue_get_stalls(phy_slot_queue q)
+{
+	pthread_mutex_lock(&q->mutex);
+	uint stalls = q->stalls;
+	pthread_mutex_unlock(&q->mutex);
+	return stalls;
+}
@@ -0,0 +1,95 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef PHY_SLOT_QUEUE_H_
+#define PHY_SLOT_QUEUE_H_
+
+#include "phy_common.h"
+#include "phy_harq.h"
+#include <pthread.h>
+#include <time.h>
+
+// Bounded job queue which distributes received slots to a pool of decoding threads.
+// The RX thread is the only producer. Every job owns a slot sized buffer of frequency domain symbols.
+// The RX thread receives data slots directly into a spare buffer, which is handed over to the
+// workers when the slot is complete. The job returns its previous buffer, so no symbols are copied
+// and decoding can lag behind the receiver by up to PHY_SLOT_QUEUE_LEN slots.
+// Every worker owns its own decoder objects (phy_rx_ctx). Decoded slots are delivered
+// to the upper layer in submission order, one at a time.
+// The producer never waits for the workers: if all jobs are in flight, the new slot is dropped and counted.
+
+#define PHY_SLOT_QUEUE_LEN 16	// max number of jobs in flight
+
+typedef enum {
+	SLOT_JOB_DATA,	// data slot
+	SLOT_JOB_CTRL,	// control slot
+	SLOT_JOB_RACH	// association request
+} phy_slot_job_type;
+
+typedef struct {
+	phy_slot_job_type type;
+	uint subframe;			// subframe in which the slot was received
+	uint slot_nr;
+	uint subframe_cnt;		// subframe counter of the receiver when the slot was received
+	uint userid;
+	uint mcs;
+	int retx;				// set if the data slot is marked as HARQ retransmission in the DL ctrl slot
+	int timing;				// timing offset of a received association request
+	float cfo;				// mean CFO measured on the pilots of the slot. Only valid if has_cfo is set
+	int has_cfo;
+	void* obj;				// object owned by the job, e.g. the sync object of an association request
+	float complex* symbols;	// copy of the received symbols: num_symb*nfft subcarriers
+	uint num_symb;
+	LogicalChannel chan;	// decoded slot. Set by the decode callback
+	phy_harq_result harq;	// HARQ result of a data slot. Set by the decode callback
+	uint64_t seq;			// submission order
+} phy_slot_job_s;
+
+typedef phy_slot_job_s* phy_slot_job;
+
+// called by a worker thread, decodes job->symbols into job->chan
+typedef void (*phy_slot_decode_cb)(void* userd, phy_slot_job job, phy_rx_ctx ctx);
+// passes the result to the upper layer. Calls are serialized and in submission order
+typedef void (*phy_slot_deliver_cb)(void* userd, phy_slot_job job);
+
+typedef struct phy_slot_queue_s* phy_slot_queue;
+
+// Create the queue and start num_workers decoding threads
+phy_slot_queue phy_slot_queue_create(PhyCommon common, uint num_workers, phy_slot_decode_cb decode,
+									 phy_slot_deliver_cb deliver, void* userd);
+// Decode all pending jobs, stop the threads and free the queue
+void phy_slot_queue_destroy(phy_slot_queue q);
+
+// Has to be called by the RX thread before symbol rx_symbol is written to common->rxdata_f.
+// At the first symbol of a slot of the given type, the rxdata_f symbols of the slot are redirected
+// to the receive buffer of the queue. The binding is released once the slot was pushed or left.
+void phy_slot_queue_rx_symbol(phy_slot_queue q, PhyCommon common, re_map_type type, uint rx_symbol);
+
+// Pass a slot to the workers. If job->symbols is the receive buffer, the buffer is handed over
+// to the workers. Otherwise the symbols are copied, so the caller can reuse the buffer as soon as
+// the function returns. Does not block: if PHY_SLOT_QUEUE_LEN jobs are in flight, the slot is dropped.
+// Returns 1 if the job was queued, 0 if it was dropped. Objects of a dropped job stay with the caller
+int phy_slot_queue_push(phy_slot_queue q, phy_slot_job job);
+
+// returns the thread handle of worker i. Used to set affinity and priority
+pthread_t phy_slot_queue_get_thread(phy_slot_queue q, uint i);
+uint phy_slot_queue_get_num_workers(phy_slot_queue q);
+// returns the number of slots that were dropped because all jobs were in flight
+uint phy_slot_queue_get_stalls(phy_slot_queue q);
+
+#endif /* PHY_SLOT_QUEUE_H_ */
@@ -22,6 +22,7 @@
 #include "../mac/mac_ue.h"
 #include <pthread.h>
 #include "../platform/pluto.h"
+#include "../platform/pluto_iq.h"
 
 #ifdef PHY_TEST_BER
 #include "../runtime/test.h"
@@ -32,6 +33,9 @@ extern struct phy_config_s PHY_CONFIG;
 
 // Declarations of local functions
 int _ue_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd);
+static void phy_ue_rx_symbol_done(PhyUE phy);
+static void phy_ue_decode_job(void* userd, phy_slot_job job, phy_rx_ctx ctx);
+static void phy_ue_deliver_job(void* userd, phy_slot_job job);
 
 // Init the PhyUE struct
 PhyUE phy_ue_init()
@@ -76,14 +80,24 @@ PhyUE phy_ue_init()
 
 	phy->rx_offset = 0;
 
+#ifdef UE_RX_SKIP_UNASSIGNED
+	phy->rx_skip_enabled = 1;
+#endif
+	phy->rx_conv_len = (nfft+cp_len)*UE_RX_MAX_RUN;
+	phy->rx_conv_buf = malloc(sizeof(float complex)*phy->rx_conv_len);
+
 	phy->rachuserid = -1;
 	phy->rach_try_cnt = 0;
+	phy->rach_chan = lchan_create(get_ulctrl_slot_size(phy->common)/8, CRC8);
+	phy->rach_symbol = malloc(sizeof(float complex)*(nfft+cp_len));
+	phy->rach_symbol_try_cnt = -1;
 	phy->userid = -1;
 
-	// receiving a slot (demod, fec decode, interleaver) will be handled in a
-	// separate thread
-	phy->rx_slot_signal = NULL;
-	phy->rx_slot_nr = 0;
+	// receiving a slot (demod, fec decode, interleaver) will be handled by
+	// separate threads, once phy_ue_start_slot_workers() was called
+	phy->slot_queue = NULL;
+
+	phy->dl_harq = phy_harq_create(phy->common->rx_ctx->buf_len);
 
 	phy->bs_txgain = -128;
 	phy->bs_rxgain = -128;
@@ -93,6 +107,10 @@ PhyUE phy_ue_init()
 
 void phy_ue_destroy(PhyUE phy)
 {
+	// decode pending slots before the PHY objects are freed
+	if (phy->slot_queue)
+		phy_slot_queue_destroy(phy->slot_queue);
+
 	phy_common_destroy(phy->common);
 	ofdmframegen_destroy(phy->fg);
 	ofdmframesync_destroy(phy->fs);
@@ -108,6 +126,11 @@ void phy_ue_destroy(PhyUE phy)
 	free(phy->ulctrl_assignments);
 	free(phy->ul_symbol_alloc);
 
+	lchan_destroy(phy->rach_chan);
+	free(phy->rach_symbol);
+	free(phy->rx_conv_buf);
+	phy_harq_destroy(phy->dl_harq);
+
 	free(phy);
 }
 
@@ -136,10 +159,20 @@ int phy_ue_set_mcs_dl(PhyUE phy, uint mcs)
 	return 0;
 }
 
-// Set the condition which is used to signal the slot processing thread
-void phy_ue_set_rx_slot_th_signal(PhyUE phy, pthread_cond_t* cond)
+// Returns 1 and the position of the failed DL slot if a DL NACK has to be sent.
+// The NACK is dropped if it could not be sent within HARQ_NACK_MAX_DELAY subframes,
+// since the BS reuses the subframe and slot number every frame
+int phy_ue_get_dl_harq_nack(PhyUE phy, uint* subframe, uint* slot_nr)
+{
+	return phy_harq_poll_nack(phy->dl_harq, phy->rx_subframe_cnt, HARQ_NACK_MAX_DELAY, subframe, slot_nr);
+}
+
+// Start num_workers slot decoding threads
+// returns 1 on success, 0 if slots are still decoded in the RX thread
+int phy_ue_start_slot_workers(PhyUE phy, uint num_workers)
 {
-	phy->rx_slot_signal = cond;
+	phy->slot_queue = phy_slot_queue_create(phy->common, num_workers, phy_ue_decode_job, phy_ue_deliver_job, phy);
+	return phy->slot_queue != NULL;
 }
 
 // Searches for the initial sync sequence
@@ -152,6 +185,9 @@ int phy_ue_initial_sync(PhyUE phy, float complex* rxbuf_time, uint num_samples)
 	if (offset!=-1) {
 		common->rx_symbol = SUBFRAME_LEN - 1 - 1; //there is the sync info symbol and one guard symbol remaining in the subframe
 		common->rx_subframe = 0;
+		// the receiver starts at a symbol boundary and its NCO matches the signal again
+		phy->rx_run_samps = 0;
+		phy->rx_skip_phase = 0;
 
 		//apply filtering of coarse CFO estimation if we have old estimates
 		if (phy->has_synced_once == 0) {
@@ -184,18 +220,18 @@ int phy_ue_initial_sync(PhyUE phy, float complex* rxbuf_time, uint num_samples)
 int phy_ue_proc_dlctrl(PhyUE phy)
 {
     PhyCommon common = phy->common;
-	uint dlctrl_size = (NUM_SLOT*2 + NUM_ULCTRL_SLOT)/2;
+	uint dlctrl_size = DLCTRL_PAYLOAD_LEN;
 	uint sfn = common->rx_subframe % 2; // even or uneven subframe?
 
 	// demodulate signal.
 	uint llr_len = 2*DLCTRL_LEN*(num_data_sc+num_pilot_sc);
 	uint8_t* llr_buf = malloc(llr_len);
 	uint total_samps = 0;
-	phy_demod_soft(common, 0, nfft-1, 0, DLCTRL_LEN-1, 0, llr_buf, llr_len, &total_samps);
+	phy_demod_soft(common, phy_get_re_map(common, RE_MAP_DLCTRL, 0), 0, llr_buf, llr_len, &total_samps);
 
 	// soft decoding
 	dlctrl_alloc_t* dlctrl_buf = malloc(dlctrl_size+1);
-	fec_decode_soft(common->fec_ctrl,dlctrl_size+1, llr_buf, (uint8_t*)dlctrl_buf);
+	phy_fec_decode_soft(common->rx_ctx->fec_ctrl,dlctrl_size+1, llr_buf, (uint8_t*)dlctrl_buf);
 
 	//unscrambling
 	unscramble_data((uint8_t*)dlctrl_buf,dlctrl_size+1);
@@ -233,10 +269,14 @@ int phy_ue_proc_dlctrl(PhyUE phy)
 		idx++;
 	}
 
-	// Pass slot assignment to MAC
+	// HARQ retransmission flags: UL data slots in the high, DL data slots in the low nibble
+	phy->dlslot_retx[sfn] = dlctrl_buf[DLCTRL_HARQ_IDX].l4;
+
+	// Pass slot assignment and the requested UL retransmissions to MAC
 	mac_ue_set_assignments(phy->mac,phy->dlslot_assignments[sfn],
 									phy->ulslot_assignments[sfn],
 									phy->ulctrl_assignments[sfn]);
+	mac_ue_set_ul_retx(phy->mac, common->rx_subframe, dlctrl_buf[DLCTRL_HARQ_IDX].h4);
 
 	free(llr_buf);
 	free(dlctrl_buf);
@@ -247,68 +287,99 @@ TIMECHECK_CREATE(timecheck_ue_rx);
 TIMECHECK_CREATE(check_demod);
 TIMECHECK_CREATE(check_fec);
 TIMECHECK_CREATE(check_interl);
-// Decode a PHY dl slot and call the MAC callback function
-void phy_ue_proc_slot(PhyUE phy, uint slotnr)
+// Decode a received dl slot. Called by a slot worker thread or by the RX thread
+static void phy_ue_decode_job(void* userd, phy_slot_job job, phy_rx_ctx ctx)
 {
     TIMECHECK_INIT(check_demod,"ue.rx_slot.demod",10000);
     TIMECHECK_INIT(check_fec,"ue.rx_slot.fec",10000);
     TIMECHECK_INIT(check_interl,"ue.rx_slot.interleaver",10000);
     TIMECHECK_INIT(timecheck_ue_rx,"ue.rx_slot",10000);
 
+	PhyUE phy = (PhyUE)userd;
 	PhyCommon common = phy->common;
-	assignment_t slot_type = phy->dlslot_assignments[common->rx_subframe%2][slotnr];
-	if (slot_type != NOT_ASSIGNED) {
-        TIMECHECK_START(timecheck_ue_rx);
-
-        // MCS0 is used for Broadcast. For UE specific traffic use the set mcs
-		uint mcs = (slot_type == UE_ASSIGNED) ? phy->mcs_dl : 0;
-		uint32_t blocksize = get_tbs_size(common, mcs);
-
-		uint buf_len = 8*fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],blocksize/8);
-		uint8_t* demod_buf = malloc(buf_len);
-
-		// demodulate signal
-		uint written_samps = 0;
-		uint first_symb = DLCTRL_LEN+2+(SLOT_LEN+1)*slotnr;
-		uint last_symb = DLCTRL_LEN+2+(SLOT_LEN+1)*(slotnr+1)-2;
-		TIMECHECK_START(check_demod);
-		phy_demod_soft(common, 0, nfft-1, first_symb, last_symb, mcs,
-					   demod_buf, buf_len, &written_samps);
-        TIMECHECK_STOP(check_demod);
-		//deinterleaving
-		uint8_t* deinterleaved_b = malloc(buf_len);
-        TIMECHECK_START(check_interl);
-		interleaver_decode_soft(common->mcs_interlvr[mcs],demod_buf,deinterleaved_b);
-        TIMECHECK_STOP(check_interl);
-        TIMECHECK_START(check_fec);
-		// decoding
-		LogicalChannel chan = lchan_create(blocksize/8,CRC16);
-		fec_decode_soft(common->mcs_fec[mcs], blocksize/8, deinterleaved_b, chan->data);
-        TIMECHECK_STOP(check_fec);
+	uint mcs = job->mcs;
+    TIMECHECK_START(timecheck_ue_rx);
+
+	uint32_t blocksize = get_tbs_size(common, mcs);
+	uint buf_len = 8*fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],blocksize/8);
+
+	// demodulate signal
+	uint written_samps = 0;
+	TIMECHECK_START(check_demod);
+	phy_demod_soft_buf(common, phy_get_re_map(common, RE_MAP_DLSLOT, job->slot_nr), job->symbols, mcs,
+					   ctx->demod_buf, buf_len, &written_samps);
+    TIMECHECK_STOP(check_demod);
+	//deinterleaving
+    TIMECHECK_START(check_interl);
+	interleaver_decode_soft(ctx->mcs_interlvr[mcs],ctx->demod_buf,ctx->deinterleaved_buf);
+    TIMECHECK_STOP(check_interl);
+    TIMECHECK_START(check_fec);
+	// decoding. Slots for this user which fail the CRC are stored and combined with their retransmission
+	// Broadcast slots are not acknowledged
+	job->chan = lchan_create(blocksize/8,CRC16);
+	if (job->userid == USER_BROADCAST)
+		phy_fec_decode_soft(ctx->mcs_dec[mcs], blocksize/8, ctx->deinterleaved_buf, job->chan->data);
+	else
+		job->harq = phy_harq_decode(phy->dl_harq, ctx->mcs_dec[mcs], mcs, ctx->deinterleaved_buf, buf_len,
+									job->chan, job->retx, job->subframe, job->slot_nr, job->subframe_cnt);
+    TIMECHECK_STOP(check_fec);
+
+    TIMECHECK_STOP_CHECK(timecheck_ue_rx,3500);
+    TIMECHECK_INFO(timecheck_ue_rx);
+    TIMECHECK_INFO(check_demod);
+    TIMECHECK_INFO(check_fec);
+    TIMECHECK_INFO(check_interl);
+}
+
+// Pass a decoded dl slot to the MAC layer. Calls are serialized
+static void phy_ue_deliver_job(void* userd, phy_slot_job job)
+{
+	PhyUE phy = (PhyUE)userd;
+	LogicalChannel chan = job->chan;
 
 #ifdef PHY_TEST_BER
-	uint32_t num_biterr = 0;
 	// we start calculating ber after subframe 50 to wait that MCS switch happened
 	if (global_sfn>50) {
 		for (int i=0; i<chan->payload_len;i++)
-			num_biterr += liquid_count_ones(phy_dl[common->rx_subframe%2][slotnr][i]^chan->data[i]);
+			phy_dl_biterr += liquid_count_ones(phy_dl[job->subframe%2][job->slot_nr][i]^chan->data[i]);
 		phy_dl_tot_bits += chan->payload_len*8;
-		phy_dl_biterr += num_biterr;
 	}
 #endif
 
-		// pass to upper layer
-        phy->mac_rx_cb(phy->mac, chan, (slot_type==BRCST_ASSIGNED) ? 1:0);
+	// pass to upper layer
+	phy->mac_rx_cb(phy->mac, chan, (job->userid==USER_BROADCAST) ? 1:0);
+}
 
-		free(deinterleaved_b);
-		free(demod_buf);
+// Decode a PHY dl slot and call the MAC callback function
+// The slot is decoded by the worker threads if they are running, otherwise in the calling thread
+void phy_ue_proc_slot(PhyUE phy, uint slotnr)
+{
+	PhyCommon common = phy->common;
+	assignment_t slot_type = phy->dlslot_assignments[common->rx_subframe%2][slotnr];
+	if (slot_type == NOT_ASSIGNED)
+		return;
+
+	re_map map = phy_get_re_map(common, RE_MAP_DLSLOT, slotnr);
+	phy_slot_job_s job = {0};
+	job.type = SLOT_JOB_DATA;
+	job.subframe = common->rx_subframe;
+	job.subframe_cnt = phy->rx_subframe_cnt;
+	job.slot_nr = slotnr;
+	job.userid = (slot_type == BRCST_ASSIGNED) ? USER_BROADCAST : phy->userid;
+	// MCS0 is used for Broadcast. For UE specific traffic use the set mcs
+	job.mcs = (slot_type == UE_ASSIGNED) ? phy->mcs_dl : 0;
+	job.retx = (phy->dlslot_retx[common->rx_subframe%2] >> slotnr) & 1;
+	job.symbols = common->rxdata_f[map->first_symb];
+	job.num_symb = map->num_symb;
 
-        TIMECHECK_STOP_CHECK(timecheck_ue_rx,3500);
-        TIMECHECK_INFO(timecheck_ue_rx);
-        TIMECHECK_INFO(check_demod);
-        TIMECHECK_INFO(check_fec);
-        TIMECHECK_INFO(check_interl);
+#ifdef USE_RX_SLOT_THREAD
+	if (phy->slot_queue) {
+		phy_slot_queue_push(phy->slot_queue, &job);
+		return;
 	}
+#endif
+	phy_ue_decode_job(phy, &job, common->rx_ctx);
+	phy_ue_deliver_job(phy, &job);
 }
 
 // Process the synchronization information
@@ -323,17 +394,11 @@ int phy_ue_proc_sync_info(PhyUE phy)
     uint8_t* demod_buf = malloc(buf_len);
 
     // demodulate signal
-    const int symb_idx = SUBFRAME_LEN -2;
-    uint written_samps = 0, symbol = 0;
-    for (int i=0; i<nfft; i++) {
-        if (common->pilot_sc[i] == OFDMFRAME_SCTYPE_DATA && written_samps<buf_len) {
-            modem_demodulate_soft(common->mcs_modem[mcs], common->rxdata_f[symb_idx][i], &symbol, &demod_buf[written_samps]);
-            written_samps += modem_get_bps(common->mcs_modem[mcs]);
-        }
-    }
+    uint written_samps = 0;
+    phy_demod_soft(common, phy_get_re_map(common, RE_MAP_SYNCINFO, 0), mcs, demod_buf, buf_len, &written_samps);
     // decoding
     LogicalChannel chan = lchan_create(blocksize/8,CRC8);
-    fec_decode_soft(common->fec_ctrl, blocksize/8, demod_buf, chan->data);
+    phy_fec_decode_soft(common->rx_ctx->fec_ctrl, blocksize/8, demod_buf, chan->data);
 
     // unscrambling
     unscramble_data((uint8_t*)chan->data,chan->payload_len);
@@ -358,7 +423,22 @@ int _ue_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd)
 	PhyUE phy = (PhyUE)userd;
 	PhyCommon common = phy->common;
 
+#ifdef USE_RX_SLOT_THREAD
+	// receive data slots directly into the buffer which is passed to the slot decoder
+	if (phy->slot_queue)
+		phy_slot_queue_rx_symbol(phy->slot_queue, common, RE_MAP_DLSLOT, common->rx_symbol);
+#endif
 	memcpy(common->rxdata_f[common->rx_symbol++],X,sizeof(float complex)*nfft);
+	phy->rx_symb_cnt++;
+
+	phy_ue_rx_symbol_done(phy);
+	return 0;
+}
+
+// Process the slots that are complete after the symbol common->rx_symbol-1 was received or skipped
+static void phy_ue_rx_symbol_done(PhyUE phy)
+{
+	PhyCommon common = phy->common;
 
 	switch (common->rx_symbol) {
 	case DLCTRL_LEN:
@@ -367,33 +447,15 @@ int _ue_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd)
 		break;
 	case DLCTRL_LEN+1+(SLOT_LEN+1):
 		// finished receiving one of the dl data slots
-#ifdef USE_RX_SLOT_THREAD
-		phy->rx_slot_nr = 0;
-        if (phy->rx_slot_signal)
-            pthread_cond_signal(phy->rx_slot_signal);
-        else
-#endif
-            phy_ue_proc_slot(phy,0);
+		phy_ue_proc_slot(phy,0);
 		break;
 	case DLCTRL_LEN+1+(SLOT_LEN+1)*2:
 		// finished receiving one of the dl data slots
-#ifdef USE_RX_SLOT_THREAD
-		phy->rx_slot_nr = 1;
-        if (phy->rx_slot_signal)
-            pthread_cond_signal(phy->rx_slot_signal);
-        else
-#endif
-            phy_ue_proc_slot(phy,1);
+		phy_ue_proc_slot(phy,1);
 		break;
 	case DLCTRL_LEN+1+(SLOT_LEN+1)*3:
 		// finished receiving one of the dl data slots
-#ifdef USE_RX_SLOT_THREAD
-		phy->rx_slot_nr = 2;
-        if (phy->rx_slot_signal)
-            pthread_cond_signal(phy->rx_slot_signal);
-        else
-#endif
-            phy_ue_proc_slot(phy,2);
+		phy_ue_proc_slot(phy,2);
 		break;
 	case DLCTRL_LEN+1+(SLOT_LEN+1)*4:
 		// finished receiving one of the dl data slots
@@ -401,13 +463,7 @@ int _ue_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd)
 		if (common->rx_subframe==0) {
             phy_ue_proc_sync_info(phy);
 		} else {
-#ifdef USE_RX_SLOT_THREAD
-            phy->rx_slot_nr = 3;
-            if (phy->rx_slot_signal)
-                pthread_cond_signal(phy->rx_slot_signal);
-            else
-#endif
-                phy_ue_proc_slot(phy, 3);
+            phy_ue_proc_slot(phy,3);
         }
 		break;
 	default:
@@ -439,17 +495,88 @@ int _ue_rx_symbol_cb(float complex* X,unsigned char* p, uint M, void* userd)
 	if (common->rx_symbol >= SUBFRAME_LEN) {
 		common->rx_symbol = 0;
 		common->rx_subframe = (common->rx_subframe + 1) % FRAME_LEN;
+		phy->rx_subframe_cnt++;
 	}
+}
 
-	return 0;
+// returns how the OFDM receiver handles symbol symb of the current subframe.
+// Symbols are skipped if they contain no pilots and are not part of the DL ctrl slot,
+// the sync info or a DL slot that is assigned to this UE or to broadcast
+static phy_ue_rx_mode phy_ue_get_rx_mode(PhyUE phy, uint symb)
+{
+	PhyCommon common = phy->common;
+
+	if (common->pilot_symbols_rx[symb] == PILOT || (common->rx_subframe==0 && symb==SUBFRAME_LEN-2))
+		return UE_RX_PILOT;
+	if (!phy->rx_skip_enabled || symb < DLCTRL_LEN ||
+			(common->rx_subframe==0 && symb >= SUBFRAME_LEN-SYNC_SYMBOLS))
+		return UE_RX_NOPILOT;
+	for (int i=0; i<NUM_SLOT; i++) {
+		re_map map = phy_get_re_map(common, RE_MAP_DLSLOT, i);
+		if (symb >= map->first_symb && symb < map->first_symb+map->num_symb)
+			return phy->dlslot_assignments[common->rx_subframe%2][i] == NOT_ASSIGNED ? UE_RX_SKIP : UE_RX_NOPILOT;
+	}
+	// guard symbol
+	return UE_RX_SKIP;
+}
+
+// returns 1 if a slot has to be processed once the symbol before rx_symbol was received
+static int phy_ue_slot_complete(uint rx_symbol)
+{
+	if (rx_symbol == DLCTRL_LEN || rx_symbol >= SUBFRAME_LEN)
+		return 1;
+	return rx_symbol > DLCTRL_LEN+1 && (rx_symbol-DLCTRL_LEN-1)%(SLOT_LEN+1) == 0;
 }
 
-// Create the symbol containing association request data
+// Determine the next run of symbols, starting at common->rx_symbol. A run is passed to the
+// OFDM receiver in one call: all symbols use the same receive mode and only the last one may complete a slot
+static void phy_ue_next_rx_run(PhyUE phy)
+{
+	uint symb = phy->common->rx_symbol;
+	phy->rx_run_mode = phy_ue_get_rx_mode(phy, symb);
+	phy->rx_run_len = 1;
+	while (phy->rx_run_len < UE_RX_MAX_RUN && !phy_ue_slot_complete(symb+phy->rx_run_len) &&
+		   phy_ue_get_rx_mode(phy, symb+phy->rx_run_len) == phy->rx_run_mode)
+		phy->rx_run_len++;
+}
+
+// Returns num_samples received samples as float complex. The samples are either given as float complex (cf)
+// or as interleaved int16 I/Q (cs), which is converted with the given scale.
+// If derotate is set, the phase the NCO of the OFDM receiver lags behind due to skipped symbols is compensated
+static float complex* phy_ue_rx_input(PhyUE phy, const float complex* cf, const int16_t* cs, float scale,
+									  uint num_samples, int derotate)
+{
+	int rotate = derotate && phy->rx_skip_phase != 0;
+	if (cs == NULL && !rotate)
+		return (float complex*)cf;
+
+	if (phy->rx_conv_len < num_samples) {
+		// only required to search the sync sequence in a large buffer
+		free(phy->rx_conv_buf);
+		phy->rx_conv_len = num_samples;
+		phy->rx_conv_buf = malloc(sizeof(float complex)*phy->rx_conv_len);
+	}
+	float complex* buf = phy->rx_conv_buf;
+	if (cs != NULL) {
+		pluto_iq_to_float(cs, buf, num_samples, scale);
+		cf = buf;
+	}
+	if (rotate) {
+		float complex rot = cexpf(-_Complex_I*phy->rx_skip_phase);
+		for (int i=0; i<num_samples; i++)
+			buf[i] = cf[i]*rot;
+	}
+	return buf;
+}
+
+// Create the time domain symbol of the next association request in phy->rach_symbol.
+// Is called ahead of time, so that the RA slot only has to copy the symbol
 // TODO implement backoff algorithm. If two users try to assoc at the same time
 //      they currently interfere with each other in every RA slot
-void phy_ue_create_assoc_request(PhyUE phy, float complex* txbuf_time)
+void phy_ue_prepare_assoc_request(PhyUE phy)
 {
 	PhyCommon common = phy->common;
+	phy_tx_scratch_s* scratch = &common->tx_scratch_symb;
 
 	uint8_t* repacked_b;
 	uint bytes_written=0;
@@ -459,41 +586,51 @@ void phy_ue_create_assoc_request(PhyUE phy, float complex* txbuf_time)
 	uint32_t blocksize = get_ulctrl_slot_size(phy->common);
 
 	// TODO generate a defined struct for Association Request message
-	LogicalChannel chan = lchan_create(blocksize/8, CRC8);
-	if (phy->rach_try_cnt == 0) {
+	// reuse the preallocated channel object
+	LogicalChannel chan = phy->rach_chan;
+	memset(chan->data, 0, chan->payload_len);
+	chan->writepos = 0;
+	int try_cnt = phy->rach_try_cnt;
+	if (try_cnt == 0) {
 		// RA procedure hasnt started. Select a random ID first
 		phy->rachuserid = rand() % MAX_USER;
 	}
 	chan->data[0] = (uint8_t)phy->rachuserid;
-	chan->data[1] = (uint8_t)phy->rach_try_cnt++;
+	chan->data[1] = (uint8_t)try_cnt;
 	chan->writepos = 2;
 	lchan_calc_crc(chan);
 
 	// encode channel
 	uint enc_len = fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],blocksize/8);
-	uint8_t* enc_b = malloc(enc_len);
+	uint8_t* enc_b = scratch->enc;
 	fec_encode(common->mcs_fec[mcs], blocksize/8, chan->data, enc_b);
 
 	// repack bytes so that each array entry can be mapped to one symbol
 	int num_repacked = enc_len*8/modem_get_bps(common->mcs_modem[mcs]);
-	repacked_b = malloc(num_repacked);
+	repacked_b = scratch->repacked;
 	liquid_repack_bytes(enc_b,8,enc_len,repacked_b,modem_get_bps(common->mcs_modem[mcs]),num_repacked,&bytes_written);
 
 
 	// modulate signal
 	uint written_samps = 0;
 	float complex subcarriers[nfft];
-	for (int i=0; i<nfft; i++) {
-		if (common->pilot_sc[i] == OFDMFRAME_SCTYPE_DATA && written_samps<num_repacked) {
-			modem_modulate(common->mcs_modem[mcs],(uint)repacked_b[written_samps++], &subcarriers[i]);
-		}
-	}
-	// write symbol in time domain buffer
-	ofdmframegen_writesymbol(phy->fg,subcarriers,txbuf_time);
+	phy_mod_buf(common, phy_get_re_map(common, RE_MAP_RACH, 0), subcarriers, mcs, repacked_b, num_repacked,
+				&written_samps);
+	// write symbol in time domain buffer. In the RA slot, the request directly follows
+	// the sync sequence, i.e. it is the first symbol after a reset of the frame generator
+	ofdmframegen_reset(phy->fg);
+	ofdmframegen_writesymbol(phy->fg,subcarriers,phy->rach_symbol);
+	phy->rach_symbol_try_cnt = try_cnt;
+}
 
-	lchan_destroy(chan);
-	free(enc_b);
-	free(repacked_b);
+// Write the symbol containing association request data
+void phy_ue_create_assoc_request(PhyUE phy, float complex* txbuf_time)
+{
+	// the MAC resets the try counter, so check if the prepared symbol is still valid
+	if (phy->rach_symbol_try_cnt != phy->rach_try_cnt)
+		phy_ue_prepare_assoc_request(phy);
+	memcpy(txbuf_time, phy->rach_symbol, sizeof(float complex)*(nfft+cp_len));
+	phy->rach_try_cnt++;
 }
 
 // reset the ofdm symbol allocation
@@ -531,6 +668,8 @@ void phy_ue_write_symbol(PhyUE phy, float complex* txbuf_time)
 				phy_ue_create_assoc_request(phy, txbuf_time);
             } else if (common->tx_subframe == 0 && tx_symb == SUBFRAME_LEN-SLOT_LEN+4) {
                 phy->platform->ptt_set_rx(phy->platform);
+                // prepare the request for the next RA slot
+                phy_ue_prepare_assoc_request(phy);
             } else {
 				// send zeros
 				memset(txbuf_time, 0, sizeof(float complex)*(nfft+cp_len));
@@ -563,9 +702,8 @@ void phy_ue_write_symbol(PhyUE phy, float complex* txbuf_time)
 	}
 }
 
-// Main PHY receive function
-//receive an arbitrary number of samples and process slots once they are received
-void phy_ue_do_rx(PhyUE phy, float complex* rxbuf_time, uint num_samples)
+// Receive samples in either format, see phy_ue_rx_input()
+static void phy_ue_rx(PhyUE phy, const float complex* cf, const int16_t* cs, float scale, uint num_samples)
 {
 	uint remaining_samps = num_samples;
 	PhyCommon common = phy->common;
@@ -573,34 +711,90 @@ void phy_ue_do_rx(PhyUE phy, float complex* rxbuf_time, uint num_samples)
 	while (remaining_samps > 0) {
 		// find sync sequence
 		if (!ofdmframesync_is_synced(phy->fs)) {
-			int offset = phy_ue_initial_sync(phy,rxbuf_time,remaining_samps);
+			float complex* rx = phy_ue_rx_input(phy, cf, cs, scale, remaining_samps, 0);
+			int offset = phy_ue_initial_sync(phy,rx,remaining_samps);
 			if (offset!=-1) {
 				remaining_samps -= offset;
-				rxbuf_time += offset;
+				cf = cf ? cf+offset : NULL;
+				cs = cs ? cs+2*offset : NULL;
 				phy->rx_offset =  num_samples - remaining_samps;
 			} else {
 				remaining_samps = 0;
 			}
 		} else {
-			// receive symbols
-			uint rx_sym = fmin(nfft+cp_len,remaining_samps);
-			if (common->pilot_symbols_rx[common->rx_symbol] == PILOT ||
-                    (common->rx_subframe==0 && common->rx_symbol==SUBFRAME_LEN-2)) {
-				ofdmframesync_execute(phy->fs,rxbuf_time,rx_sym);
-				LOG(TRACE,"[PHY UE] cfo updated: %.3f Hz\n",ofdmframesync_get_cfo(phy->fs)*samplerate/6.28);
+			// receive a block of symbols. The sync sequence ends at a symbol boundary, so the input
+			// is cut into runs of whole symbols which are received the same way
+			uint symb_len = nfft+cp_len;
+			if (phy->rx_run_samps == 0)
+				phy_ue_next_rx_run(phy);
+			uint run_samps = phy->rx_run_len*symb_len;
+			uint rx_sym = fmin(run_samps-phy->rx_run_samps,remaining_samps);
+			uint symb_done = (phy->rx_run_samps+rx_sym)/symb_len - phy->rx_run_samps/symb_len;
+			phy->rx_run_samps += rx_sym;
+
+			if (phy->rx_run_mode == UE_RX_SKIP) {
+				// only count the symbols. The NCO of the receiver does not advance
+				for (int i=0; i<symb_done; i++) {
+					phy->rx_skip_phase = fmodf(phy->rx_skip_phase + ofdmframesync_get_cfo(phy->fs)*symb_len,
+											   2*M_PI);
+					phy->rx_symbols_skipped++;
+					common->rx_symbol++;
+					phy_ue_rx_symbol_done(phy);
+				}
 			} else {
-				ofdmframesync_execute_nopilot(phy->fs,rxbuf_time,rx_sym);
+				uint symb_cnt = phy->rx_symb_cnt;
+				float complex* rx = phy_ue_rx_input(phy, cf, cs, scale, rx_sym, 1);
+				if (phy->rx_run_mode == UE_RX_PILOT) {
+					ofdmframesync_execute(phy->fs,rx,rx_sym);
+					LOG(TRACE,"[PHY UE] cfo updated: %.3f Hz\n",ofdmframesync_get_cfo(phy->fs)*samplerate/6.28);
+				} else {
+					ofdmframesync_execute_nopilot(phy->fs,rx,rx_sym);
+				}
+				// the receiver has to complete its symbols exactly at our symbol boundaries.
+				// Otherwise skipping would break the symbol timing
+				if (phy->rx_skip_enabled && phy->rx_symb_cnt-symb_cnt != symb_done) {
+					LOG(WARN,"[PHY UE] OFDM receiver is not aligned to the symbol boundaries. Disable symbol skipping\n");
+					phy->rx_skip_enabled = 0;
+				}
 			}
+			if (phy->rx_run_samps == run_samps)
+				phy->rx_run_samps = 0;
 			remaining_samps -= rx_sym;
-			rxbuf_time += rx_sym;
+			cf = cf ? cf+rx_sym : NULL;
+			cs = cs ? cs+2*rx_sym : NULL;
 		}
 	}
 }
 
+// Main PHY receive function
+// receive an arbitrary number of samples, e.g. a whole platform buffer, and process slots once they are received.
+// Consecutive symbols that are received the same way are passed to the OFDM receiver in one call
+void phy_ue_do_rx(PhyUE phy, float complex* rxbuf_time, uint num_samples)
+{
+	phy_ue_rx(phy, rxbuf_time, NULL, 1.0f, num_samples);
+}
+
+// Receive interleaved int16 I/Q samples. Only the symbols that are passed to the OFDM receiver
+// are converted to float
+void phy_ue_do_rx_cs16(PhyUE phy, const int16_t* iq, uint num_samples, float scale)
+{
+	phy_ue_rx(phy, NULL, iq, scale, num_samples);
+}
+
+// Receive the samples of a platform rx view
+void phy_ue_do_rx_view(PhyUE phy, const platform_rx_view_s* view)
+{
+	if (view->fmt == PLATFORM_FMT_CS16)
+		phy_ue_do_rx_cs16(phy, view->samples, view->num_samples, view->scale);
+	else
+		phy_ue_do_rx(phy, (float complex*)view->samples, view->num_samples);
+}
+
 // create phy ctrl slot
 int phy_map_ulctrl(PhyUE phy, LogicalChannel chan, uint subframe, uint8_t slot_nr)
 {
 	PhyCommon common = phy->common;
+	phy_tx_scratch_s* scratch = &common->tx_scratch;
 
 	uint8_t* repacked_b;
 	uint bytes_written=0;
@@ -616,20 +810,21 @@ int phy_map_ulctrl(PhyUE phy, LogicalChannel chan, uint subframe, uint8_t slot_n
 
 	// encode channel
 	uint enc_len = fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],chan->payload_len);
-	uint8_t* enc_b = malloc(enc_len);
+	uint8_t* enc_b = scratch->enc;
 	fec_encode(common->mcs_fec[mcs], blocksize/8, chan->data, enc_b);
 
 	// repack bytes so that each array entry can be mapped to one symbol
 	int num_repacked = enc_len*8/modem_get_bps(common->mcs_modem[mcs]);
-	repacked_b = malloc(num_repacked);
+	repacked_b = scratch->repacked;
 	liquid_repack_bytes(enc_b,8,enc_len,repacked_b,modem_get_bps(common->mcs_modem[mcs]),num_repacked,&bytes_written);
 
 	uint total_samps = 0;
-	uint first_symb = 2*(SLOT_LEN+1) + 2*slot_nr;	// slot 0 is mapped to symbol 30, slot 1 is mapped to symb 32.
+	re_map map = phy_get_re_map(common, RE_MAP_ULCTRL, slot_nr);
+	uint first_symb = map->first_symb;	// slot 0 is mapped to symbol 30, slot 1 is mapped to symb 32.
 
 	// modulate signal
 	uint sfn = subframe % 2;
-	phy_mod(phy->common,sfn,0,nfft-1,first_symb,first_symb, mcs, repacked_b, num_repacked, &total_samps);
+	phy_mod(phy->common,sfn, map, mcs, repacked_b, num_repacked, &total_samps);
 
 	// activate used OFDM symbols in resource allocation
 	if (phy->ul_symbol_alloc[sfn][first_symb-2]==NOT_USED)
@@ -638,8 +833,6 @@ int phy_map_ulctrl(PhyUE phy, LogicalChannel chan, uint subframe, uint8_t slot_n
 	if (phy->ul_symbol_alloc[sfn][first_symb+2]==NOT_USED)
 	    phy->ul_symbol_alloc[sfn][first_symb+1] = PTT_DOWN; // next slot is not used, end PTT here
 
-	free(enc_b);
-	free(repacked_b);
 	return 0;
 }
 
@@ -647,9 +840,8 @@ int phy_map_ulctrl(PhyUE phy, LogicalChannel chan, uint subframe, uint8_t slot_n
 int phy_map_ulslot(PhyUE phy, LogicalChannel chan, uint subframe, uint8_t slot_nr, uint mcs)
 {
 	PhyCommon common = phy->common;
+	phy_tx_scratch_s* scratch = &common->tx_scratch;
 
-	uint8_t* repacked_b;
-	uint bytes_written=0;
 	uint32_t blocksize = get_tbs_size(phy->common, mcs);
 
 	if (blocksize/8 != chan->payload_len) {
@@ -663,30 +855,17 @@ int phy_map_ulslot(PhyUE phy, LogicalChannel chan, uint subframe, uint8_t slot_n
 
 	// encode channel
 	uint enc_len = fec_get_enc_msg_length(common->mcs_fec_scheme[mcs],chan->payload_len);
-	uint8_t* enc_b = malloc(enc_len);
+	uint8_t* enc_b = scratch->enc;
 	fec_encode(common->mcs_fec[mcs], blocksize/8, chan->data, enc_b);
 
-	//interleaving
-	uint8_t* interleaved_b = malloc(enc_len);
-	interleaver_encode(common->mcs_interlvr[mcs],enc_b, interleaved_b);
-
-	// repack bytes so that each array entry can be mapped to one symbol
-	int num_repacked = ceil(enc_len*8.0/modem_get_bps(common->mcs_modem[mcs]));
-	repacked_b = malloc(num_repacked);
-	liquid_repack_bytes(interleaved_b,8,enc_len,repacked_b,modem_get_bps(common->mcs_modem[mcs]),num_repacked,&bytes_written);
-
 	uint total_samps = 0;
-	uint first_symb = (SLOT_LEN+1)*slot_nr;
-	uint last_symb = (SLOT_LEN+1)*(slot_nr+1)-2; //TODO implement generic function to calc all slot allocations
-	// slot 3 and 4 are shifted back since the ULCTRL lies between slot 2 and 3
-	if(slot_nr>=2) {
-		first_symb += 4;
-		last_symb +=4;
-	}
+	re_map map = phy_get_re_map(common, RE_MAP_ULSLOT, slot_nr);
+	uint first_symb = map->first_symb;
+	uint last_symb = map->first_symb+map->num_symb-1;
 
-	// modulate signal
+	// interleave and modulate signal
 	uint sfn = subframe % 2;
-	phy_mod(phy->common,sfn, 0,nfft-1,first_symb,last_symb, mcs, repacked_b, num_repacked, &total_samps);
+	phy_mod_encoded(phy->common, sfn, map, mcs, enc_b, enc_len, &total_samps);
 
 	// activate used OFDM symbols in resource allocation
 	memset(&phy->ul_symbol_alloc[sfn][first_symb],DATA,last_symb-first_symb+1);
@@ -711,8 +890,5 @@ int phy_map_ulslot(PhyUE phy, LogicalChannel chan, uint subframe, uint8_t slot_n
         if (phy->ul_symbol_alloc[sfn][last_symb + 2] == NOT_USED)
             phy->ul_symbol_alloc[sfn][last_symb + 1] = PTT_DOWN; // next slot is not used, end PTT here
     }
-    free(interleaved_b);
-	free(enc_b);
-	free(repacked_b);
 	return 0;
 }
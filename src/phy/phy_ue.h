@@ -20,6 +20,7 @@
 #define PHY_UE_H_
 
 #include "phy_common.h"
+#include "phy_slot_queue.h"
 #include "../platform/platform.h"
 #include <pthread.h>
 
@@ -28,6 +29,10 @@ typedef enum {NO_SYNC, HAS_SYNC} phy_states;
 // definition of slot assignments types
 typedef enum {NOT_ASSIGNED, UE_ASSIGNED, BRCST_ASSIGNED} assignment_t;
 
+// receive modes of an OFDM symbol
+typedef enum {UE_RX_SKIP, UE_RX_NOPILOT, UE_RX_PILOT} phy_ue_rx_mode;
+#define UE_RX_MAX_RUN SLOT_LEN	// max number of symbols passed to the OFDM receiver at once
+
 // forward declaration of Mac struct
 struct MacUE_s;
 
@@ -43,6 +48,8 @@ struct PhyUE_s {
 	uint8_t** dlslot_assignments;
 	uint8_t** ulslot_assignments;
 	uint8_t** ulctrl_assignments;
+	// bit i is set if DL data slot i carries a HARQ retransmission. Index: even/uneven subframe
+	uint8_t dlslot_retx[2];
 
 	// store resource allocation on OFDM symbol basis
 	// UE has to refrain from sending if no data is allocated
@@ -68,16 +75,39 @@ struct PhyUE_s {
 	// Sample offset between buffer start and start of subframe
 	int rx_offset;
 
+	// Block receive: consecutive symbols with the same receive mode are received in one run
+	phy_ue_rx_mode rx_run_mode;	// receive mode of the current run
+	uint rx_run_len;			// number of symbols of the current run
+	uint rx_run_samps;			// number of samples of the current run that were already received
+	uint rx_symb_cnt;			// number of symbols passed to the rx symbol callback
+
+	// Skipping of symbols that are not needed, see UE_RX_SKIP_UNASSIGNED
+	int rx_skip_enabled;
+	// phase the NCO of the OFDM receiver lags behind the received signal, since it did not run
+	// during skipped symbols. Samples are derotated by this phase before they are passed to the receiver
+	float rx_skip_phase;
+	float complex* rx_conv_buf;	// received samples converted to float or derotated
+	uint rx_conv_len;
+	uint rx_symbols_skipped;	// statistics
+
 	// random userid which is used during RA procedure
 	int rachuserid;
 	// count how often we tried to associate
 	int rach_try_cnt;
+	// preallocated channel object for the association request
+	LogicalChannel rach_chan;
+	// time domain symbol of the next association request, prepared for try rach_symbol_try_cnt
+	float complex* rach_symbol;
+	int rach_symbol_try_cnt;
 	// assigned userid
 	int userid;
 
-	//define mutex and condition object to run slot processing in separate thread
-	pthread_cond_t* rx_slot_signal;
-	uint rx_slot_nr;
+	// worker threads which decode the received slots. NULL if slots are decoded in the RX thread
+	phy_slot_queue slot_queue;
+
+	// DL HARQ process. Failed DL data slots are NACKed with a MAC control message
+	phy_harq dl_harq;
+	uint rx_subframe_cnt;	// number of received subframes
 
     // store rx and txgain values from basestation sync signal
     int8_t bs_rxgain;
@@ -90,7 +120,7 @@ typedef struct PhyUE_s* PhyUE;
 /************ GENERAL PHY CONFIG FUNCTIONS **********************/
 PhyUE phy_ue_init();
 void phy_ue_destroy(PhyUE phy);
-void phy_ue_set_rx_slot_th_signal(PhyUE phy, pthread_cond_t* cond);
+int phy_ue_start_slot_workers(PhyUE phy, uint num_workers);
 void phy_ue_set_mac_interface(PhyUE phy, void (*mac_rx_cb)(struct MacUE_s*, LogicalChannel, uint), struct MacUE_s* mac);
 void phy_ue_set_platform_interface(PhyUE phy, struct platform_s* platform);
 
@@ -99,6 +129,7 @@ void phy_ue_set_platform_interface(PhyUE phy, struct platform_s* platform);
 // Configuration
 int phy_ue_set_mcs_dl(PhyUE phy, uint mcs);
 void phy_ue_reset_symbol_allocation(PhyUE phy, uint subframe);
+int phy_ue_get_dl_harq_nack(PhyUE phy, uint* subframe, uint* slot_nr);
 
 // PHY data mapping
 int phy_map_ulslot(PhyUE phy, LogicalChannel chan, uint subframe, uint8_t slot_nr, uint mcs);
@@ -111,6 +142,8 @@ void phy_ue_proc_slot(PhyUE phy, uint slotnr);
 /***************** PHY RX/TX FUNCTIONS *****************************/
 int phy_ue_initial_sync(PhyUE phy, float complex* rxbuf_time, uint num_samples);
 void phy_ue_do_rx(PhyUE phy, float complex* rxbuf_time, uint num_samples);
+void phy_ue_do_rx_cs16(PhyUE phy, const int16_t* iq, uint num_samples, float scale);
+void phy_ue_do_rx_view(PhyUE phy, const platform_rx_view_s* view);
 
 void phy_ue_write_symbol(PhyUE phy, float complex* txbuf_time);
 
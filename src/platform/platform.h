@@ -43,6 +43,16 @@
  *	ptt_set_rx(platform)
  *
  *	If you do not want to use this, implement dummy functions for these handlers.
+ *
+ *	Optional zero copy receive. Set the handlers to NULL if not supported
+ *	platform_rx_view(platform, platform_rx_view_s*):
+ *			fetch new samples and expose the native buffer of the platform
+ *	platform_rx_release(platform):
+ *			release the buffer exposed by platform_rx_view. Has to be called
+ *			before the next samples are fetched
+ *	platform_tx_view(platform, platform_tx_view_s*):
+ *			expose the native buffer that is sent by the next tx_push.
+ *			Can be used instead of tx_prep, see platform_tx_writer.h
  */
 
 #ifndef PLATFORM_PLATFORM_H_
@@ -50,6 +60,33 @@
 
 #include <complex.h>
 
+// Sample formats of the native platform buffers
+typedef enum {
+	PLATFORM_FMT_CF32,	// float complex
+	PLATFORM_FMT_CS16	// interleaved int16 I/Q
+} platform_sample_fmt;
+
+// View on the native receive buffer of a platform
+typedef struct {
+	platform_sample_fmt fmt;
+	const void* samples;
+	unsigned int num_samples;
+	float scale;		// CS16: factor to convert the int16 values to float
+} platform_rx_view_s;
+
+// View on the native transmit buffer of a platform
+typedef struct {
+	platform_sample_fmt fmt;
+	void* samples;
+	unsigned int num_samples;
+	float scale;		// factor to convert float samples before they are written to the buffer
+} platform_tx_view_s;
+
+// Statistics of the platform
+struct platform_stats_s {
+	unsigned int tx_clipped;	// number of TX samples that exceeded the DAC range
+};
+
 struct platform_s {
 	int (*platform_tx_push)(struct platform_s*);
 	int (*platform_tx_prep)(struct platform_s*, float complex*, unsigned int offset, unsigned int num_samples);
@@ -57,6 +94,10 @@ struct platform_s {
 	void (*end)(struct platform_s*);
 	void (*ptt_set_tx)(struct platform_s*);
 	void (*ptt_set_rx)(struct platform_s*);
+	int (*platform_rx_view)(struct platform_s*, platform_rx_view_s*);
+	void (*platform_rx_release)(struct platform_s*);
+	int (*platform_tx_view)(struct platform_s*, platform_tx_view_s*);
+	struct platform_stats_s stats;
 	void* data;	// Pointer to store some data if necessary for some platform
 };
 
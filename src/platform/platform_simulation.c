@@ -50,6 +50,22 @@ int simulation_receive(platform p, float complex* buf)
 	return 1;
 }
 
+// The view exposes the rx buffer, which is written by the TX of the remote instance
+int simulation_receive_view(platform p, platform_rx_view_s* view)
+{
+	simu_data data = ((simu_data)p->data);
+	view->fmt = PLATFORM_FMT_CF32;
+	view->samples = data->rxbuf;
+	view->num_samples = data->buflen;
+	view->scale = 1.0f;
+	return 1;
+}
+
+void simulation_receive_release(platform p)
+{
+
+}
+
 int simulation_prep_tx(platform p, float complex* buf, uint offset, uint num_samples)
 {
 	simu_data data = ((simu_data)p->data);
@@ -61,6 +77,16 @@ int simulation_prep_tx(platform p, float complex* buf, uint offset, uint num_sam
 	return 1;
 }
 
+int simulation_tx_view(platform p, platform_tx_view_s* view)
+{
+	simu_data data = ((simu_data)p->data);
+	view->fmt = PLATFORM_FMT_CF32;
+	view->samples = data->tx_prep_buf;
+	view->num_samples = data->buflen;
+	view->scale = 1.0f;
+	return 1;
+}
+
 int simulation_tx(platform p)
 {
 	simu_data data = ((simu_data)p->data);
@@ -108,11 +134,14 @@ void simulation_connect(platform p, platform remote)
 platform platform_init_simulation(uint buflen, float snr, float cfo)
 {
 	// Generate platform interface
-	platform sim = malloc(sizeof(struct platform_s));
+	platform sim = calloc(sizeof(struct platform_s),1);
 	simu_data sim_data = malloc(sizeof(struct simu_data_s));
 
 	// Set the functions
 	sim->platform_rx = simulation_receive;
+	sim->platform_rx_view = simulation_receive_view;
+	sim->platform_rx_release = simulation_receive_release;
+	sim->platform_tx_view = simulation_tx_view;
 	sim->platform_tx_prep = simulation_prep_tx;
 	sim->platform_tx_push = simulation_tx;
 	sim->end = sim_end;
@@ -0,0 +1,103 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "platform_tx_writer.h"
+#include "pluto_iq.h"
+#include "../util/log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+struct platform_tx_writer_s {
+	platform hw;
+	platform_tx_view_s view;	// buffer that is currently filled
+	unsigned int pos;			// write position in the buffer
+
+	// samples that did not fit into the previous buffer, in the native format
+	uint8_t* carry;
+	unsigned int carry_len;		// number of carried samples
+	unsigned int carry_size;	// capacity in samples
+	size_t sample_size;			// size of one native sample in bytes
+};
+
+platform_tx_writer platform_tx_writer_create(platform hw)
+{
+	if (hw->platform_tx_view == NULL)
+		return NULL;
+
+	platform_tx_writer w = calloc(sizeof(struct platform_tx_writer_s),1);
+	w->hw = hw;
+	// the view is only used to get the buffer size and the sample format
+	hw->platform_tx_view(hw, &w->view);
+	w->sample_size = (w->view.fmt == PLATFORM_FMT_CS16) ? 2*sizeof(int16_t) : sizeof(float complex);
+	w->carry_size = w->view.num_samples;
+	w->carry = calloc(w->carry_size, w->sample_size);
+	return w;
+}
+
+void platform_tx_writer_destroy(platform_tx_writer w)
+{
+	free(w->carry);
+	free(w);
+}
+
+void platform_tx_writer_begin(platform_tx_writer w, unsigned int tx_shift)
+{
+	w->hw->platform_tx_view(w->hw, &w->view);
+	if (tx_shift > w->view.num_samples)
+		tx_shift = w->view.num_samples;
+
+	uint8_t* buf = w->view.samples;
+	unsigned int missing = tx_shift > w->carry_len ? tx_shift - w->carry_len : 0;
+	memset(buf, 0, missing*w->sample_size);
+	memcpy(buf + missing*w->sample_size, w->carry + (w->carry_len-(tx_shift-missing))*w->sample_size,
+		   (tx_shift-missing)*w->sample_size);
+	w->pos = tx_shift;
+	w->carry_len = 0;
+}
+
+// convert samples to the native format
+static void platform_tx_writer_convert(platform_tx_writer w, const float complex* samples, uint8_t* dest,
+									   unsigned int num_samples)
+{
+	if (w->view.fmt == PLATFORM_FMT_CS16) {
+		w->hw->stats.tx_clipped += pluto_iq_from_float(samples, (int16_t*)dest, num_samples, w->view.scale);
+	} else {
+		float complex* out = (float complex*)dest;
+		for (int i=0; i<num_samples; i++)
+			out[i] = samples[i]*w->view.scale;
+	}
+}
+
+void platform_tx_writer_write(platform_tx_writer w, const float complex* samples, unsigned int num_samples)
+{
+	// fill the platform buffer
+	unsigned int n = w->view.num_samples - w->pos;
+	n = num_samples < n ? num_samples : n;
+	platform_tx_writer_convert(w, samples, (uint8_t*)w->view.samples + w->pos*w->sample_size, n);
+	w->pos += n;
+
+	// carry the rest over to the next buffer
+	unsigned int rest = num_samples - n;
+	if (w->carry_len + rest > w->carry_size) {
+		LOG(WARN,"[PLATFORM] TX writer overflow. %d samples dropped\n", w->carry_len+rest-w->carry_size);
+		rest = w->carry_size - w->carry_len;
+	}
+	platform_tx_writer_convert(w, samples+n, w->carry + w->carry_len*w->sample_size, rest);
+	w->carry_len += rest;
+}
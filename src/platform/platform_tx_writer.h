@@ -0,0 +1,45 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef PLATFORM_TX_WRITER_H_
+#define PLATFORM_TX_WRITER_H_
+
+#include "platform.h"
+
+// Writes a continuous stream of TX samples directly into the native TX buffers of a platform.
+// Every buffer starts with tx_shift samples that were carried over from the previous buffer,
+// i.e. the stream is shifted by tx_shift samples against the buffer boundaries.
+// Samples are converted to the native format (e.g. scaled and saturated int16 for the Pluto) while
+// they are written, so no intermediate float buffer for a whole platform buffer is required.
+// Requires the platform_tx_view handler of the platform.
+
+typedef struct platform_tx_writer_s* platform_tx_writer;
+
+// Create a writer for the platform. Returns NULL if the platform has no tx view
+platform_tx_writer platform_tx_writer_create(platform hw);
+void platform_tx_writer_destroy(platform_tx_writer w);
+
+// Start to fill the next platform buffer. Has to be called after platform_tx_push().
+// Writes the last tx_shift samples of the carried over samples to the start of the buffer.
+// If tx_shift grew since the last buffer, missing samples are set to zero
+void platform_tx_writer_begin(platform_tx_writer w, unsigned int tx_shift);
+
+// Append num_samples samples. Samples beyond the end of the buffer are carried over to the next buffer
+void platform_tx_writer_write(platform_tx_writer w, const float complex* samples, unsigned int num_samples);
+
+#endif /* PLATFORM_TX_WRITER_H_ */
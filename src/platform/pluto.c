@@ -27,6 +27,7 @@
 #include <unistd.h>
 #include <libconfig.h>
 #include "pluto_gpio.h"
+#include "pluto_iq.h"
 
 /* helper macros */
 #define MHZ(x) ((long long)(x*1000000.0 + .5))
@@ -212,22 +213,34 @@ int pluto_prep_tx(platform hw, float complex* buf_tx, uint offset, uint num_samp
 	p_inc = iio_buffer_step(pluto->txbuf);
 	p_start = iio_buffer_first(pluto->txbuf, pluto->tx0_i) + offset*p_inc;
 	p_end = iio_buffer_end(pluto->txbuf);
+	// 12-bit sample needs to be MSB aligned
+	// https://wiki.analog.com/resources/eval/user-guides/ad-fmcomms2-ebz/software/basic_iq_datafiles#binary_format
 	uint i=0;
-	for (p_dat = p_start; p_dat < p_end && i<num_samples; p_dat += p_inc) {
-		// 12-bit sample needs to be MSB aligned
-		// https://wiki.analog.com/resources/eval/user-guides/ad-fmcomms2-ebz/software/basic_iq_datafiles#binary_format
-        ((int16_t*)p_dat)[0] = (int16_t)(8196.0*creal(buf_tx[i])); // Real (I)
-        ((int16_t*)p_dat)[1] = (int16_t)(8196.0*cimag(buf_tx[i++])); // Imag (Q)
-
-		// data check
-        if (creal(buf_tx[i-1])>=4 || creal(buf_tx[i-1])<=-4
-                || cimag(buf_tx[i-1])>=4 || cimag(buf_tx[i-1])<=-4) {
-			LOG(WARN,"[Platform] Clipping in TX buffer!\n");
-		}
+	if (p_inc == 2*sizeof(int16_t)) {
+		// I and Q are interleaved without gaps: convert the whole block at once
+		uint avail = (p_end-p_start)/p_inc;
+		i = num_samples < avail ? num_samples : avail;
+		hw->stats.tx_clipped += pluto_iq_from_float(buf_tx, (int16_t*)p_start, i, PLUTO_IQ_TX_SCALE);
+	} else {
+		for (p_dat = p_start; p_dat < p_end && i<num_samples; p_dat += p_inc)
+			hw->stats.tx_clipped += pluto_iq_from_float(&buf_tx[i++], (int16_t*)p_dat, 1, PLUTO_IQ_TX_SCALE);
 	}
 	return i;
 }
 
+// Expose the TX buffer that is sent by the next pluto_transmit()
+// Requires I and Q to be interleaved without gaps
+int pluto_tx_view(platform hw, platform_tx_view_s* view)
+{
+    pluto_data pluto = (pluto_data)hw->data;
+	char* p_start = iio_buffer_first(pluto->txbuf, pluto->tx0_i);
+	view->fmt = PLATFORM_FMT_CS16;
+	view->samples = p_start;
+	view->num_samples = ((char*)iio_buffer_end(pluto->txbuf)-p_start)/iio_buffer_step(pluto->txbuf);
+	view->scale = PLUTO_IQ_TX_SCALE;
+	return view->num_samples;
+}
+
 // Flushes the TX buffer and transfers data to Kernel buffer
 // so that samples will be sent
 int pluto_transmit(platform hw)
@@ -260,12 +273,42 @@ int pluto_receive(platform hw, float complex* buf_rx)
 	p_end = iio_buffer_end(pluto->rxbuf);
 
 	uint i=0;
-	for (p_dat = p_start; p_dat < p_end; p_dat += p_inc) {
-		buf_rx[i++] = ((int16_t*)p_dat)[0]/2048.0 + I*((int16_t*)p_dat)[1]/2048.0;
+	if (p_inc == 2*sizeof(int16_t)) {
+		i = (p_end-p_start)/p_inc;
+		pluto_iq_to_float((int16_t*)p_start, buf_rx, i, PLUTO_IQ_RX_SCALE);
+	} else {
+		for (p_dat = p_start; p_dat < p_end; p_dat += p_inc)
+			pluto_iq_to_float((int16_t*)p_dat, &buf_rx[i++], 1, PLUTO_IQ_RX_SCALE);
 	}
 	return i;
 }
 
+// Receive samples from Kernel buffer without copying them
+// The view is valid until the next refill. Requires I and Q to be interleaved without gaps
+// returns the number of received samples
+int pluto_receive_view(platform hw, platform_rx_view_s* view)
+{
+    pluto_data pluto = (pluto_data)hw->data;
+    ssize_t nbytes_rx;
+
+	// Refill RX buffer
+	nbytes_rx = iio_buffer_refill(pluto->rxbuf);
+	if (nbytes_rx < 0) { printf("Error refilling buf %d\n",(int) nbytes_rx); }
+
+	char* p_start = iio_buffer_first(pluto->rxbuf, pluto->rx0_i);
+	view->fmt = PLATFORM_FMT_CS16;
+	view->samples = p_start;
+	view->num_samples = ((char*)iio_buffer_end(pluto->rxbuf)-p_start)/iio_buffer_step(pluto->rxbuf);
+	view->scale = PLUTO_IQ_RX_SCALE;
+	return view->num_samples;
+}
+
+// The kernel buffer is reused by the next refill, nothing to do
+void pluto_receive_release(platform hw)
+{
+
+}
+
 void pluto_print(platform hw)
 {
     pluto_data pluto = (pluto_data)hw->data;
@@ -408,6 +451,13 @@ void init_generic(platform hw, uint buf_len, char* config_file)
 	hw->end = shutdown;
 	hw->ptt_set_rx = pluto_ptt_set_rx;
 	hw->ptt_set_tx = pluto_ptt_set_tx;
+	// zero copy receive is only offered if I and Q are interleaved without gaps
+	if (pluto->rxbuf && iio_buffer_step(pluto->rxbuf) == 2*sizeof(int16_t)) {
+		hw->platform_rx_view = pluto_receive_view;
+		hw->platform_rx_release = pluto_receive_release;
+	}
+	if (pluto->txbuf && iio_buffer_step(pluto->txbuf) == 2*sizeof(int16_t))
+		hw->platform_tx_view = pluto_tx_view;
 }
 
 long long pluto_get_rxgain(platform hw)
@@ -501,7 +551,7 @@ void pluto_ptt_set_switch_delay(platform hw, int delay_us)
 // Initialize a pluto network context
 platform init_pluto_network_platform(uint buf_len)
 {
-    platform pluto = malloc(sizeof(struct platform_s));
+    platform pluto = calloc(sizeof(struct platform_s),1);
     pluto_data data = calloc(sizeof(struct pluto_data_s),1);
     pluto->data = data;
     char ipaddr[] = "192.168.4.1";
@@ -520,7 +570,7 @@ platform init_pluto_network_platform(uint buf_len)
 //      config_file:    optional path to a config file. Set to NULL to use default config
 platform init_pluto_platform(uint buf_len, char* config_file)
 {
-    platform pluto = malloc(sizeof(struct platform_s));
+    platform pluto = calloc(sizeof(struct platform_s),1);
     pluto_data data = calloc(sizeof(struct pluto_data_s),1);
     pluto->data = data;
 	printf("* Acquiring IIO context\n");
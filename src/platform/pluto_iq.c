@@ -0,0 +1,153 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#include "pluto_iq.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PLUTO_IQ_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PLUTO_IQ_SSE2
+#endif
+
+// value range of a float that is truncated to a valid int16
+#define IQ_MAX 32768.0f
+#define IQ_MIN -32769.0f
+
+void pluto_iq_to_float_ref(const int16_t* iq, float complex* out, uint num_samples, float scale)
+{
+	float* f = (float*)out;
+	for (int i=0; i<2*num_samples; i++)
+		f[i] = iq[i]*scale;
+}
+
+uint pluto_iq_from_float_ref(const float complex* in, int16_t* iq, uint num_samples, float scale)
+{
+	const float* f = (const float*)in;
+	uint clipped = 0;
+	for (int i=0; i<num_samples; i++) {
+		int clip = 0;
+		for (int k=0; k<2; k++) {
+			float v = f[2*i+k]*scale;
+			if (v >= IQ_MAX) {
+				iq[2*i+k] = INT16_MAX;
+				clip = 1;
+			} else if (v <= IQ_MIN || v != v) {
+				iq[2*i+k] = INT16_MIN;
+				clip = 1;
+			} else {
+				iq[2*i+k] = (int16_t)v;
+			}
+		}
+		clipped += clip;
+	}
+	return clipped;
+}
+
+void pluto_iq_to_float(const int16_t* iq, float complex* out, uint num_samples, float scale)
+{
+	uint n = 0;
+	float* f = (float*)out;
+#if defined(PLUTO_IQ_NEON)
+	float32x4_t s = vdupq_n_f32(scale);
+	for (; n+4<=num_samples; n+=4) {
+		int16x8_t x = vld1q_s16(&iq[2*n]);
+		vst1q_f32(&f[2*n],   vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), s));
+		vst1q_f32(&f[2*n+4], vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), s));
+	}
+#elif defined(PLUTO_IQ_SSE2)
+	__m128 s = _mm_set1_ps(scale);
+	for (; n+4<=num_samples; n+=4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)&iq[2*n]);
+		// sign extend to 32 bit
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x,x),16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x,x),16);
+		_mm_storeu_ps(&f[2*n],   _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+		_mm_storeu_ps(&f[2*n+4], _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+	}
+#endif
+	// remaining samples
+	if (n<num_samples)
+		pluto_iq_to_float_ref(&iq[2*n], &out[n], num_samples-n, scale);
+}
+
+uint pluto_iq_from_float(const float complex* in, int16_t* iq, uint num_samples, float scale)
+{
+	uint n = 0;
+	uint clipped = 0;
+	const float* f = (const float*)in;
+#if defined(PLUTO_IQ_NEON)
+	float32x4_t s = vdupq_n_f32(scale);
+	uint32x4_t clip_cnt = vdupq_n_u32(0);
+	for (; n+4<=num_samples; n+=4) {
+		// truncate with saturation to 32 bit, then saturate to 16 bit
+		int32x4_t a = vcvtq_s32_f32(vmulq_f32(vld1q_f32(&f[2*n]), s));
+		int32x4_t b = vcvtq_s32_f32(vmulq_f32(vld1q_f32(&f[2*n+4]), s));
+		int16x4_t a16 = vqmovn_s32(a);
+		int16x4_t b16 = vqmovn_s32(b);
+		vst1q_s16(&iq[2*n], vcombine_s16(a16,b16));
+		// a component was clipped if saturation changed it. Mark both components of the sample
+		uint32x4_t ca = vmvnq_u32(vceqq_s32(a, vmovl_s16(a16)));
+		uint32x4_t cb = vmvnq_u32(vceqq_s32(b, vmovl_s16(b16)));
+		ca = vorrq_u32(ca, vrev64q_u32(ca));
+		cb = vorrq_u32(cb, vrev64q_u32(cb));
+		clip_cnt = vaddq_u32(clip_cnt, vshrq_n_u32(ca,31));
+		clip_cnt = vaddq_u32(clip_cnt, vshrq_n_u32(cb,31));
+	}
+	// every clipped sample was counted for I and Q
+	clipped = (vgetq_lane_u32(clip_cnt,0) + vgetq_lane_u32(clip_cnt,1) +
+			   vgetq_lane_u32(clip_cnt,2) + vgetq_lane_u32(clip_cnt,3))/2;
+#elif defined(PLUTO_IQ_SSE2)
+	__m128 s = _mm_set1_ps(scale);
+	// limit the range before the conversion, which returns INT32_MIN for values out of the 32 bit range
+	__m128 vmax = _mm_set1_ps(2*IQ_MAX);
+	__m128 vmin = _mm_set1_ps(2*IQ_MIN);
+	for (; n+4<=num_samples; n+=4) {
+		// truncate to 32 bit, then saturate to 16 bit
+		__m128 fa = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&f[2*n]), s), vmin), vmax);
+		__m128 fb = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&f[2*n+4]), s), vmin), vmax);
+		__m128i a = _mm_cvttps_epi32(fa);
+		__m128i b = _mm_cvttps_epi32(fb);
+		__m128i x = _mm_packs_epi32(a,b);
+		_mm_storeu_si128((__m128i*)&iq[2*n], x);
+		// a component was clipped if saturation changed it
+		__m128i ca = _mm_cmpeq_epi32(a, _mm_srai_epi32(_mm_unpacklo_epi16(x,x),16));
+		__m128i cb = _mm_cmpeq_epi32(b, _mm_srai_epi32(_mm_unpackhi_epi16(x,x),16));
+		uint mask = ~(_mm_movemask_ps(_mm_castsi128_ps(ca)) | _mm_movemask_ps(_mm_castsi128_ps(cb))<<4) & 0xff;
+		// one bit per sample
+		mask = (mask | mask>>1) & 0x55;
+		clipped += __builtin_popcount(mask);
+	}
+#endif
+	// remaining samples
+	if (n<num_samples)
+		clipped += pluto_iq_from_float_ref(&in[n], &iq[2*n], num_samples-n, scale);
+	return clipped;
+}
+
+const char* pluto_iq_impl_str()
+{
+#if defined(PLUTO_IQ_NEON)
+	return "neon";
+#elif defined(PLUTO_IQ_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,49 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+#ifndef PLATFORM_PLUTO_IQ_H_
+#define PLATFORM_PLUTO_IQ_H_
+
+#include <complex.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Conversion between the interleaved int16 IQ samples of the IIO buffers and float complex samples.
+// Vectorized with NEON on the Pluto and SSE2 on x86, with a scalar fallback.
+// All implementations produce identical results.
+
+// Scaling of the samples. RX samples are 12 bit, TX samples are 12 bit MSB aligned
+#define PLUTO_IQ_RX_SCALE (1.0f/2048.0f)
+#define PLUTO_IQ_TX_SCALE 8196.0f
+
+// Convert num_samples interleaved int16 IQ samples to float complex and multiply them by scale
+void pluto_iq_to_float(const int16_t* iq, float complex* out, uint num_samples, float scale);
+
+// Multiply num_samples float complex samples by scale and convert them to interleaved int16 IQ.
+// Values are truncated towards zero and saturated to the int16 range. The result for NaN is undefined.
+// returns the number of samples where I or Q was clipped
+uint pluto_iq_from_float(const float complex* in, int16_t* iq, uint num_samples, float scale);
+
+// scalar reference implementations
+void pluto_iq_to_float_ref(const int16_t* iq, float complex* out, uint num_samples, float scale);
+uint pluto_iq_from_float_ref(const float complex* in, int16_t* iq, uint num_samples, float scale);
+
+// name of the vectorized implementation
+const char* pluto_iq_impl_str();
+
+#endif /* PLATFORM_PLUTO_IQ_H_ */
@@ -20,10 +20,12 @@
 
 
 #include "../mac/mac_bs.h"
+#include "../mac/mac_frame_pool.h"
 #include "../phy/phy_bs.h"
 #include "../phy/phy_config.h"
 #include "../platform/pluto.h"
 #include "../platform/platform_simulation.h"
+#include "../platform/platform_tx_writer.h"
 #include "../util/log.h"
 
 #include <pthread.h>
@@ -47,12 +49,15 @@ int buflen;             // size of the fpga transfer buffers
 #define INTER_SYMB_OFFSET 0
 
 // Configure CPU core affinities for the threads
-#define BS_RX_SLOT_CPUID 0
+#define BS_RX_SLOT_CPUID 0	// first slot decoding thread, further threads use the following cores
 #define BS_RX_CPUID 1
 #define BS_TX_CPUID 1
 #define BS_MAC_CPUID 0
 #define BS_TAP_CPUID 0
 
+// Number of slot decoding threads
+#define BS_NUM_RX_SLOT_WORKERS 2
+
 // program options
 struct option Options[] = {
   {"rxgain",required_argument,NULL,'g'},
@@ -60,6 +65,7 @@ struct option Options[] = {
   {"frequency",required_argument,NULL,'f'},
   {"config",required_argument,NULL,'c'},
   {"log",required_argument,NULL,'l'},
+  {"scheduler",required_argument,NULL,'s'},
   {"help",no_argument,NULL,'h'},
   {NULL},
 };
@@ -70,13 +76,16 @@ Options:\n \
    --frequency -f: tune to a specific (DL) frequency\n \
    --config -c     specify a configuration file\n \
    --log -l        specify the log level. Default: 2.\n \
-                   0=TRACE 1=DEBUG 2=INFO 3=WARN 4=ERR 5=NONE\n";
+                   0=TRACE 1=DEBUG 2=INFO 3=WARN 4=ERR 5=NONE\n \
+   --scheduler -s  select the scheduler policy: rr (round robin) or pf (proportional fair).\n \
+                   Default: pf\n";
 
 extern char *optarg;
 int rxgain = 70;
 int txgain = 0;
 long long int frequency = -1;
 char* config_file=NULL;
+mac_sched_type scheduler = MAC_SCHED_DEFAULT;
 
 // struct holds arguments for RX thread
 struct rx_th_data_s {
@@ -100,13 +109,6 @@ struct mac_th_data_s {
 	MacBS mac;
 };
 
-// struct with args for RX slot thread
-struct rx_slot_th_data_s {
-    PhyBS phy;
-    pthread_cond_t* rx_slot_signal;
-    pthread_mutex_t* rx_slot_mutex;
-};
-
 // Main Thread for BS receive
 void* thread_phy_bs_rx(void* arg)
 {
@@ -128,39 +130,25 @@ void* thread_phy_bs_rx(void* arg)
 	LOG(INFO,"RX thread started: RX symbol %d. TX symbol %d\n",phy->common->rx_symbol,phy->common->tx_symbol);
 	while (1)
 	{
-		hw->platform_rx(hw, rxbuf_time);
-		TIMECHECK_START(timecheck_bs_rx);
-		phy_bs_rx_symbol(phy, rxbuf_time);
-		phy_bs_rx_symbol(phy, rxbuf_time+(nfft+cp_len));
-		TIMECHECK_STOP_CHECK(timecheck_bs_rx,530);
+		if (hw->platform_rx_view) {
+			// receive directly from the platform buffer
+			platform_rx_view_s view;
+			hw->platform_rx_view(hw, &view);
+			TIMECHECK_START(timecheck_bs_rx);
+			phy_bs_rx_view(phy, &view);
+			TIMECHECK_STOP_CHECK(timecheck_bs_rx,530);
+			hw->platform_rx_release(hw);
+		} else {
+			hw->platform_rx(hw, rxbuf_time);
+			TIMECHECK_START(timecheck_bs_rx);
+			phy_bs_rx_block(phy, rxbuf_time, SYMBOLS_PER_BUF);
+			TIMECHECK_STOP_CHECK(timecheck_bs_rx,530);
+		}
 		//TIMECHECK_INFO(timecheck_bs_rx);
 	}
 	return NULL;
 }
 
-void* thread_phy_bs_rx_slot(void* arg)
-{
-    PhyBS phy = ((struct rx_slot_th_data_s*)arg)->phy;
-    pthread_cond_t* cond_signal = ((struct rx_slot_th_data_s*)arg)->rx_slot_signal;
-    pthread_mutex_t* mutex = ((struct rx_slot_th_data_s*)arg)->rx_slot_mutex;
-    TIMECHECK_CREATE(timecheck_bs_rx_slot);
-    TIMECHECK_INIT(timecheck_bs_rx_slot,"bs.rx_slot",1000);
-
-    while (1) {
-        // Wait for signal from UE rx thread
-        pthread_mutex_lock(mutex);
-        pthread_cond_wait(cond_signal, mutex);
-        TIMECHECK_START(timecheck_bs_rx_slot);
-
-        phy_bs_proc_slot(phy,phy->rx_slot_nr);
-
-        pthread_mutex_unlock(mutex);
-        TIMECHECK_STOP_CHECK(timecheck_bs_rx_slot,3500);
-        TIMECHECK_INFO(timecheck_bs_rx_slot);
-    }
-    return NULL;
-}
-
 // Main Thread for BS transmit
 void* thread_phy_bs_tx(void* arg)
 {
@@ -173,6 +161,8 @@ void* thread_phy_bs_tx(void* arg)
     TIMECHECK_INIT(timecheck_bs_tx,"bs.tx_buffer",10000);
 
 	float complex* txbuf_time = calloc(sizeof(float complex),buflen);
+	// write the symbols directly into the platform buffer if possible
+	platform_tx_writer writer = platform_tx_writer_create(bs);
 
 	// generate some txbuffers in order to keep the txbuffer queue full
 	bs->platform_tx_prep(bs, txbuf_time, 0, buflen);
@@ -188,12 +178,22 @@ void* thread_phy_bs_tx(void* arg)
 	    LOG(TRACE,"[TX Thread] start subframe %d\n",subframe_cnt);
 		for (int symbol=0; symbol<SUBFRAME_LEN/2; symbol++) {
 			bs->platform_tx_push(bs);
-			bs->platform_tx_prep(bs, txbuf_time+buflen-INTER_SYMB_OFFSET, 0, INTER_SYMB_OFFSET);
-            TIMECHECK_START(timecheck_bs_tx);
-			phy_bs_write_symbol(phy, txbuf_time);
-			phy_bs_write_symbol(phy, txbuf_time+1*(nfft+cp_len));
-
-			bs->platform_tx_prep(bs, txbuf_time, INTER_SYMB_OFFSET, buflen-INTER_SYMB_OFFSET);
+			if (writer) {
+				TIMECHECK_START(timecheck_bs_tx);
+				platform_tx_writer_begin(writer, INTER_SYMB_OFFSET);
+				// txbuf_time only holds the current symbol
+				phy_bs_write_symbol(phy, txbuf_time);
+				platform_tx_writer_write(writer, txbuf_time, nfft+cp_len);
+				phy_bs_write_symbol(phy, txbuf_time);
+				platform_tx_writer_write(writer, txbuf_time, nfft+cp_len);
+			} else {
+				bs->platform_tx_prep(bs, txbuf_time+buflen-INTER_SYMB_OFFSET, 0, INTER_SYMB_OFFSET);
+				TIMECHECK_START(timecheck_bs_tx);
+				phy_bs_write_symbol(phy, txbuf_time);
+				phy_bs_write_symbol(phy, txbuf_time+1*(nfft+cp_len));
+
+				bs->platform_tx_prep(bs, txbuf_time, INTER_SYMB_OFFSET, buflen-INTER_SYMB_OFFSET);
+			}
             // run scheduler. TODO tweak signaling time: after ULCTRL is received, but early enough to finish
             if (symbol==23) {
 				pthread_cond_signal(scheduler_signal);
@@ -225,11 +225,14 @@ void* thread_mac_bs_scheduler(void* arg)
 #if BS_SEND_ENABLE
 		uint payload_len = 200;
 		MacDataFrame dl_frame = dataframe_create(payload_len);
-		for (int i=0; i<payload_len; i++)
-			dl_frame->data[i] = rand() & 0xFF;
-		memcpy(dl_frame->data,&subframe_cnt,sizeof(uint));
-		if(!mac_bs_add_txdata(mac, 2, dl_frame)) {
-			dataframe_destroy(dl_frame);
+		// skip the frame if the frame pool is exhausted
+		if (dl_frame != NULL) {
+			for (int i=0; i<payload_len; i++)
+				dl_frame->data[i] = rand() & 0xFF;
+			memcpy(dl_frame->data,&subframe_cnt,sizeof(uint));
+			if(!mac_bs_add_txdata(mac, 2, dl_frame)) {
+				dataframe_destroy(dl_frame);
+			}
 		}
 #endif
 		mac_bs_run_scheduler(mac);
@@ -243,14 +246,14 @@ void* thread_mac_bs_scheduler(void* arg)
 
 int main(int argc,char *argv[])
 {
-	pthread_t bs_phy_rx_slot_th, bs_phy_rx_th, bs_phy_tx_th, bs_mac_th, bs_tap_th;
+	pthread_t bs_phy_rx_th, bs_phy_tx_th, bs_mac_th, bs_tap_th;
 
 	// load default configuration
 	phy_config_default_64();
 
     // parse program args
     int d;
-    while((d = getopt_long(argc,argv,"g:t:f:c:l:h",Options,NULL)) != EOF){
+    while((d = getopt_long(argc,argv,"g:t:f:c:l:s:h",Options,NULL)) != EOF){
         switch(d){
         case 'g':
             rxgain = atoi(optarg);
@@ -281,6 +284,16 @@ int main(int argc,char *argv[])
                 exit(EXIT_FAILURE);
             }
             break;
+        case 's':
+            if (strcmp(optarg,"rr")==0) {
+                scheduler = MAC_SCHED_ROUND_ROBIN;
+            } else if (strcmp(optarg,"pf")==0) {
+                scheduler = MAC_SCHED_PROP_FAIR;
+            } else {
+                printf("ERROR: scheduler %s undefined!\n",optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'h':
             printf("%s",helpstring);
             exit(0);
@@ -321,6 +334,7 @@ int main(int argc,char *argv[])
 
 	phy_bs_set_mac_interface(phy, mac);
 	mac_bs_set_phy_interface(mac, phy);
+	mac_bs_set_scheduler(mac, scheduler);
 
 	//rx and tx threads will be synchronized by a barrier
 	pthread_barrier_t sync_barrier;
@@ -348,30 +362,24 @@ int main(int argc,char *argv[])
 	tx_th_data.scheduler_signal = &cond;
 	tx_th_data.thread_sync = &sync_barrier;
 
-    // create arguments for RX slot thread
-    pthread_cond_t rx_slot_cond = PTHREAD_COND_INITIALIZER;
-    pthread_mutex_t rx_slot_mutex = PTHREAD_MUTEX_INITIALIZER;
-    struct rx_slot_th_data_s rx_slot_th_data;
-    rx_slot_th_data.phy = phy;
-    rx_slot_th_data.rx_slot_mutex = &rx_slot_mutex;
-    rx_slot_th_data.rx_slot_signal = &rx_slot_cond;
-    phy_bs_set_rx_slot_th_signal(phy,&rx_slot_cond);
-
-    // start RX slot thread
-    if (pthread_create(&bs_phy_rx_slot_th, NULL, thread_phy_bs_rx_slot, &rx_slot_th_data) != 0) {
-        LOG(ERR,"could not create RX slot processing thread. Abort!\n");
+    // start RX slot processing threads
+    if (!phy_bs_start_slot_workers(phy, BS_NUM_RX_SLOT_WORKERS)) {
+        LOG(ERR,"could not create RX slot processing threads. Abort!\n");
         exit(EXIT_FAILURE);
     } else {
-        LOG(INFO,"created RX slot processing thread.\n");
+        LOG(INFO,"created %d RX slot processing threads.\n",phy_slot_queue_get_num_workers(phy->slot_queue));
     }
     cpu_set_t cpu_set;
-    CPU_ZERO(&cpu_set);
-    CPU_SET(BS_RX_SLOT_CPUID,&cpu_set);
     struct sched_param prio_rt_high, prio_rt_normal;
     prio_rt_high.sched_priority = 2;
     prio_rt_normal.sched_priority = 1;
-    pthread_setaffinity_np(bs_phy_rx_slot_th,sizeof(cpu_set_t),&cpu_set);
-    pthread_setschedparam(bs_phy_rx_slot_th, SCHED_FIFO, &prio_rt_normal);
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i=0; i<phy_slot_queue_get_num_workers(phy->slot_queue); i++) {
+        CPU_ZERO(&cpu_set);
+        CPU_SET((BS_RX_SLOT_CPUID+i)%num_cpus,&cpu_set);
+        pthread_setaffinity_np(phy_slot_queue_get_thread(phy->slot_queue,i),sizeof(cpu_set_t),&cpu_set);
+        pthread_setschedparam(phy_slot_queue_get_thread(phy->slot_queue,i), SCHED_FIFO, &prio_rt_normal);
+    }
 
     // start RX thread
 	if (pthread_create(&bs_phy_rx_th, NULL, thread_phy_bs_rx, &rx_th_data) !=0) {
@@ -437,10 +445,12 @@ int main(int argc,char *argv[])
 	for (int i=0; i<4; i++)
 		printf("%d ",CPU_ISSET(i, &cpu_set));
 
-    pthread_getaffinity_np(bs_phy_rx_slot_th,sizeof(cpu_set_t),&cpu_set);
-    printf("\nRX slot Thread CPU mask: ");
-    for (int i=0; i<4; i++)
-        printf("%d ",CPU_ISSET(i, &cpu_set));
+    for (int w=0; w<phy_slot_queue_get_num_workers(phy->slot_queue); w++) {
+        pthread_getaffinity_np(phy_slot_queue_get_thread(phy->slot_queue,w),sizeof(cpu_set_t),&cpu_set);
+        printf("\nRX slot Thread %d CPU mask: ",w);
+        for (int i=0; i<4; i++)
+            printf("%d ",CPU_ISSET(i, &cpu_set));
+    }
 	printf("\n");
 
     // main thread: regularly show statistics:
@@ -461,13 +471,29 @@ int main(int argc,char *argv[])
             }
         }
         LOG(INFO,"Num connected users: %d\n",num_user);
+        LOG(INFO,"RX slots dropped, decoding too slow: %d\n",phy_slot_queue_get_stalls(phy->slot_queue));
+        LOG(INFO,"DLCTRL cache: %d hits %d misses\n",phy->dlctrl_cache_hits,phy->dlctrl_cache_misses);
+        LOG(INFO,"TX samples clipped: %d\n",pluto->stats.tx_clipped);
+        LOG(INFO,"UL CFO estimate updates: %d\n",phy->ul_est_updates);
+        LOG(INFO,"UL HARQ: %d NACKs, %d slots decoded after combining\n",phy->ul_harq_nacks,
+                  phy_bs_get_ul_harq_combined(phy));
+        for (int dir=DL; dir<=UL; dir++) {
+            mac_slot_stats_s* slots = &mac->slot_stats;
+            LOG(INFO,"%s data slots: %d/%d used (%.1f%%), %d idle with data queued\n", dir==DL ? "DL" : "UL",
+                      slots->used[dir], slots->available[dir],
+                      slots->available[dir] ? 100.0f*slots->used[dir]/slots->available[dir] : 0.0f, slots->idle[dir]);
+        }
+        LOG(INFO,"Forwarding table: %d EtherAddr entries\n",mac_ethermap_count(mac->ethermap,-1));
+        mac_frame_pool_stats_s pool_stats;
+        mac_frame_pool_get_stats(&pool_stats);
+        LOG(INFO,"Frame pool: %d frames, %d free in shared list, %d drops, %d oversize\n",MAC_FRAME_POOL_SIZE,
+                  pool_stats.shared_free,pool_stats.drops,pool_stats.oversize);
         SYSLOG(LOG_INFO,"Num connected users: %d\n",num_user);
     }
 
 	static void* ret[4];
 	pthread_join(bs_phy_rx_th, (void*)&ret[0]);
     pthread_join(bs_phy_tx_th, (void*)&ret[1]);
-    pthread_join(bs_phy_rx_slot_th, (void*)&ret[2]);
 	pthread_join(bs_mac_th, &ret[3]);
 
 }
@@ -19,10 +19,12 @@
 #define _GNU_SOURCE
 
 #include "../mac/mac_ue.h"
+#include "../mac/mac_frame_pool.h"
 #include "../phy/phy_ue.h"
 #include "../phy/phy_config.h"
 #include "../platform/pluto.h"
 #include "../platform/platform_simulation.h"
+#include "../platform/platform_tx_writer.h"
 #include "../util/log.h"
 
 #include <pthread.h>
@@ -36,9 +38,12 @@
 #define UE_RX_CPUID 1
 #define UE_TX_CPUID 1
 #define UE_MAC_CPUID 0
-#define UE_RX_SLOT_CPUID 0
+#define UE_RX_SLOT_CPUID 0	// first slot decoding thread, further threads use the following cores
 #define UE_TAP_CPUID 0
 
+// Number of slot decoding threads
+#define UE_NUM_RX_SLOT_WORKERS 1
+
 // FPGA buffers contain a multiple of ofdm symbols per buffer. We fix this to 2 symbols for low latency
 #define SYMBOLS_PER_BUF 2
 int buflen=-1;          // size per buffer object in samples
@@ -101,13 +106,6 @@ struct mac_th_data_s {
 	MacUE mac;
 };
 
-// struct with args for RX slot thread
-struct rx_slot_th_data_s {
-	PhyUE phy;
-	pthread_cond_t* rx_slot_signal;
-	pthread_mutex_t* rx_slot_mutex;
-};
-
 // Main Thread for UE receive
 void* thread_phy_ue_rx(void* arg)
 {
@@ -126,11 +124,18 @@ void* thread_phy_ue_rx(void* arg)
 
 	// Main RX loop
 	while (1) {
-		// fill buffer
-		hw->platform_rx(hw, rxbuf_time);
-		// process samples
-		TIMECHECK_START(timecheck_ue_rx);
-		phy_ue_do_rx(phy, rxbuf_time, buflen);
+		// fill buffer and process samples. Receive directly from the platform buffer if possible
+		if (hw->platform_rx_view) {
+			platform_rx_view_s view;
+			hw->platform_rx_view(hw, &view);
+			TIMECHECK_START(timecheck_ue_rx);
+			phy_ue_do_rx_view(phy, &view);
+			hw->platform_rx_release(hw);
+		} else {
+			hw->platform_rx(hw, rxbuf_time);
+			TIMECHECK_START(timecheck_ue_rx);
+			phy_ue_do_rx(phy, rxbuf_time, buflen);
+		}
 		//log_bin((uint8_t*)rxbuf_time,BUFLEN*sizeof(float complex), "dl_data.bin","a");
 		// Run scheduler after DLCTRL slot was received
 		if (phy->common->rx_symbol == DLCTRL_LEN ||
@@ -167,6 +172,8 @@ void* thread_phy_ue_tx(void* arg)
 
 	float complex* ul_data_tx = calloc(sizeof(float complex),buflen);
 	int timing_advance=0, rx_offset, num_samples, tx_shift=0;;
+	// write the symbols directly into the platform buffer if possible
+	platform_tx_writer writer = platform_tx_writer_create(hw);
 
 	// wait until rx thread has achieved sync
 	while (!phy->has_synced_once) {
@@ -181,15 +188,25 @@ void* thread_phy_ue_tx(void* arg)
 
 	while (1) {
 		TIMECHECK_START(timecheck_ue_tx);
-		// create tx time data
-		// first add the last samples from the previous generated symbol
-		hw->platform_tx_prep(hw, ul_data_tx+num_samples, 0, tx_shift);
-		// create new symbol
-		phy_ue_write_symbol(phy, ul_data_tx);
-		phy_ue_write_symbol(phy, ul_data_tx+(nfft+cp_len));
-
-		// prepare first part of the new symbol
-		hw->platform_tx_prep(hw, ul_data_tx, tx_shift, num_samples);
+		if (writer) {
+			// the writer carries the last tx_shift samples over to the next buffer.
+			// ul_data_tx only holds the current symbol
+			platform_tx_writer_begin(writer, tx_shift);
+			phy_ue_write_symbol(phy, ul_data_tx);
+			platform_tx_writer_write(writer, ul_data_tx, nfft+cp_len);
+			phy_ue_write_symbol(phy, ul_data_tx);
+			platform_tx_writer_write(writer, ul_data_tx, nfft+cp_len);
+		} else {
+			// create tx time data
+			// first add the last samples from the previous generated symbol
+			hw->platform_tx_prep(hw, ul_data_tx+num_samples, 0, tx_shift);
+			// create new symbol
+			phy_ue_write_symbol(phy, ul_data_tx);
+			phy_ue_write_symbol(phy, ul_data_tx+(nfft+cp_len));
+
+			// prepare first part of the new symbol
+			hw->platform_tx_prep(hw, ul_data_tx, tx_shift, num_samples);
+		}
 
 		TIMECHECK_STOP_CHECK(timecheck_ue_tx,530);
 		TIMECHECK_INFO(timecheck_ue_tx);
@@ -257,10 +274,13 @@ void* thread_mac_ue_scheduler(void* arg)
 		// add some data to send for client
 #if CLIENT_SEND_ENABLE
 		MacDataFrame ul_frame = dataframe_create(120);
-		for (int i=0; i<100; i++)
-			ul_frame->data[i] = rand() & 0xFF;
-		if(!mac_ue_add_txdata(mac, ul_frame)) {
-			dataframe_destroy(ul_frame);
+		// skip the frame if the frame pool is exhausted
+		if (ul_frame != NULL) {
+			for (int i=0; i<100; i++)
+				ul_frame->data[i] = rand() & 0xFF;
+			if(!mac_ue_add_txdata(mac, ul_frame)) {
+				dataframe_destroy(ul_frame);
+			}
 		}
 #endif
 		mac_ue_run_scheduler(mac);
@@ -270,6 +290,10 @@ void* thread_mac_ue_scheduler(void* arg)
 		if (sched_rounds%1000==0) {
 			LOG(WARN,"[MAC] channels received:fail %d:%d\n",mac->stats.chan_rx_succ,mac->stats.chan_rx_fail);
 			LOG(WARN,"      bytes rx: %d bytes tx: %d\n",mac->stats.bytes_rx, mac->stats.bytes_tx);
+			LOG(WARN,"      PHY symbols skipped: %d\n",mac->phy->rx_symbols_skipped);
+			LOG(WARN,"      HARQ retransmissions: %d DL slots decoded after combining: %d\n",
+					mac->stats.harq_retx, phy_harq_get_combined(mac->phy->dl_harq));
+			LOG(WARN,"      TX samples clipped: %d\n",mac->phy->platform->stats.tx_clipped);
 		}
 
 		TIMECHECK_STOP_CHECK(timecheck_ue_sched,3500);
@@ -279,24 +303,6 @@ void* thread_mac_ue_scheduler(void* arg)
 	return NULL;
 }
 
-void* thread_phy_ue_rx_slot(void* arg)
-{
-	PhyUE phy = ((struct rx_slot_th_data_s*)arg)->phy;
-	pthread_cond_t* cond_signal =  ((struct rx_slot_th_data_s*)arg)->rx_slot_signal;
-	pthread_mutex_t* mutex =  ((struct rx_slot_th_data_s*)arg)->rx_slot_mutex;
-
-	while (1) {
-		// Wait for signal from UE rx thread
-		pthread_mutex_lock(mutex);
-		pthread_cond_wait(cond_signal, mutex);
-
-		phy_ue_proc_slot(phy,phy->rx_slot_nr);
-
-        pthread_mutex_unlock(mutex);
-    }
-	return NULL;
-}
-
 // Get first estimates of the carrier frequency offset and tune to the
 // correct frequency
 void  phy_carrier_sync(PhyUE phy, platform hw)
@@ -354,7 +360,7 @@ int main(int argc,char *argv[])
     prio.sched_priority = 3;
     sched_setscheduler(0,SCHED_FIFO, &prio);
 
-    pthread_t ue_phy_rx_th, ue_phy_tx_th, ue_mac_th, ue_phy_rx_slot_th, ue_tap_th;
+    pthread_t ue_phy_rx_th, ue_phy_tx_th, ue_mac_th, ue_tap_th;
 
 	// start by loading default config.
 	phy_config_default_64();
@@ -507,30 +513,24 @@ int main(int argc,char *argv[])
 	tx_th_data.hw = pluto;
 	tx_th_data.phy = phy;
 
-	// create arguments for RX slot thread
-	pthread_cond_t rx_slot_cond = PTHREAD_COND_INITIALIZER;
-	pthread_mutex_t rx_slot_mutex = PTHREAD_MUTEX_INITIALIZER;
-	struct rx_slot_th_data_s rx_slot_th_data;
-	rx_slot_th_data.phy = phy;
-	rx_slot_th_data.rx_slot_mutex = &rx_slot_mutex;
-	rx_slot_th_data.rx_slot_signal = &rx_slot_cond;
-	phy_ue_set_rx_slot_th_signal(phy,&rx_slot_cond);
-
-	// start RX slot thread
-	if (pthread_create(&ue_phy_rx_slot_th, NULL, thread_phy_ue_rx_slot, &rx_slot_th_data) !=0) {
-		LOG(ERR,"could not create RX slot processing thread. Abort!\n");
+	// start RX slot processing threads
+	if (!phy_ue_start_slot_workers(phy, UE_NUM_RX_SLOT_WORKERS)) {
+		LOG(ERR,"could not create RX slot processing threads. Abort!\n");
 		exit(EXIT_FAILURE);
 	} else {
-		LOG(INFO,"created RX slot processing thread.\n");
+		LOG(INFO,"created %d RX slot processing threads.\n",phy_slot_queue_get_num_workers(phy->slot_queue));
 	}
 	cpu_set_t cpu_set;
-	CPU_ZERO(&cpu_set);
-	CPU_SET(UE_RX_SLOT_CPUID,&cpu_set);
     struct sched_param prio_rt_high, prio_rt_normal;
     prio_rt_high.sched_priority = 2;
     prio_rt_normal.sched_priority = 1;
-	pthread_setaffinity_np(ue_phy_rx_slot_th,sizeof(cpu_set_t),&cpu_set);
-    pthread_setschedparam(ue_phy_rx_slot_th, SCHED_FIFO, &prio_rt_normal);
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	for (int i=0; i<phy_slot_queue_get_num_workers(phy->slot_queue); i++) {
+		CPU_ZERO(&cpu_set);
+		CPU_SET((UE_RX_SLOT_CPUID+i)%num_cpus,&cpu_set);
+		pthread_setaffinity_np(phy_slot_queue_get_thread(phy->slot_queue,i),sizeof(cpu_set_t),&cpu_set);
+		pthread_setschedparam(phy_slot_queue_get_thread(phy->slot_queue,i), SCHED_FIFO, &prio_rt_normal);
+	}
 
 	// start RX thread
 	if (pthread_create(&ue_phy_rx_th, NULL, thread_phy_ue_rx, &rx_th_data) !=0) {
@@ -595,10 +595,12 @@ int main(int argc,char *argv[])
 	for (int i=0; i<4; i++)
 		printf("%d ",CPU_ISSET(i, &cpu_set));
 
-	pthread_getaffinity_np(ue_phy_rx_slot_th,sizeof(cpu_set_t),&cpu_set);
-	printf("\nRX slot proc Thread CPU mask: ");
-	for (int i=0; i<4; i++)
-		printf("%d ",CPU_ISSET(i, &cpu_set));
+	for (int w=0; w<phy_slot_queue_get_num_workers(phy->slot_queue); w++) {
+		pthread_getaffinity_np(phy_slot_queue_get_thread(phy->slot_queue,w),sizeof(cpu_set_t),&cpu_set);
+		printf("\nRX slot proc Thread %d CPU mask: ",w);
+		for (int i=0; i<4; i++)
+			printf("%d ",CPU_ISSET(i, &cpu_set));
+	}
 	printf("\n");
 
 	// main thread: regulary show statistics:
@@ -614,10 +616,13 @@ int main(int argc,char *argv[])
             LOG(INFO,"UL mcs %d DL mcs %d\n",mac->ul_mcs, mac->dl_mcs);
             SYSLOG(LOG_INFO,"UL mcs %d DL mcs %d\n",mac->ul_mcs, mac->dl_mcs);
         }
+        mac_frame_pool_stats_s pool_stats;
+        mac_frame_pool_get_stats(&pool_stats);
+        LOG(INFO,"Frame pool: %d frames, %d free in shared list, %d drops, %d oversize\n",MAC_FRAME_POOL_SIZE,
+                  pool_stats.shared_free,pool_stats.drops,pool_stats.oversize);
 	}
 	static void* ret[4];
 	pthread_join(ue_phy_rx_th, &ret[0]);
 	pthread_join(ue_phy_tx_th, &ret[1]);
 	pthread_join(ue_mac_th, &ret[2]);
-	pthread_join(ue_phy_rx_slot_th, &ret[3]);
 }
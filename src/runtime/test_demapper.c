@@ -0,0 +1,135 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// Compares the vectorized soft demapper against its scalar reference
+// and the soft bits (sign and magnitude) against liquid's modem_demodulate_soft()
+// The fixed point demapper is compared against its scalar reference and against the float demapper
+
+#include "../phy/phy_common.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_SYMBOLS 10000
+#define LLR_TOL 4				// max difference of a soft bit to liquid
+#define LLR_MAX_MISMATCH 0.01f	// max fraction of soft bits that differ from liquid by more than LLR_TOL
+
+int test_modem(modulation_scheme scheme, const char* name, float snr_db)
+{
+    modem mod = modem_create(scheme);
+    demapper dem = phy_demapper_create(mod);
+    uint bps = modem_get_bps(mod);
+
+    float complex* x = malloc(sizeof(float complex)*NUM_SYMBOLS);
+    uint8_t* soft = malloc(NUM_SYMBOLS*bps);
+    uint8_t* soft_ref = malloc(NUM_SYMBOLS*bps);
+    uint8_t* soft_liquid = malloc(NUM_SYMBOLS*bps);
+    uint8_t* soft_q = malloc(NUM_SYMBOLS*bps);
+    uint8_t* soft_q_ref = malloc(NUM_SYMBOLS*bps);
+
+    // random symbols with awgn
+    float nstd = powf(10.0f, -snr_db/20.0f);
+    for (int n=0; n<NUM_SYMBOLS; n++) {
+        modem_modulate(mod, rand() % (1<<bps), &x[n]);
+        float u1 = (rand()+1.0f)/(RAND_MAX+1.0f);
+        float u2 = (rand()+1.0f)/(RAND_MAX+1.0f);
+        x[n] += nstd*M_SQRT1_2*sqrtf(-2*logf(u1))*(cosf(2*M_PI*u2) + _Complex_I*sinf(2*M_PI*u2));
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    demapper_execute(dem, x, NUM_SYMBOLS, soft);
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    float t_simd = (end.tv_sec-start.tv_sec)*1e6+(end.tv_nsec-start.tv_nsec)/1e3;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    demapper_execute_ref(dem, x, NUM_SYMBOLS, soft_ref);
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    float t_ref = (end.tv_sec-start.tv_sec)*1e6+(end.tv_nsec-start.tv_nsec)/1e3;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    demapper_execute_q(dem, x, NUM_SYMBOLS, soft_q);
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    float t_q = (end.tv_sec-start.tv_sec)*1e6+(end.tv_nsec-start.tv_nsec)/1e3;
+    demapper_execute_q_ref(dem, x, NUM_SYMBOLS, soft_q_ref);
+
+    uint sym;
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for (int n=0; n<NUM_SYMBOLS; n++)
+        modem_demodulate_soft(mod, x[n], &sym, &soft_liquid[n*bps]);
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    float t_liquid = (end.tv_sec-start.tv_sec)*1e6+(end.tv_nsec-start.tv_nsec)/1e3;
+
+    // vectorized and scalar implementation may only differ by rounding.
+    // The soft bits have to match liquid in sign and, except for a few bits, in magnitude:
+    // liquid only searches the nearest neighbors of the hard decision for QAM16 and above
+    uint ref_mismatch = 0, hard_mismatch = 0, llr_mismatch = 0;
+    float liquid_diff = 0;
+    for (int i=0; i<NUM_SYMBOLS*bps; i++) {
+        if (abs(soft[i]-soft_ref[i])>1)
+            ref_mismatch++;
+        if ((soft[i]>127) != (soft_liquid[i]>127) && soft[i]!=127 && soft_liquid[i]!=127)
+            hard_mismatch++;
+        if (abs(soft[i]-soft_liquid[i])>LLR_TOL)
+            llr_mismatch++;
+        liquid_diff += abs(soft[i]-soft_liquid[i]);
+    }
+
+    // fixed point: has to match its reference exactly. Hard decisions may only differ
+    // from the float demapper close to the decision threshold. The LLR step of the
+    // fixed point demapper grows with the LLR scaling, i.e. with the constellation size
+    uint q_ref_mismatch = 0, q_hard_mismatch = 0;
+    float q_diff = 0;
+    for (int i=0; i<NUM_SYMBOLS*bps; i++) {
+        if (soft_q[i] != soft_q_ref[i])
+            q_ref_mismatch++;
+        if ((soft_q[i]>127) != (soft[i]>127) && abs(soft[i]-127)>(4<<(bps/2-1)))
+            q_hard_mismatch++;
+        q_diff += abs(soft_q[i]-soft[i]);
+    }
+
+    printf("%7s SNR %4.1fdB: ref mismatch %d, hard decision mismatch to liquid %d, llr mismatch %d, "
+           "mean |llr diff| %5.2f time simd/ref/liquid: %.0f/%.0f/%.0fus\n",
+           name, snr_db, ref_mismatch, hard_mismatch, llr_mismatch, liquid_diff/(NUM_SYMBOLS*bps),
+           t_simd, t_ref, t_liquid);
+    printf("%7s fixed point: ref mismatch %d, hard decision mismatch to float %d, mean |llr diff| %5.2f time %.0fus\n",
+           name, q_ref_mismatch, q_hard_mismatch, q_diff/(NUM_SYMBOLS*bps), t_q);
+
+    free(x);
+    free(soft);
+    free(soft_ref);
+    free(soft_liquid);
+    free(soft_q);
+    free(soft_q_ref);
+    demapper_destroy(dem);
+    modem_destroy(mod);
+    return ref_mismatch==0 && hard_mismatch==0 && llr_mismatch <= LLR_MAX_MISMATCH*NUM_SYMBOLS*bps &&
+           q_ref_mismatch==0 && q_hard_mismatch==0;
+}
+
+int main(int argc, char* argv[])
+{
+    int ok = 1;
+    for (int snr=0; snr<=30; snr+=10) {
+        ok &= test_modem(LIQUID_MODEM_QPSK, "QPSK", snr);
+        ok &= test_modem(LIQUID_MODEM_QAM16, "QAM16", snr);
+        ok &= test_modem(LIQUID_MODEM_QAM64, "QAM64", snr);
+        ok &= test_modem(LIQUID_MODEM_QAM256, "QAM256", snr);
+    }
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
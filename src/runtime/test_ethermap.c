@@ -0,0 +1,194 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// Tests the Ethernet forwarding table of the BS: learning, moving hosts, per user limit, aging,
+// and lock-free lookups while another thread modifies the table
+
+#include "../mac/mac_ethermap.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define POOL_SIZE 1024			// number of host addresses used by the concurrent test
+#define NUM_LOOKUPS 2000000
+
+static float elapsed_us(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec-start->tv_sec)*1e6+(end->tv_nsec-start->tv_nsec)/1e3;
+}
+
+// host address n. Contains zero bytes, which must not end the address comparison
+static void host_addr(uint n, uint8_t* addr)
+{
+    addr[0] = 0x02;
+    addr[1] = 0x00;
+    addr[2] = 0x00;
+    addr[3] = (n >> 16) & 0xff;
+    addr[4] = (n >> 8) & 0xff;
+    addr[5] = n & 0xff;
+}
+
+// user that host n is located behind in the concurrent test
+static uint host_user(uint n)
+{
+    return 2 + n % 14;
+}
+
+int test_basic(void)
+{
+    mac_ethermap map = mac_ethermap_create();
+    uint8_t addr[6];
+    int ok = 1;
+
+    // learn and look up
+    for (int n=0; n<100; n++) {
+        host_addr(n, addr);
+        ok &= mac_ethermap_learn(map, addr, host_user(n), 0) == 1;
+    }
+    for (int n=0; n<100; n++) {
+        host_addr(n, addr);
+        ok &= mac_ethermap_lookup(map, addr) == host_user(n);
+        ok &= mac_ethermap_learn(map, addr, host_user(n), 0) == 0;
+    }
+    host_addr(100, addr);
+    ok &= mac_ethermap_lookup(map, addr) == -1;
+    ok &= mac_ethermap_count(map, -1) == 100;
+    if (!ok) printf("learn/lookup failed\n");
+
+    // a host moves to another user
+    host_addr(5, addr);
+    ok &= mac_ethermap_learn(map, addr, 15, 0) == 1;
+    ok &= mac_ethermap_lookup(map, addr) == 15;
+    ok &= mac_ethermap_count(map, -1) == 100;
+
+    // remove all hosts of a user
+    uint count = mac_ethermap_count(map, host_user(3));
+    mac_ethermap_remove_user(map, host_user(3));
+    ok &= mac_ethermap_count(map, host_user(3)) == 0;
+    ok &= mac_ethermap_count(map, -1) == 100 - count;
+    for (int n=0; n<100; n++) {
+        host_addr(n, addr);
+        int expected = (n == 5) ? 15 : (host_user(n) == host_user(3) ? -1 : host_user(n));
+        ok &= mac_ethermap_lookup(map, addr) == expected;
+    }
+    if (!ok) printf("move/remove failed\n");
+
+    // aging: only hosts that were not refreshed are removed. Refreshing also moves host 5 back
+    for (int n=0; n<50; n++) {
+        host_addr(n, addr);
+        mac_ethermap_learn(map, addr, host_user(n), ETHERMAP_MAX_AGE);
+    }
+    mac_ethermap_age(map, ETHERMAP_MAX_AGE+1);
+    for (int n=0; n<100; n++) {
+        host_addr(n, addr);
+        ok &= mac_ethermap_lookup(map, addr) == (n < 50 ? host_user(n) : -1);
+    }
+    ok &= mac_ethermap_count(map, -1) == 50;
+    ok &= mac_ethermap_age(map, 2*ETHERMAP_MAX_AGE) == 50;
+    ok &= mac_ethermap_count(map, -1) == 0;
+    if (!ok) printf("aging failed\n");
+
+    // per user limit: the oldest host of the user is replaced
+    for (int n=0; n<=ETHERMAP_MAX_PER_USER; n++) {
+        host_addr(n, addr);
+        mac_ethermap_learn(map, addr, 2, n);
+    }
+    ok &= mac_ethermap_count(map, 2) == ETHERMAP_MAX_PER_USER;
+    host_addr(0, addr);
+    ok &= mac_ethermap_lookup(map, addr) == -1;
+    host_addr(1, addr);
+    ok &= mac_ethermap_lookup(map, addr) == 2;
+    if (!ok) printf("per user limit failed\n");
+
+    // full table
+    int ret = 0;
+    for (int n=1000; n<1000+ETHERMAP_SIZE && ret>=0; n++) {
+        host_addr(n, addr);
+        ret = mac_ethermap_learn(map, addr, 3 + n % 12, 0);
+    }
+    ok &= ret == -1 && mac_ethermap_count(map, -1) == ETHERMAP_MAX_FILL;
+    if (!ok) printf("full table failed\n");
+
+    mac_ethermap_destroy(map);
+    printf("basic: %s\n", ok ? "ok" : "failed");
+    return ok;
+}
+
+struct writer_arg_s {
+    mac_ethermap map;
+    atomic_int stop;
+};
+
+// learns, moves and removes hosts until stopped. Host n is only ever learned for host_user(n)
+static void* writer_thread(void* arg)
+{
+    struct writer_arg_s* w = arg;
+    uint8_t addr[6];
+    time_t now = 0;
+    while (!atomic_load(&w->stop)) {
+        uint n = rand() % POOL_SIZE;
+        host_addr(n, addr);
+        mac_ethermap_learn(w->map, addr, host_user(n), now);
+        if (rand() % 64 == 0)
+            mac_ethermap_remove_user(w->map, host_user(rand() % POOL_SIZE));
+        if (rand() % 256 == 0)
+            mac_ethermap_age(w->map, now++);
+    }
+    return NULL;
+}
+
+int test_concurrent(void)
+{
+    struct writer_arg_s w = {mac_ethermap_create(), 0};
+    pthread_t writer;
+    pthread_create(&writer, NULL, writer_thread, &w);
+
+    uint8_t addr[6];
+    uint errors = 0, found = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for (int i=0; i<NUM_LOOKUPS; i++) {
+        uint n = i % POOL_SIZE;
+        host_addr(n, addr);
+        int userid = mac_ethermap_lookup(w.map, addr);
+        if (userid >= 0) {
+            found++;
+            errors += userid != host_user(n);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC,&end);
+
+    atomic_store(&w.stop, 1);
+    pthread_join(writer, NULL);
+    mac_ethermap_destroy(w.map);
+
+    printf("concurrent: %d lookups, %d found, %d wrong, %.1fns per lookup\n", NUM_LOOKUPS, found, errors,
+           elapsed_us(&start,&end)*1e3/NUM_LOOKUPS);
+    return errors == 0 && found > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    int ok = 1;
+    ok &= test_basic();
+    ok &= test_concurrent();
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
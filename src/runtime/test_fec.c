@@ -0,0 +1,126 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// Compares the in-tree Viterbi decoders (scalar and NEON/SSE2) against liquid's fec_decode_soft()
+// Messages are encoded with liquid, so this also verifies that the code definitions match
+
+#include "../phy/phy_fec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define MSG_LEN 288		// message length in bytes, covers the largest transport block of the MCS table
+#define NUM_TRIALS 200
+
+static float elapsed_us(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec-start->tv_sec)*1e6+(end->tv_nsec-start->tv_nsec)/1e3;
+}
+
+static uint bit_errors(uint8_t* a, uint8_t* b, uint len)
+{
+    uint errors = 0;
+    for (int i=0; i<len; i++)
+        errors += __builtin_popcount(a[i]^b[i]);
+    return errors;
+}
+
+int test_scheme(fec_scheme scheme, const char* name, float snr_db)
+{
+    fec enc = fec_create(scheme, NULL);
+    phy_fec dec_liquid = phy_fec_create(scheme, MSG_LEN, PHY_FEC_IMPL_LIQUID);
+    phy_fec dec_scalar = phy_fec_create(scheme, MSG_LEN, PHY_FEC_IMPL_SCALAR);
+    phy_fec dec_simd = phy_fec_create(scheme, MSG_LEN, PHY_FEC_IMPL_SIMD);
+
+    uint enc_len = fec_get_enc_msg_length(scheme, MSG_LEN);
+    uint8_t msg[MSG_LEN], msg_liquid[MSG_LEN], msg_scalar[MSG_LEN], msg_simd[MSG_LEN];
+    uint8_t* msg_enc = malloc(enc_len);
+    uint8_t* soft = malloc(enc_len*8);
+
+    uint err_liquid = 0, err_scalar = 0, simd_mismatch = 0;
+    float t_liquid = 0, t_scalar = 0, t_simd = 0;
+    float nstd = powf(10.0f, -snr_db/20.0f);
+    struct timespec start, end;
+
+    for (int n=0; n<NUM_TRIALS; n++) {
+        for (int i=0; i<MSG_LEN; i++)
+            msg[i] = rand() & 0xff;
+        fec_encode(enc, MSG_LEN, msg, msg_enc);
+
+        // BPSK with awgn, quantized to soft bits
+        for (int i=0; i<enc_len*8; i++) {
+            float x = ((msg_enc[i/8] >> (7-i%8)) & 1) ? 1.0f : -1.0f;
+            float u1 = (rand()+1.0f)/(RAND_MAX+1.0f);
+            float u2 = (rand()+1.0f)/(RAND_MAX+1.0f);
+            x += nstd*sqrtf(-2*logf(u1))*cosf(2*M_PI*u2);
+            float v = 127.5f + 64.0f*x;
+            soft[i] = v<0 ? 0 : (v>255 ? 255 : (uint8_t)v);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        phy_fec_decode_soft(dec_liquid, MSG_LEN, soft, msg_liquid);
+        clock_gettime(CLOCK_MONOTONIC,&end);
+        t_liquid += elapsed_us(&start,&end);
+
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        phy_fec_decode_soft(dec_scalar, MSG_LEN, soft, msg_scalar);
+        clock_gettime(CLOCK_MONOTONIC,&end);
+        t_scalar += elapsed_us(&start,&end);
+
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        phy_fec_decode_soft(dec_simd, MSG_LEN, soft, msg_simd);
+        clock_gettime(CLOCK_MONOTONIC,&end);
+        t_simd += elapsed_us(&start,&end);
+
+        err_liquid += bit_errors(msg, msg_liquid, MSG_LEN);
+        err_scalar += bit_errors(msg, msg_scalar, MSG_LEN);
+        // SIMD and scalar use the same integer metrics and have to match exactly
+        simd_mismatch += memcmp(msg_scalar, msg_simd, MSG_LEN) != 0;
+    }
+
+    float ber_liquid = (float)err_liquid/(NUM_TRIALS*MSG_LEN*8);
+    float ber_scalar = (float)err_scalar/(NUM_TRIALS*MSG_LEN*8);
+    printf("%7s SNR %4.1fdB: BER liquid %.2e in-tree %.2e, simd mismatch %d "
+           "time liquid/scalar/%s: %.0f/%.0f/%.0fus\n",
+           name, snr_db, ber_liquid, ber_scalar, simd_mismatch,
+           phy_fec_impl_str(phy_fec_get_impl(dec_simd)),
+           t_liquid/NUM_TRIALS, t_scalar/NUM_TRIALS, t_simd/NUM_TRIALS);
+
+    free(msg_enc);
+    free(soft);
+    fec_destroy(enc);
+    phy_fec_destroy(dec_liquid);
+    phy_fec_destroy(dec_scalar);
+    phy_fec_destroy(dec_simd);
+
+    // the in-tree decoder may not be noticeably worse than liquid
+    return simd_mismatch==0 && ber_scalar <= 1.5f*ber_liquid + 1e-5f;
+}
+
+int main(int argc, char* argv[])
+{
+    int ok = 1;
+    for (int snr=0; snr<=8; snr+=2) {
+        ok &= test_scheme(LIQUID_FEC_CONV_V27, "V27", snr);
+        ok &= test_scheme(LIQUID_FEC_CONV_V27P34, "V27P34", snr);
+    }
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
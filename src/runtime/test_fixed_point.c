@@ -0,0 +1,144 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// Compares the float and the fixed point soft demapper (PHY_FIXED_POINT) on the complete
+// decoding chain of a data slot: channel coding, interleaving and modulation of every MCS,
+// awgn, soft demapping, deinterleaving, Viterbi decoding and CRC check.
+// The fixed point demapper may not lose noticeably more slots or bits than the float demapper.
+
+#include "../phy/phy_common.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_SLOTS 200		// slots per MCS and SNR
+#define NUM_SNR 4			// SNR points per MCS, in steps of 1dB
+
+// lowest SNR per MCS. Chosen so that the float path fails a part of the slots at the first points
+static const float snr_start[NUM_MCS_SCHEMES] = {0, 3, 6, 9, 12, 15, 18};
+
+static float elapsed_us(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec-start->tv_sec)*1e6+(end->tv_nsec-start->tv_nsec)/1e3;
+}
+
+static uint bit_errors(uint8_t* a, uint8_t* b, uint len)
+{
+    uint errors = 0;
+    for (int i=0; i<len; i++)
+        errors += __builtin_popcount(a[i]^b[i]);
+    return errors;
+}
+
+// decode the soft bits of a slot. Returns the number of bit errors of the payload and sets crc_ok
+static uint decode(PhyCommon common, phy_rx_ctx ctx, uint mcs, uint8_t* soft, LogicalChannel tx,
+                   LogicalChannel rx, uint* crc_ok)
+{
+    interleaver_decode_soft(ctx->mcs_interlvr[mcs], soft, ctx->deinterleaved_buf);
+    phy_fec_decode_soft(ctx->mcs_dec[mcs], rx->payload_len, ctx->deinterleaved_buf, rx->data);
+    *crc_ok += lchan_verify_crc(rx);
+    return bit_errors(tx->data, rx->data, tx->payload_len);
+}
+
+int test_mcs(PhyCommon common, phy_rx_ctx ctx, uint mcs)
+{
+    uint len = get_tbs_size(common, mcs)/8;
+    uint enc_len = fec_get_enc_msg_length(common->mcs_fec_scheme[mcs], len);
+    uint bps = modem_get_bps(common->mcs_modem[mcs]);
+    uint num_sym = (enc_len*8+bps-1)/bps;
+
+    LogicalChannel tx = lchan_create(len, CRC16);
+    LogicalChannel rx = lchan_create(len, CRC16);
+    uint8_t* enc = malloc(enc_len);
+    uint8_t* interleaved = malloc(enc_len);
+    uint8_t* sym = malloc(num_sym);
+    float complex* x = malloc(sizeof(float complex)*num_sym);
+    uint8_t* soft = malloc(num_sym*bps);
+    uint8_t* soft_q = malloc(num_sym*bps);
+
+    int ok = 1;
+    for (int s=0; s<NUM_SNR; s++) {
+        float snr_db = snr_start[mcs] + s;
+        float nstd = powf(10.0f, -snr_db/20.0f);
+        uint crc_ok = 0, crc_ok_q = 0, err = 0, err_q = 0;
+        float t = 0, t_q = 0;
+        struct timespec start, end;
+
+        for (int n=0; n<NUM_SLOTS; n++) {
+            for (int i=0; i<len-2; i++)
+                tx->data[i] = rand() & 0xff;
+            lchan_calc_crc(tx);
+            fec_encode(common->mcs_fec[mcs], len, tx->data, enc);
+            interleaver_encode(common->mcs_interlvr[mcs], enc, interleaved);
+            uint written;
+            liquid_repack_bytes(interleaved, 8, enc_len, sym, bps, num_sym, &written);
+            for (int i=0; i<num_sym; i++) {
+                float u1 = (rand()+1.0f)/(RAND_MAX+1.0f);
+                float u2 = (rand()+1.0f)/(RAND_MAX+1.0f);
+                x[i] = common->mcs_constellation[mcs][sym[i]] +
+                       nstd*M_SQRT1_2*sqrtf(-2*logf(u1))*(cosf(2*M_PI*u2) + _Complex_I*sinf(2*M_PI*u2));
+            }
+
+            clock_gettime(CLOCK_MONOTONIC,&start);
+            demapper_execute(common->mcs_demapper[mcs], x, num_sym, soft);
+            clock_gettime(CLOCK_MONOTONIC,&end);
+            t += elapsed_us(&start,&end);
+
+            clock_gettime(CLOCK_MONOTONIC,&start);
+            demapper_execute_q(common->mcs_demapper[mcs], x, num_sym, soft_q);
+            clock_gettime(CLOCK_MONOTONIC,&end);
+            t_q += elapsed_us(&start,&end);
+
+            err += decode(common, ctx, mcs, soft, tx, rx, &crc_ok);
+            err_q += decode(common, ctx, mcs, soft_q, tx, rx, &crc_ok_q);
+        }
+
+        float ber = (float)err/(NUM_SLOTS*len*8);
+        float ber_q = (float)err_q/(NUM_SLOTS*len*8);
+        printf("MCS %d SNR %4.1fdB: CRC ok float %3d fixed %3d of %d, BER float %.2e fixed %.2e, "
+               "demapper time float/fixed: %.1f/%.1fus\n", mcs, snr_db, crc_ok, crc_ok_q, NUM_SLOTS,
+               ber, ber_q, t/NUM_SLOTS, t_q/NUM_SLOTS);
+        // allow a small loss due to the quantization of the samples and distances
+        ok &= crc_ok_q + NUM_SLOTS/50 >= crc_ok && ber_q <= 1.5f*ber + 1e-4f;
+    }
+
+    free(enc);
+    free(interleaved);
+    free(sym);
+    free(x);
+    free(soft);
+    free(soft_q);
+    lchan_destroy(tx);
+    lchan_destroy(rx);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    phy_config_default_64();
+    PhyCommon common = phy_common_init();
+    phy_rx_ctx ctx = phy_rx_ctx_create(common);
+
+    int ok = 1;
+    for (int mcs=0; mcs<NUM_MCS_SCHEMES; mcs++)
+        ok &= test_mcs(common, ctx, mcs);
+
+    phy_rx_ctx_destroy(ctx);
+    phy_common_destroy(common);
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
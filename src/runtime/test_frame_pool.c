@@ -0,0 +1,188 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// Tests the MacDataFrame pool: exhaustion and drop statistics, frames that are allocated
+// by one thread and freed by another, as done by the TAP and MAC threads, and frames that
+// are stolen from the cache of a running thread
+
+#include "../mac/mac_frame_pool.h"
+#include "../util/ringbuf.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_FRAMES 1000000	// frames passed from the producer to the consumer thread
+
+static float elapsed_us(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec-start->tv_sec)*1e6+(end->tv_nsec-start->tv_nsec)/1e3;
+}
+
+// allocates all frames of the pool in the calling thread. Returns the number of frames
+static uint alloc_all(MacDataFrame* frames)
+{
+    uint n = 0;
+    while (n < MAC_FRAME_POOL_SIZE+1 && (frames[n] = mac_frame_pool_alloc(MAC_MTU)) != NULL)
+        n++;
+    return n;
+}
+
+int test_exhaustion(void)
+{
+    MacDataFrame frames[MAC_FRAME_POOL_SIZE+1];
+    mac_frame_pool_stats_s stats;
+    int ok = 1;
+
+    ok &= mac_frame_pool_alloc(MAC_MTU+1) == NULL;
+    uint n = alloc_all(frames);
+    ok &= n == MAC_FRAME_POOL_SIZE;
+    mac_frame_pool_get_stats(&stats);
+    ok &= stats.drops == 1 && stats.oversize == 1 && stats.shared_free == 0;
+
+    // all frames are distinct and writable
+    for (int i=0; i<n; i++)
+        memset(frames[i]->data, i & 0xff, MAC_MTU);
+    for (int i=0; i<n; i++)
+        ok &= frames[i]->size == MAC_MTU && frames[i]->data[0] == (i & 0xff) &&
+              frames[i]->data[MAC_MTU-1] == (i & 0xff);
+
+    for (int i=0; i<n; i++)
+        mac_frame_pool_free(frames[i]);
+    ok &= alloc_all(frames) == MAC_FRAME_POOL_SIZE;
+    for (int i=0; i<MAC_FRAME_POOL_SIZE; i++)
+        mac_frame_pool_free(frames[i]);
+
+    printf("exhaustion: %d frames, %s\n", n, ok ? "ok" : "failed");
+    return ok;
+}
+
+static void* producer_thread(void* arg)
+{
+    ringbuf buf = arg;
+    for (uint n=0; n<NUM_FRAMES; n++) {
+        MacDataFrame frame;
+        while ((frame = mac_frame_pool_alloc(sizeof(uint))) == NULL)
+            sched_yield();
+        memcpy(frame->data, &n, sizeof(uint));
+        while (!ringbuf_put(buf, frame))
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void* alloc_all_thread(void* arg)
+{
+    MacDataFrame* frames = arg;
+    uint n = alloc_all(frames);
+    for (int i=0; i<n; i++)
+        mac_frame_pool_free(frames[i]);
+    return (void*)(uintptr_t)n;
+}
+
+// frames are allocated by the producer thread and freed by this thread
+int test_cross_thread(void)
+{
+    ringbuf buf = ringbuf_create(MAC_DATA_BUF_SIZE, RINGBUF_SPSC);
+    pthread_t producer;
+    uint errors = 0;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    pthread_create(&producer, NULL, producer_thread, buf);
+    for (uint n=0; n<NUM_FRAMES; n++) {
+        MacDataFrame frame;
+        while ((frame = ringbuf_get(buf)) == NULL)
+            sched_yield();
+        uint v;
+        memcpy(&v, frame->data, sizeof(uint));
+        errors += v != n;
+        mac_frame_pool_free(frame);
+    }
+    pthread_join(producer, NULL);
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    ringbuf_destroy(buf);
+
+    // the cache of the producer was returned when it exited and the frames cached by
+    // this thread are stolen, so another thread can allocate all frames
+    MacDataFrame frames[MAC_FRAME_POOL_SIZE+1];
+    pthread_t th;
+    void* ret;
+    pthread_create(&th, NULL, alloc_all_thread, frames);
+    pthread_join(th, &ret);
+    uint n = (uintptr_t)ret;
+    int ok = errors == 0 && n == MAC_FRAME_POOL_SIZE;
+
+    printf("cross thread: %d frames, %d errors, %.0fns per frame, %d frames allocatable after exit %s\n",
+           NUM_FRAMES, errors, elapsed_us(&start,&end)*1e3/NUM_FRAMES, n, ok ? "ok" : "failed");
+    return ok;
+}
+
+static pthread_barrier_t barrier;
+
+// frees frames into its cache and keeps running while another thread allocates all frames
+static void* cache_holder_thread(void* arg)
+{
+    MacDataFrame frames[MAC_FRAME_POOL_CACHE];
+    for (int i=0; i<MAC_FRAME_POOL_CACHE; i++)
+        frames[i] = mac_frame_pool_alloc(MAC_MTU);
+    for (int i=0; i<MAC_FRAME_POOL_CACHE; i++)
+        mac_frame_pool_free(frames[i]);
+    pthread_barrier_wait(&barrier);
+    pthread_barrier_wait(&barrier);
+    return NULL;
+}
+
+// the free frames in the cache of a running thread can be allocated by another thread
+int test_steal(void)
+{
+    MacDataFrame frames[MAC_FRAME_POOL_SIZE+1];
+    mac_frame_pool_stats_s stats_before, stats;
+    pthread_t th;
+
+    mac_frame_pool_get_stats(&stats_before);
+    pthread_barrier_init(&barrier, NULL, 2);
+    pthread_create(&th, NULL, cache_holder_thread, NULL);
+    pthread_barrier_wait(&barrier);
+
+    uint n = alloc_all(frames);
+    mac_frame_pool_get_stats(&stats);
+    for (int i=0; i<n; i++)
+        mac_frame_pool_free(frames[i]);
+
+    pthread_barrier_wait(&barrier);
+    pthread_join(th, NULL);
+    pthread_barrier_destroy(&barrier);
+
+    // only the allocation beyond the pool size fails
+    int ok = n == MAC_FRAME_POOL_SIZE && stats.drops == stats_before.drops+1;
+    printf("steal: %d frames allocatable while another thread caches free frames %s\n", n, ok ? "ok" : "failed");
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    int ok = 1;
+    ok &= test_exhaustion();
+    ok &= test_cross_thread();
+    ok &= test_steal();
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
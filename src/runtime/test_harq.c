@@ -0,0 +1,228 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// Tests the HARQ soft buffers: quantization of the stored soft bits, saturation when combining,
+// that only slots marked as retransmission are combined and with the right stored slot,
+// and the combining gain. Two noisy copies of a slot have to pass the CRC at an SNR where
+// a single copy usually fails
+
+#include "../phy/phy_harq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MSG_LEN 64			// transport block size in bytes, including the CRC16
+#define NUM_TRIALS 200
+#define SNR_DB 0.5f			// per coded bit. A single copy fails, two combined copies decode
+
+// The stored LLR has to be within half a quantization step of the soft bit,
+// soft bits beyond the largest LLR are clamped
+int test_quant()
+{
+    int ok = 1;
+    for (int s=0; s<256; s++) {
+        int q = phy_harq_dequant(phy_harq_quant(s));
+        int expected = s > 127+7*16+7 ? 7*16 : s-127;
+        if (abs(q-expected) > 8) {
+            printf("quantization: soft bit %d restored as %d\n", s, 127+q);
+            ok = 0;
+        }
+    }
+    // erasures have to stay erasures
+    ok &= phy_harq_dequant(phy_harq_quant(127)) == 0;
+    printf("LLR quantization: %s\n", ok ? "ok" : "failed");
+    return ok;
+}
+
+// Combine two slots whose soft bits overflow and underflow. The sum has to saturate
+int test_saturation(phy_fec dec, uint num_soft)
+{
+    // soft bits of the first and second transmission and the expected sum
+    const uint8_t first[4]  = {255, 0,   159, 95};
+    const uint8_t second[4] = {250, 5,   140, 200};
+    const uint8_t sum[4]    = {255, 0,   172, 168};
+
+    phy_harq h = phy_harq_create(num_soft);
+    LogicalChannel chan = lchan_create(MSG_LEN, CRC16);
+    uint8_t* soft = malloc(num_soft);
+    uint subframe, slot_nr;
+    int ok = 1;
+
+    for (int i=0; i<num_soft; i++)
+        soft[i] = first[i%4];
+    ok &= phy_harq_decode(h, dec, 0, soft, num_soft, chan, 0, 3, 2, 0) == HARQ_RX_NACK;
+    ok &= phy_harq_poll_nack(h, 0, HARQ_NACK_MAX_DELAY, &subframe, &slot_nr) && subframe==3 && slot_nr==2;
+
+    for (int i=0; i<num_soft; i++)
+        soft[i] = second[i%4];
+    ok &= phy_harq_decode(h, dec, 0, soft, num_soft, chan, 1, 4, 1, 1) == HARQ_RX_NACK;
+    for (int i=0; i<num_soft; i++)
+        ok &= soft[i] == sum[i%4];
+
+    printf("Combining saturation: %s\n", ok ? "ok" : "failed");
+    free(soft);
+    lchan_destroy(chan);
+    phy_harq_destroy(h);
+    return ok;
+}
+
+// BPSK with awgn, quantized to soft bits
+static void gen_soft(uint8_t* msg_enc, uint num_soft, float nstd, uint8_t* soft)
+{
+    for (int i=0; i<num_soft; i++) {
+        float x = ((msg_enc[i/8] >> (7-i%8)) & 1) ? 1.0f : -1.0f;
+        float u1 = (rand()+1.0f)/(RAND_MAX+1.0f);
+        float u2 = (rand()+1.0f)/(RAND_MAX+1.0f);
+        x += nstd*sqrtf(-2*logf(u1))*cosf(2*M_PI*u2);
+        float v = 127.5f + 64.0f*x;
+        soft[i] = v<0 ? 0 : (v>255 ? 255 : (uint8_t)v);
+    }
+}
+
+// Soft bits of a noiseless transmission. The first or the second half of the code block is erased,
+// so neither half decodes on its own, but both halves combined do
+static void gen_half(uint8_t* msg_enc, uint num_soft, int second_half, uint8_t* soft)
+{
+    for (int i=0; i<num_soft; i++) {
+        int bit = (msg_enc[i/8] >> (7-i%8)) & 1;
+        soft[i] = (i < num_soft/2) == second_half ? 127 : (bit ? 191 : 63);
+    }
+}
+
+// Two slots fail and are NACKed late. New data that fails is not combined although NACKs are
+// pending. The marked retransmissions have to be combined with their own stored slot
+int test_retx(phy_fec dec, uint enc_len)
+{
+    fec enc = fec_create(LIQUID_FEC_CONV_V27, NULL);
+    phy_harq h = phy_harq_create(enc_len*8);
+    LogicalChannel tx[3], rx = lchan_create(MSG_LEN, CRC16);
+    uint8_t* msg_enc[3];
+    uint8_t* soft = malloc(enc_len*8);
+    uint num_soft = enc_len*8;
+    uint subframe, slot_nr, nacked = 0;
+    int ok = 1;
+
+    for (int m=0; m<3; m++) {
+        tx[m] = lchan_create(MSG_LEN, CRC16);
+        for (int i=0; i<MSG_LEN-2; i++)
+            tx[m]->data[i] = 31*m + 7*i;
+        lchan_calc_crc(tx[m]);
+        msg_enc[m] = malloc(enc_len);
+        fec_encode(enc, MSG_LEN, tx[m]->data, msg_enc[m]);
+    }
+
+    // slot 0 and 1 of subframe 1 fail
+    for (int m=0; m<2; m++) {
+        gen_half(msg_enc[m], num_soft, 0, soft);
+        ok &= phy_harq_decode(h, dec, 0, soft, num_soft, rx, 0, 1, m, 10) == HARQ_RX_NACK;
+    }
+    // both are NACKed, although the NACKs are polled a few subframes later
+    while (phy_harq_poll_nack(h, 13, HARQ_NACK_MAX_DELAY, &subframe, &slot_nr))
+        nacked |= (subframe == 1) << slot_nr;
+    ok &= nacked == 0b11;
+
+    // new data fails and is stored instead of being combined
+    gen_half(msg_enc[2], num_soft, 0, soft);
+    ok &= phy_harq_decode(h, dec, 0, soft, num_soft, rx, 0, 2, 0, 14) == HARQ_RX_NACK;
+    ok &= phy_harq_get_combined(h) == 0;
+
+    // the retransmission of slot 1 is tried with slot 0 first, which fails the CRC
+    gen_half(msg_enc[1], num_soft, 1, soft);
+    ok &= phy_harq_decode(h, dec, 0, soft, num_soft, rx, 1, 3, 0, 15) == HARQ_RX_COMBINED;
+    ok &= memcmp(rx->data, tx[1]->data, MSG_LEN) == 0;
+    gen_half(msg_enc[0], num_soft, 1, soft);
+    ok &= phy_harq_decode(h, dec, 0, soft, num_soft, rx, 1, 3, 1, 15) == HARQ_RX_COMBINED;
+    ok &= memcmp(rx->data, tx[0]->data, MSG_LEN) == 0;
+
+    // only the new data is left to be NACKed
+    ok &= phy_harq_poll_nack(h, 16, HARQ_NACK_MAX_DELAY, &subframe, &slot_nr) && subframe==2 && slot_nr==0;
+    ok &= !phy_harq_poll_nack(h, 16, HARQ_NACK_MAX_DELAY, &subframe, &slot_nr);
+    ok &= phy_harq_num_pending(h, 16, 0) == 1 && phy_harq_request_retx(h, 16, 0);
+    ok &= phy_harq_num_pending(h, 16, 0) == 0 && phy_harq_get_combined(h) == 2;
+
+    printf("Retransmission marking: %s\n", ok ? "ok" : "failed");
+    for (int m=0; m<3; m++) {
+        lchan_destroy(tx[m]);
+        free(msg_enc[m]);
+    }
+    free(soft);
+    lchan_destroy(rx);
+    phy_harq_destroy(h);
+    fec_destroy(enc);
+    return ok;
+}
+
+int test_combining(phy_fec dec, uint enc_len)
+{
+    fec enc = fec_create(LIQUID_FEC_CONV_V27, NULL);
+    phy_harq h = phy_harq_create(enc_len*8);
+    LogicalChannel tx = lchan_create(MSG_LEN, CRC16);
+    LogicalChannel rx = lchan_create(MSG_LEN, CRC16);
+    uint8_t* msg_enc = malloc(enc_len);
+    uint8_t* soft = malloc(enc_len*8);
+    float nstd = powf(10.0f, -SNR_DB/20.0f);
+    uint single_ok = 0, combined_ok = 0, subframe, slot_nr;
+
+    for (int n=0; n<NUM_TRIALS; n++) {
+        lchan_calc_crc(tx);
+        fec_encode(enc, MSG_LEN, tx->data, msg_enc);
+        phy_harq_clear(h);
+
+        gen_soft(msg_enc, enc_len*8, nstd, soft);
+        phy_harq_result res = phy_harq_decode(h, dec, 0, soft, enc_len*8, rx, 0, n%FRAME_LEN, 0, 2*n);
+        if (res == HARQ_RX_OK) {
+            single_ok++;
+            combined_ok++;
+            continue;
+        }
+        phy_harq_poll_nack(h, 2*n, HARQ_NACK_MAX_DELAY, &subframe, &slot_nr);
+
+        // retransmission with new noise
+        gen_soft(msg_enc, enc_len*8, nstd, soft);
+        res = phy_harq_decode(h, dec, 0, soft, enc_len*8, rx, 1, n%FRAME_LEN, 1, 2*n+1);
+        if ((res == HARQ_RX_OK || res == HARQ_RX_COMBINED) && memcmp(tx->data, rx->data, MSG_LEN)==0)
+            combined_ok++;
+    }
+
+    printf("SNR %.1fdB: CRC ok single copy %d, two combined copies %d of %d, combined slots %d\n",
+           SNR_DB, single_ok, combined_ok, NUM_TRIALS, phy_harq_get_combined(h));
+
+    free(msg_enc);
+    free(soft);
+    lchan_destroy(tx);
+    lchan_destroy(rx);
+    phy_harq_destroy(h);
+    fec_destroy(enc);
+    return single_ok < NUM_TRIALS/4 && combined_ok >= NUM_TRIALS*9/10;
+}
+
+int main(int argc, char* argv[])
+{
+    uint enc_len = fec_get_enc_msg_length(LIQUID_FEC_CONV_V27, MSG_LEN);
+    phy_fec dec = phy_fec_create(LIQUID_FEC_CONV_V27, MSG_LEN, PHY_FEC_IMPL_AUTO);
+
+    int ok = test_quant();
+    ok &= test_saturation(dec, enc_len*8);
+    ok &= test_retx(dec, enc_len);
+    ok &= test_combining(dec, enc_len);
+
+    phy_fec_destroy(dec);
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// Compares the vectorized IQ conversion kernels of the Pluto platform against the scalar
+// reference and measures the throughput of both
+
+#include "../platform/pluto_iq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BUF_LEN (2*68)		// samples per buffer, matches SYMBOLS_PER_BUF symbols
+#define NUM_TRIALS 20000
+
+static float elapsed_us(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec-start->tv_sec)*1e6+(end->tv_nsec-start->tv_nsec)/1e3;
+}
+
+// compare all buffer lengths up to BUF_LEN, so that the scalar tail handling is covered
+int test_rx(void)
+{
+    int16_t iq[2*BUF_LEN];
+    float complex out[BUF_LEN], out_ref[BUF_LEN];
+    int ok = 1;
+
+    for (int len=0; len<=BUF_LEN; len++) {
+        for (int i=0; i<2*len; i++)
+            iq[i] = (int16_t)(rand() & 0xffff);
+        pluto_iq_to_float(iq, out, len, PLUTO_IQ_RX_SCALE);
+        pluto_iq_to_float_ref(iq, out_ref, len, PLUTO_IQ_RX_SCALE);
+        ok &= memcmp(out, out_ref, sizeof(float complex)*len) == 0;
+    }
+
+    struct timespec start, end;
+    float t_ref = 0, t_vec = 0;
+    for (int n=0; n<NUM_TRIALS; n++) {
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        pluto_iq_to_float_ref(iq, out_ref, BUF_LEN, PLUTO_IQ_RX_SCALE);
+        clock_gettime(CLOCK_MONOTONIC,&end);
+        t_ref += elapsed_us(&start,&end);
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        pluto_iq_to_float(iq, out, BUF_LEN, PLUTO_IQ_RX_SCALE);
+        clock_gettime(CLOCK_MONOTONIC,&end);
+        t_vec += elapsed_us(&start,&end);
+    }
+    printf("RX int16->float: %s, time scalar/%s per buffer: %.3f/%.3fus\n", ok ? "match" : "MISMATCH",
+           pluto_iq_impl_str(), t_ref/NUM_TRIALS, t_vec/NUM_TRIALS);
+    return ok;
+}
+
+int test_tx(void)
+{
+    float complex in[BUF_LEN];
+    int16_t iq[2*BUF_LEN], iq_ref[2*BUF_LEN];
+    int ok = 1;
+
+    for (int len=0; len<=BUF_LEN; len++) {
+        // amplitudes up to 5, i.e. some samples are clipped
+        for (int i=0; i<len; i++)
+            in[i] = 10.0f*(rand()/(float)RAND_MAX-0.5f) + I*10.0f*(rand()/(float)RAND_MAX-0.5f);
+        // values out of the 32 bit range
+        if (len>2) {
+            in[len-1] = 1e12f - I*1e12f;
+            in[len/2] = -1e12f + I*4.0f;
+        }
+        uint clip = pluto_iq_from_float(in, iq, len, PLUTO_IQ_TX_SCALE);
+        uint clip_ref = pluto_iq_from_float_ref(in, iq_ref, len, PLUTO_IQ_TX_SCALE);
+        ok &= clip == clip_ref && memcmp(iq, iq_ref, sizeof(int16_t)*2*len) == 0;
+    }
+
+    struct timespec start, end;
+    float t_ref = 0, t_vec = 0;
+    for (int n=0; n<NUM_TRIALS; n++) {
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        pluto_iq_from_float_ref(in, iq_ref, BUF_LEN, PLUTO_IQ_TX_SCALE);
+        clock_gettime(CLOCK_MONOTONIC,&end);
+        t_ref += elapsed_us(&start,&end);
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        pluto_iq_from_float(in, iq, BUF_LEN, PLUTO_IQ_TX_SCALE);
+        clock_gettime(CLOCK_MONOTONIC,&end);
+        t_vec += elapsed_us(&start,&end);
+    }
+    printf("TX float->int16: %s, time scalar/%s per buffer: %.3f/%.3fus\n", ok ? "match" : "MISMATCH",
+           pluto_iq_impl_str(), t_ref/NUM_TRIALS, t_vec/NUM_TRIALS);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    int ok = test_rx();
+    ok &= test_tx();
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
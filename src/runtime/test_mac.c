@@ -105,23 +105,28 @@ int run_simulation(uint num_subframes, uint mcs)
 			// add some data to send
 #if BS_SEND_ENABLE
             MacDataFrame dl_frame = dataframe_create(payload_size);
-			for (int i=0; i<payload_size; i++)
-				dl_frame->data[i] = rand() & 0xFF;
-			memcpy(dl_frame->data,&packet_id,sizeof(uint));
-			if(!mac_bs_add_txdata(mac_bs, 2, dl_frame))
-				dataframe_destroy(dl_frame);
-			mac_dl_timestamps[packet_id] = -global_sfn*SUBFRAME_LEN - global_symbol;
+			// skip the frame if the frame pool is exhausted
+			if (dl_frame != NULL) {
+				for (int i=0; i<payload_size; i++)
+					dl_frame->data[i] = rand() & 0xFF;
+				memcpy(dl_frame->data,&packet_id,sizeof(uint));
+				if(!mac_bs_add_txdata(mac_bs, 2, dl_frame))
+					dataframe_destroy(dl_frame);
+				mac_dl_timestamps[packet_id] = -global_sfn*SUBFRAME_LEN - global_symbol;
+			}
 #endif
 #if CLIENT_SEND_ENABLE
 			// add some data to send for client
 			MacDataFrame ul_frame = dataframe_create(payload_size);
-			for (int i=0; i<payload_size; i++)
-				ul_frame->data[i] = rand() & 0xFF;
-			memcpy(ul_frame->data,&packet_id,sizeof(uint));
-			mac_ul_timestamps[packet_id] = -global_sfn*SUBFRAME_LEN - global_symbol;
-
-			if(!mac_ue_add_txdata(mac_ue, ul_frame)) {
-				dataframe_destroy(ul_frame);
+			if (ul_frame != NULL) {
+				for (int i=0; i<payload_size; i++)
+					ul_frame->data[i] = rand() & 0xFF;
+				memcpy(ul_frame->data,&packet_id,sizeof(uint));
+				mac_ul_timestamps[packet_id] = -global_sfn*SUBFRAME_LEN - global_symbol;
+
+				if(!mac_ue_add_txdata(mac_ue, ul_frame)) {
+					dataframe_destroy(ul_frame);
+				}
 			}
 #endif
 			packet_id++;
@@ -292,6 +297,11 @@ int main(int argc, char* argv[])
 		mcs = strtol(argv[1],&ptr, 10);
 	}
 
+#ifdef PHY_FIXED_POINT
+	printf("Soft demapping: fixed point\n");
+#else
+	printf("Soft demapping: float\n");
+#endif
 	for (int snr= 25; snr<40; snr+=1) {
 		printf("Starting simulation with SNR %ddB mcs%d\n",snr,mcs);
 
@@ -0,0 +1,162 @@
+/*
+ * HNAP4PlutoSDR - HAMNET Access Protocol implementation for the Adalm Pluto SDR
+ *
+ * Copyright (C) 2020 Lukas Ostendorf <lukas.ostendorf@gmail.com>
+ *                    and the project contributors
+ *
+ * This library is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU Lesser General Public License as published by the Free Software Foundation; version 3.0.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA
+ */
+
+// Stress test and benchmark of the lock-free ring buffers.
+// Producers pass sequence numbers through the buffer and the consumer verifies that every item
+// arrives exactly once and in order per producer. Build with -fsanitize=thread (CMake option
+// TEST_TSAN) to let ThreadSanitizer check the memory ordering.
+
+#include "../util/ringbuf.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BUF_SIZE 64
+#define NUM_ITEMS 2000000		// items per producer
+#define MAX_PRODUCERS 4
+#define BULK_LEN 16
+
+// items are (producer << 24 | n) + 1, so they are never NULL
+#define ITEM(p, n) ((void*)(uintptr_t)((((uintptr_t)(p)) << 24 | (n)) + 1))
+#define ITEM_PRODUCER(item) ((((uintptr_t)(item)) - 1) >> 24)
+#define ITEM_NR(item) ((((uintptr_t)(item)) - 1) & 0xffffff)
+
+struct producer_arg_s {
+    ringbuf buf;
+    uint id;
+    uint bulk;	// number of items per put
+};
+
+static float elapsed_us(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec-start->tv_sec)*1e6+(end->tv_nsec-start->tv_nsec)/1e3;
+}
+
+static void* producer_thread(void* arg)
+{
+    struct producer_arg_s* p = arg;
+    void* items[BULK_LEN];
+    uint n = 0;
+    while (n < NUM_ITEMS) {
+        uint len = (NUM_ITEMS - n < p->bulk) ? NUM_ITEMS - n : p->bulk;
+        for (int i=0; i<len; i++)
+            items[i] = ITEM(p->id, n+i);
+        uint added = (len == 1) ? ringbuf_put(p->buf, items[0]) : ringbuf_put_bulk(p->buf, items, len);
+        if (added == 0)
+            sched_yield();	// buffer full, let the consumer run if the cores are shared
+        n += added;
+    }
+    return NULL;
+}
+
+// runs num_producers producers against one consumer. Returns 1 if all items arrived in order
+int test_ring(ringbuf_type type, uint num_producers, uint bulk)
+{
+    ringbuf buf = ringbuf_create(BUF_SIZE, type);
+    struct producer_arg_s args[MAX_PRODUCERS];
+    pthread_t threads[MAX_PRODUCERS];
+    uint next[MAX_PRODUCERS] = {0};
+    uint errors = 0;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    for (int i=0; i<num_producers; i++) {
+        args[i] = (struct producer_arg_s){buf, i, bulk};
+        pthread_create(&threads[i], NULL, producer_thread, &args[i]);
+    }
+
+    void* items[BULK_LEN];
+    uint received = 0;
+    while (received < num_producers*NUM_ITEMS) {
+        uint len;
+        if (bulk == 1) {
+            items[0] = ringbuf_get(buf);
+            len = items[0] != NULL;
+        } else {
+            len = ringbuf_get_bulk(buf, items, BULK_LEN);
+        }
+        if (len == 0)
+            sched_yield();
+        for (int i=0; i<len; i++) {
+            uint p = ITEM_PRODUCER(items[i]);
+            if (p >= num_producers || ITEM_NR(items[i]) != next[p]) {
+                errors++;
+                continue;
+            }
+            next[p]++;
+        }
+        received += len;
+    }
+    for (int i=0; i<num_producers; i++)
+        pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC,&end);
+
+    int ok = errors == 0 && ringbuf_isempty(buf) && ringbuf_get(buf) == NULL;
+    float t = elapsed_us(&start,&end);
+    printf("%s %d producer(s), %2d items per call: %d errors, %.1f Mitems/s%s\n",
+           type == RINGBUF_MPSC ? "MPSC" : "SPSC", num_producers, bulk, errors,
+           received/t, ok ? "" : " FAILED");
+    ringbuf_destroy(buf);
+    return ok;
+}
+
+// single threaded checks of the capacity, full/empty state and bulk operations
+int test_basic(ringbuf_type type)
+{
+    ringbuf buf = ringbuf_create(BUF_SIZE-1, type);
+    void* items[2*BUF_SIZE];
+    int ok = ringbuf_capacity(buf) == BUF_SIZE && ringbuf_isempty(buf) && !ringbuf_isfull(buf);
+
+    for (int i=0; i<2*BUF_SIZE; i++)
+        items[i] = ITEM(0, i);
+    // positions wrap around several times
+    for (int round=0; round<3*BUF_SIZE; round++) {
+        ok &= ringbuf_put_bulk(buf, items, 2*BUF_SIZE) == BUF_SIZE;
+        ok &= ringbuf_isfull(buf) && !ringbuf_put(buf, items[0]);
+        ok &= ringbuf_get(buf) == items[0];
+        ok &= ringbuf_put(buf, items[BUF_SIZE]);
+        void* out[2*BUF_SIZE];
+        ok &= ringbuf_get_bulk(buf, out, round % 5 + 1) == round % 5 + 1;
+        uint n = round % 5 + 1;
+        n += ringbuf_get_bulk(buf, out + n, 2*BUF_SIZE);
+        ok &= n == BUF_SIZE;
+        for (int i=0; i<BUF_SIZE; i++)
+            ok &= out[i] == items[i+1];
+        ok &= ringbuf_isempty(buf) && ringbuf_get(buf) == NULL;
+    }
+    printf("%s basic: %s\n", type == RINGBUF_MPSC ? "MPSC" : "SPSC", ok ? "ok" : "failed");
+    ringbuf_destroy(buf);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    int ok = 1;
+    ok &= test_basic(RINGBUF_SPSC);
+    ok &= test_basic(RINGBUF_MPSC);
+    ok &= test_ring(RINGBUF_SPSC, 1, 1);
+    ok &= test_ring(RINGBUF_SPSC, 1, BULK_LEN);
+    ok &= test_ring(RINGBUF_MPSC, 1, 1);
+    ok &= test_ring(RINGBUF_MPSC, MAX_PRODUCERS, 1);
+    ok &= test_ring(RINGBUF_MPSC, MAX_PRODUCERS, BULK_LEN);
+    printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : 1;
+}
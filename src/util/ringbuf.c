@@ -17,23 +17,49 @@
  */
 
 #include "ringbuf.h"
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 
-struct ringbuf_s{
-	void** data;
-	uint32_t readpos;
-	uint32_t writepos;
-	uint32_t size;
-} ;
+#define RINGBUF_CACHE_LINE 64
 
-ringbuf ringbuf_create(uint32_t size)
+// Positions are free running 32bit counters, the entry of position p is data[p & mask].
+// head - tail is the number of used entries.
+struct ringbuf_s {
+	// producer side
+	_Alignas(RINGBUF_CACHE_LINE) atomic_uint_least32_t head;	// next position to write
+	uint32_t tail_cache;	// last tail seen by the producer (SPSC only)
+
+	// consumer side
+	_Alignas(RINGBUF_CACHE_LINE) atomic_uint_least32_t tail;	// next position to read
+	uint32_t head_cache;	// last head seen by the consumer (SPSC only)
+
+	// read only after create
+	_Alignas(RINGBUF_CACHE_LINE) void** data;
+	// MPSC only: the entry of position p is published once seq[p & mask] == p+1
+	atomic_uint_least32_t* seq;
+	uint32_t mask;
+	ringbuf_type type;
+};
+
+ringbuf ringbuf_create(uint32_t size, ringbuf_type type)
 {
-	ringbuf buf = malloc(sizeof(struct ringbuf_s));
-	buf->data = calloc(size*sizeof(void*),1);
-	buf->writepos = 0;
-	buf->readpos = 0 ;
-	buf->size = size;
+	uint32_t capacity = 1;
+	while (capacity < size)
+		capacity <<= 1;
 
+	ringbuf buf = aligned_alloc(RINGBUF_CACHE_LINE, sizeof(struct ringbuf_s));
+	memset(buf, 0, sizeof(struct ringbuf_s));
+	atomic_init(&buf->head, 0);
+	atomic_init(&buf->tail, 0);
+	buf->data = calloc(capacity, sizeof(void*));
+	buf->mask = capacity-1;
+	buf->type = type;
+	if (type == RINGBUF_MPSC) {
+		buf->seq = malloc(capacity*sizeof(atomic_uint_least32_t));
+		for (uint32_t i=0; i<capacity; i++)
+			atomic_init(&buf->seq[i], 0);
+	}
 	return buf;
 }
 
@@ -43,46 +69,137 @@ void ringbuf_destroy(ringbuf buf)
 		void* p = ringbuf_get(buf);
 		free(p);
 	}
+	free(buf->seq);
 	free(buf->data);
 	free(buf);
 }
 
+uint32_t ringbuf_capacity(ringbuf buf)
+{
+	return buf->mask+1;
+}
+
+// ---------------- single producer, single consumer ---------------- //
+
+static uint32_t ringbuf_spsc_put(ringbuf buf, void* const* items, uint32_t n)
+{
+	uint32_t head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+	uint32_t free_entries = buf->mask+1 - (head - buf->tail_cache);
+	if (free_entries < n) {
+		// only read the shared tail if the cached one is not sufficient
+		buf->tail_cache = atomic_load_explicit(&buf->tail, memory_order_acquire);
+		free_entries = buf->mask+1 - (head - buf->tail_cache);
+		if (n > free_entries)
+			n = free_entries;
+	}
+	for (uint32_t i=0; i<n; i++)
+		buf->data[(head+i) & buf->mask] = items[i];
+	atomic_store_explicit(&buf->head, head+n, memory_order_release);
+	return n;
+}
+
+static uint32_t ringbuf_spsc_get(ringbuf buf, void** items, uint32_t n)
+{
+	uint32_t tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+	uint32_t used = buf->head_cache - tail;
+	if (used < n) {
+		buf->head_cache = atomic_load_explicit(&buf->head, memory_order_acquire);
+		used = buf->head_cache - tail;
+		if (n > used)
+			n = used;
+	}
+	for (uint32_t i=0; i<n; i++)
+		items[i] = buf->data[(tail+i) & buf->mask];
+	atomic_store_explicit(&buf->tail, tail+n, memory_order_release);
+	return n;
+}
+
+// ---------------- multiple producers, single consumer ---------------- //
+
+static uint32_t ringbuf_mpsc_put(ringbuf buf, void* const* items, uint32_t n)
+{
+	// reserve n positions, or as many as are free
+	uint32_t head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+	uint32_t k;
+	do {
+		uint32_t tail = atomic_load_explicit(&buf->tail, memory_order_acquire);
+		uint32_t free_entries = buf->mask+1 - (head - tail);
+		k = (n < free_entries) ? n : free_entries;
+		if (k == 0)
+			return 0;
+	} while (!atomic_compare_exchange_weak_explicit(&buf->head, &head, head+k,
+													memory_order_relaxed, memory_order_relaxed));
+
+	// the positions are owned by this producer now. Publish every entry separately,
+	// the consumer stops at the first entry that is not published yet
+	for (uint32_t i=0; i<k; i++) {
+		uint32_t pos = head+i;
+		buf->data[pos & buf->mask] = items[i];
+		atomic_store_explicit(&buf->seq[pos & buf->mask], pos+1, memory_order_release);
+	}
+	return k;
+}
+
+static uint32_t ringbuf_mpsc_get(ringbuf buf, void** items, uint32_t n)
+{
+	uint32_t tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+	uint32_t k;
+	for (k=0; k<n; k++) {
+		uint32_t pos = tail+k;
+		if (atomic_load_explicit(&buf->seq[pos & buf->mask], memory_order_acquire) != pos+1)
+			break;
+		items[k] = buf->data[pos & buf->mask];
+	}
+	if (k > 0)
+		atomic_store_explicit(&buf->tail, tail+k, memory_order_release);
+	return k;
+}
+
+// ---------------- common interface ---------------- //
+
+uint32_t ringbuf_put_bulk(ringbuf buf, void* const* items, uint32_t n)
+{
+	if (buf->type == RINGBUF_MPSC)
+		return ringbuf_mpsc_put(buf, items, n);
+	else
+		return ringbuf_spsc_put(buf, items, n);
+}
+
+uint32_t ringbuf_get_bulk(ringbuf buf, void** items, uint32_t n)
+{
+	if (buf->type == RINGBUF_MPSC)
+		return ringbuf_mpsc_get(buf, items, n);
+	else
+		return ringbuf_spsc_get(buf, items, n);
+}
+
 void* ringbuf_get(ringbuf buf)
 {
 	void* item;
-	if (ringbuf_isempty(buf)) {
+	if (ringbuf_get_bulk(buf, &item, 1) == 0) {
 		return NULL; // no element in buf
-	} else {
-		item = buf->data[buf->readpos];
-		buf->readpos = (buf->readpos+1) % buf->size;
-		return item;
 	}
+	return item;
 }
 
 int ringbuf_put(ringbuf buf, void* item)
 {
-	if (ringbuf_isfull(buf)) {
-		return 0;
-	}
-	buf->data[buf->writepos] = item;
-	buf->writepos = (buf->writepos+1) % buf->size;
-	return 1;
+	return ringbuf_put_bulk(buf, &item, 1);
 }
 
 int ringbuf_isfull(ringbuf buf)
 {
-	if ((buf->writepos+1) % buf->size == buf->readpos) {
-		return 1; // buffer full
-	} else {
-		return 0;
-	}
+	uint32_t tail = atomic_load_explicit(&buf->tail, memory_order_acquire);
+	uint32_t head = atomic_load_explicit(&buf->head, memory_order_acquire);
+	return head - tail > buf->mask;
 }
 
 int ringbuf_isempty(ringbuf buf)
 {
-	if (buf->readpos == buf->writepos) {
-		return 1;
+	uint32_t tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+	if (buf->type == RINGBUF_MPSC) {
+		return atomic_load_explicit(&buf->seq[tail & buf->mask], memory_order_acquire) != tail+1;
 	} else {
-		return 0;
+		return atomic_load_explicit(&buf->head, memory_order_acquire) == tail;
 	}
 }
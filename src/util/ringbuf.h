@@ -22,34 +22,56 @@
 #include <stdint.h>
 #include <stddef.h>
 
-// Ringbuf structure that stores pointers
-// uses void pointers internally
-// NOTE: the capacity of the buffer is size-1 items
-//		 due to the specific implementation of the get and put functions
+// Lock-free ring buffer that stores pointers.
+// The capacity is the size passed to ringbuf_create() rounded up to the next power of two,
+// so positions are masked instead of computed with a modulo.
+// Head and tail are kept on separate cache lines. Two variants, chosen per queue:
+//  RINGBUF_SPSC: one producer and one consumer thread
+//  RINGBUF_MPSC: any number of producer threads and one consumer thread.
+//                Producers reserve positions with a CAS on the head and publish every entry
+//                with its own sequence number, so a producer never waits for another one.
+// The consumer functions (get, isempty) must only be called by the consumer thread,
+// or while no other thread uses the buffer (e.g. when it is destroyed).
 
+typedef enum {
+	RINGBUF_SPSC,	// single producer, single consumer
+	RINGBUF_MPSC	// multiple producers, single consumer
+} ringbuf_type;
 
 struct ringbuf_s;
 typedef struct ringbuf_s* ringbuf;
 
-// Initialize a ringbuf of given size
+// Initialize a ringbuf that holds at least size items
 // returns the ringbuf object
-ringbuf ringbuf_create(uint32_t size);
+ringbuf ringbuf_create(uint32_t size, ringbuf_type type);
 
-// Delete the buffer
+// Delete the buffer. Remaining items are freed
 void ringbuf_destroy(ringbuf buf);
 
 // Get an item from the buffer;
 // returns NULL if the buffer is empty
 void* ringbuf_get(ringbuf buf);
 
+// Get up to n items from the buffer in one step
+// returns the number of items written to items
+uint32_t ringbuf_get_bulk(ringbuf buf, void** items, uint32_t n);
+
 // Add an item to the buffer
 // returns 1 on success, 0 if the buffer is full
 int ringbuf_put(ringbuf buf, void* item);
 
+// Add up to n items to the buffer in one step. Items are added in order until the buffer is full
+// returns the number of items that were added
+uint32_t ringbuf_put_bulk(ringbuf buf, void* const* items, uint32_t n);
+
 // Check if the buffer is full
 int ringbuf_isfull(ringbuf buf);
 
-// Check if the buffer is full
+// Check if the buffer is empty. For MPSC buffers, items that are reserved
+// but not yet published by a producer are not visible
 int ringbuf_isempty(ringbuf buf);
 
+// returns the number of items the buffer can hold
+uint32_t ringbuf_capacity(ringbuf buf);
+
 #endif /* UTIL_RINGBUF_H_ */